@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+
+namespace input {
+
+// One decoded pointer packet, stamped when it was drained from the device
+struct MousePacket {
+  int8_t dx;
+  int8_t dy;
+  int8_t dz;
+  bool left;
+  bool right;
+  bool middle;
+  uint64_t timestamp; // platform::timestamp() at drain time
+};
+
+// Fixed-capacity ring of pending input packets. Filled by the input stage of
+// the event loop and emptied by the update stage before a frame is rendered.
+class EventQueue {
+public:
+  static constexpr uint32_t kCapacity = 128;
+
+  EventQueue();
+  // Returns false (and counts a drop) when the queue is full
+  bool push(const MousePacket &pkt);
+  bool pop(MousePacket &out);
+
+  inline bool empty() const { return count_ == 0; }
+  inline bool full() const { return count_ == kCapacity; }
+  inline uint32_t size() const { return count_; }
+  inline uint32_t dropped() const { return dropped_; }
+
+private:
+  MousePacket packets_[kCapacity];
+  uint32_t head_;
+  uint32_t count_;
+  uint32_t dropped_;
+};
+
+} // namespace input
@@ -1,4 +1,5 @@
 #pragma once
+#include "events.hpp"
 #include <cstdint>
 
 namespace input {
@@ -18,9 +19,15 @@ public:
   bool initialize();
   bool poll_packet(int8_t &dx, int8_t &dy, int8_t &dz, bool &left, bool &right,
                    bool &middle);
+  // Read every packet currently buffered by the controller into queue without
+  // waiting for new data, each stamped with platform::timestamp() when it is
+  // read. Returns the number of packets queued.
+  uint32_t drain(EventQueue &queue);
 
 private:
   bool wheel_supported_ = false;
+  // Whether a mouse byte is waiting to be read
+  bool data_pending();
   bool write_command(uint8_t value);
   bool write_device(uint8_t value);
   bool read_data(uint8_t &value);
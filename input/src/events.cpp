@@ -0,0 +1,26 @@
+#include "../include/events.hpp"
+
+namespace input {
+
+EventQueue::EventQueue() : packets_{}, head_(0), count_(0), dropped_(0) {}
+
+bool EventQueue::push(const MousePacket &pkt) {
+  if (count_ == kCapacity) {
+    dropped_++;
+    return false;
+  }
+  packets_[(head_ + count_) % kCapacity] = pkt;
+  count_++;
+  return true;
+}
+
+bool EventQueue::pop(MousePacket &out) {
+  if (count_ == 0)
+    return false;
+  out = packets_[head_];
+  head_ = (head_ + 1) % kCapacity;
+  count_--;
+  return true;
+}
+
+} // namespace input
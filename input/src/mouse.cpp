@@ -11,6 +11,7 @@ static inline uint8_t inb(uint16_t port) {
 #endif
 
 #include "../include/mouse.hpp"
+#include "../../ui/include/time.hpp"
 
 namespace input {
 
@@ -22,6 +23,10 @@ static constexpr uint16_t PS2_CMD = 0x64;
 // Status bits
 static constexpr uint8_t PS2_STATUS_OUTPUT = 1 << 0; // Data available to read
 static constexpr uint8_t PS2_STATUS_INPUT = 1 << 1;  // Input buffer full
+static constexpr uint8_t PS2_STATUS_AUX = 1 << 5;    // Data is from the mouse
+
+// Keyboard bytes dropped per look for mouse data
+static constexpr uint32_t kMaxDiscard = 16;
 
 Ps2Mouse::Ps2Mouse() {}
 
@@ -207,4 +212,39 @@ bool Ps2Mouse::poll_packet(int8_t &dx, int8_t &dy, int8_t &dz, bool &left,
 #endif
 }
 
+// Keyboard bytes ahead of mouse data are read and dropped: nothing reads the
+// keyboard yet, and the controller has one output buffer for both devices,
+// so an unread key would hold back every mouse byte behind it
+bool Ps2Mouse::data_pending() {
+#if defined(__x86_64__)
+  for (uint32_t i = 0; i < kMaxDiscard; ++i) {
+    const uint8_t status = inb(PS2_STATUS);
+    if (!(status & PS2_STATUS_OUTPUT))
+      return false;
+    if (status & PS2_STATUS_AUX)
+      return true;
+    (void)inb(PS2_DATA);
+  }
+  return false;
+#else
+  return false;
+#endif
+}
+
+uint32_t Ps2Mouse::drain(EventQueue &queue) {
+  uint32_t queued = 0;
+  // Bound the loop so a flooding device cannot starve the rest of the frame
+  for (uint32_t i = 0; i < EventQueue::kCapacity && data_pending(); ++i) {
+    MousePacket pkt{};
+    if (!poll_packet(pkt.dx, pkt.dy, pkt.dz, pkt.left, pkt.right, pkt.middle))
+      continue; // out of sync byte consumed; keep resynchronising
+    // Stamped as read, so latency includes the time spent queued behind it
+    pkt.timestamp = platform::timestamp();
+    if (!queue.push(pkt))
+      break;
+    queued++;
+  }
+  return queued;
+}
+
 } // namespace input
@@ -7,5 +7,6 @@ enum : uint32_t {
   Start_About = 2,
   Start_Finder = 3,
   Start_TextViewer = 4,
+  Start_Memory = 5,
 };
 }
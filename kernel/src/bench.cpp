@@ -0,0 +1,86 @@
+#include "bench.hpp"
+#include "../../ui/include/log.hpp"
+#include "../../ui/include/time.hpp"
+#include "mm/heap.hpp"
+#include "smp.hpp"
+
+namespace bench {
+
+void cpu_scaling(const char *name, uint32_t runs, void (*fn)(void *ctx),
+                 void *ctx) {
+  using namespace platform;
+  const uint32_t online = online_cpu_count();
+  uint64_t one_cpu_us = 0;
+  for (uint32_t cpus = 1;; cpus = cpus * 2 < online ? cpus * 2 : online) {
+    set_parallel_cpus(cpus);
+    fn(ctx); // warm caches and lazily built state
+    const uint64_t start = timestamp();
+    for (uint32_t i = 0; i < runs; ++i)
+      fn(ctx);
+    const uint64_t us = ticks_to_us(timestamp() - start) / (runs ? runs : 1);
+    if (cpus == 1)
+      one_cpu_us = us;
+    // Speedup in hundredths
+    const uint64_t speedup = us ? one_cpu_us * 100 / us : 0;
+    log("bench %s: %u cpus, %lu us/run, x%lu.%lu%lu\n", name, cpus, us,
+        speedup / 100, speedup / 10 % 10, speedup % 10);
+    if (cpus == online)
+      break;
+  }
+  set_parallel_cpus(online);
+}
+
+// Per-item work of heap_contention(): rounds of kBurst allocations of
+// kObjectSize bytes, then freeing them all, on whichever CPU runs the item
+static constexpr uint32_t kBurst = 96;
+static constexpr uint32_t kRounds = 20000;
+static constexpr uint32_t kObjectSize = 64;
+
+static void heap_burst(uint32_t, void *ctx) {
+  uint64_t *cycles = static_cast<uint64_t *>(ctx);
+  void *objects[kBurst];
+  const uint64_t start = platform::timestamp();
+  for (uint32_t r = 0; r < kRounds; ++r) {
+    for (uint32_t i = 0; i < kBurst; ++i)
+      objects[i] = mm::heap::alloc(kObjectSize);
+    for (uint32_t i = 0; i < kBurst; ++i)
+      mm::heap::free(objects[i]);
+  }
+  __atomic_fetch_add(cycles, platform::timestamp() - start, __ATOMIC_RELAXED);
+}
+
+// Trips past the per-CPU caches so far, over every class
+static void heap_trips(uint64_t &exchanges, uint64_t &batches) {
+  mm::heap::Stats st;
+  mm::heap::stats(st);
+  exchanges = batches = 0;
+  for (uint32_t i = 0; i < mm::heap::kClassCount; ++i) {
+    exchanges += st.depot_exchanges[i];
+    batches += st.slab_batches[i];
+  }
+}
+
+void heap_contention() {
+  using namespace platform;
+  const uint32_t online = online_cpu_count();
+  for (uint32_t cpus = 1;; cpus = cpus * 2 < online ? cpus * 2 : online) {
+    set_parallel_cpus(cpus);
+    uint64_t cycles = 0;
+    parallel_for(cpus, &heap_burst, &cycles); // warm the caches
+    uint64_t exchanges0, batches0, exchanges1, batches1;
+    heap_trips(exchanges0, batches0);
+    cycles = 0;
+    parallel_for(cpus, &heap_burst, &cycles);
+    heap_trips(exchanges1, batches1);
+    // On x86_64 timestamp() is the TSC, whose ticks are nominal cycles
+    const uint64_t ops = uint64_t(cpus) * kRounds * kBurst * 2;
+    log("bench heap: %u cpus, %lu cycles/op, %lu depot exchanges, "
+        "%lu slab batches\n",
+        cpus, cycles / ops, exchanges1 - exchanges0, batches1 - batches0);
+    if (cpus == online)
+      break;
+  }
+  set_parallel_cpus(online);
+}
+
+} // namespace bench
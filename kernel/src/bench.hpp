@@ -0,0 +1,24 @@
+// Boot-time benchmarks
+#pragma once
+
+#include <cstdint>
+
+namespace bench {
+
+// Built in with CPPFLAGS=-DKERNEL_BENCH and run under QEMU with -smp N once
+// the desktop is up; every result is a line on the serial log starting with
+// "bench".
+
+// Run fn(ctx) runs times with parallel_for() limited to 1, 2, 4, ... of the
+// online CPUs, then all of them, and log the average time per run and the
+// speedup over one CPU for each count
+void cpu_scaling(const char *name, uint32_t runs, void (*fn)(void *ctx),
+                 void *ctx);
+
+// Allocate and free heap objects in bursts larger than a magazine on 1, 2,
+// 4, ... of the online CPUs at once, and log the cycles per operation with
+// the depot exchanges and slab batches the caches needed, to show how the
+// heap holds up under contention
+void heap_contention();
+
+} // namespace bench
@@ -0,0 +1,84 @@
+#include "../../ui/include/frame_arena.hpp"
+#include "../../ui/include/mem_account.hpp"
+#include "../../ui/include/smp.hpp"
+#include "mm/pmm.hpp"
+
+namespace platform {
+
+// Chunks come from the page allocator and are chained; a pass that needs
+// more than the chain holds appends a chunk, which later passes reuse
+struct Chunk {
+  Chunk *next;
+  uint64_t size; // bytes including this header
+};
+
+struct alignas(64) Arena {
+  Chunk *first;
+  Chunk *current;
+  uint64_t offset; // next free byte in current
+  uint64_t used;   // bytes handed out this pass, padding included
+};
+
+static constexpr uint32_t kMinChunkOrder = 4; // 64 KiB
+
+static Arena s_arenas[kMaxCpus];
+static uint64_t s_peak = 0;
+
+static Chunk *new_chunk(uint64_t bytes) {
+  uint32_t order = mm::pmm::order_for(bytes + sizeof(Chunk));
+  if (order < kMinChunkOrder)
+    order = kMinChunkOrder;
+  Chunk *c = static_cast<Chunk *>(mm::pmm::alloc_pages(order));
+  if (c == nullptr)
+    return nullptr;
+  c->next = nullptr;
+  c->size = mm::pmm::kPageSize << order;
+  // Chunks are kept for later passes, so they stay charged
+  mem_charge(MemTag::Ui, c->size);
+  return c;
+}
+
+void *frame_alloc(uint64_t bytes, uint64_t align) {
+  if (align == 0 || (align & (align - 1)) != 0)
+    return nullptr;
+  Arena &a = s_arenas[current_cpu()];
+  for (;;) {
+    if (a.current != nullptr) {
+      const uint64_t start = (a.offset + align - 1) & ~(align - 1);
+      if (start <= a.current->size && a.current->size - start >= bytes) {
+        a.used += start + bytes - a.offset;
+        a.offset = start + bytes;
+        return reinterpret_cast<uint8_t *>(a.current) + start;
+      }
+      // Move on to the next chunk, or grow the chain
+      if (a.current->next == nullptr) {
+        Chunk *c = new_chunk(bytes + align);
+        if (c == nullptr)
+          return nullptr;
+        a.current->next = c;
+      }
+      a.current = a.current->next;
+    } else {
+      a.first = new_chunk(bytes + align);
+      if (a.first == nullptr)
+        return nullptr;
+      a.current = a.first;
+    }
+    a.offset = sizeof(Chunk);
+  }
+}
+
+void frame_reset() {
+  for (uint32_t i = 0; i < kMaxCpus; ++i) {
+    Arena &a = s_arenas[i];
+    if (a.used > s_peak)
+      s_peak = a.used;
+    a.current = a.first;
+    a.offset = sizeof(Chunk);
+    a.used = 0;
+  }
+}
+
+uint64_t frame_peak_bytes() { return s_peak; }
+
+} // namespace platform
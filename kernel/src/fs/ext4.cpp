@@ -1,4 +1,5 @@
 #include "ext4.hpp"
+#include "../../../ui/include/frame_arena.hpp"
 
 namespace fs {
 
@@ -80,10 +81,10 @@ bool Ext4::mount() {
   return true;
 }
 
-bool Ext4::read_file_by_path(const char *path, void *buffer, uint64_t max_size,
+bool Ext4::read_file_by_path(const Path &path, void *buffer, uint64_t max_size,
                              uint64_t &out_size) {
   out_size = 0;
-  if (!mounted_ || !path || !buffer)
+  if (!mounted_ || !buffer)
     return false;
 
   // Helper lambdas that can access private members via 'this'
@@ -178,49 +179,22 @@ bool Ext4::read_file_by_path(const char *path, void *buffer, uint64_t max_size,
     return false;
   };
 
-  // Resolve path to an inode number
+  // Resolve path to an inode number. The path is already normalised, so its
+  // components are plain names.
   uint64_t cur_inode = 2; // root
   uint8_t cur_type = 2;   // directory
-  const char *p = path;
-  if (!p || p[0] == '\0') {
-    // stay at root
-  } else {
-    if (*p == '/')
-      ++p;
-    while (*p) {
-      char name_buf[64];
-      uint32_t len = 0;
-      while (*p && *p != '/' && len + 1 < sizeof(name_buf))
-        name_buf[len++] = *p++;
-      name_buf[len] = '\0';
-      if (len == 0) {
-        if (*p == '/') {
-          ++p;
-          continue;
-        }
-        break;
-      }
-      // Handle '.' and '..' trivially (".." not implemented fully; treat as
-      // root)
-      if (len == 1 && name_buf[0] == '.') {
-        // no-op
-      } else if (len == 2 && name_buf[0] == '.' && name_buf[1] == '.') {
-        cur_inode = 2;
-        cur_type = 2; // simplistic up-to-root
-      } else {
-        InodeRaw dir_inode{};
-        if (!read_inode(cur_inode, dir_inode))
-          return false;
-        uint64_t next_inode = 0;
-        uint8_t next_type = 0;
-        if (!scan_dir_for(dir_inode, name_buf, len, next_inode, next_type))
-          return false;
-        cur_inode = next_inode;
-        cur_type = next_type;
-      }
-      if (*p == '/')
-        ++p;
-    }
+  for (uint32_t c = 0; c < path.depth(); ++c) {
+    uint32_t len = 0;
+    const char *name = path.component(c, len);
+    InodeRaw dir_inode{};
+    if (!read_inode(cur_inode, dir_inode))
+      return false;
+    uint64_t next_inode = 0;
+    uint8_t next_type = 0;
+    if (!scan_dir_for(dir_inode, name, len, next_inode, next_type))
+      return false;
+    cur_inode = next_inode;
+    cur_type = next_type;
   }
 
   // Only read files
@@ -283,7 +257,7 @@ bool Ext4::read_file_by_path(const char *path, void *buffer, uint64_t max_size,
   return true;
 }
 
-bool Ext4::list_dir_by_path(const char *path, Dirent *entries,
+bool Ext4::list_dir_by_path(const Path &path, Dirent *entries,
                             uint32_t max_entries, uint32_t &out_count) {
   out_count = 0;
   if (!mounted_)
@@ -380,49 +354,22 @@ bool Ext4::list_dir_by_path(const char *path, Dirent *entries,
     return false;
   };
 
-  // Resolve path to an inode number
+  // Resolve path to an inode number. The path is already normalised, so its
+  // components are plain names.
   uint64_t cur_inode = 2; // root
   uint8_t cur_type = 2;   // directory
-  const char *p = path;
-  if (!p || p[0] == '\0') {
-    // stay at root
-  } else {
-    if (*p == '/')
-      ++p;
-    while (*p) {
-      char name_buf[64];
-      uint32_t len = 0;
-      while (*p && *p != '/' && len + 1 < sizeof(name_buf))
-        name_buf[len++] = *p++;
-      name_buf[len] = '\0';
-      if (len == 0) {
-        if (*p == '/') {
-          ++p;
-          continue;
-        }
-        break;
-      }
-      // Handle '.' and '..' trivially (".." not implemented fully; treat as
-      // root)
-      if (len == 1 && name_buf[0] == '.') {
-        // no-op
-      } else if (len == 2 && name_buf[0] == '.' && name_buf[1] == '.') {
-        cur_inode = 2;
-        cur_type = 2; // simplistic up-to-root
-      } else {
-        InodeRaw dir_inode{};
-        if (!read_inode(cur_inode, dir_inode))
-          return false;
-        uint64_t next_inode = 0;
-        uint8_t next_type = 0;
-        if (!scan_dir_for(dir_inode, name_buf, len, next_inode, next_type))
-          return false;
-        cur_inode = next_inode;
-        cur_type = next_type;
-      }
-      if (*p == '/')
-        ++p;
-    }
+  for (uint32_t c = 0; c < path.depth(); ++c) {
+    uint32_t len = 0;
+    const char *name = path.component(c, len);
+    InodeRaw dir_inode{};
+    if (!read_inode(cur_inode, dir_inode))
+      return false;
+    uint64_t next_inode = 0;
+    uint8_t next_type = 0;
+    if (!scan_dir_for(dir_inode, name, len, next_inode, next_type))
+      return false;
+    cur_inode = next_inode;
+    cur_type = next_type;
   }
 
   // Only list directories
@@ -440,23 +387,21 @@ bool Ext4::list_dir_by_path(const char *path, Dirent *entries,
       if (de->rec_len < 8 || de->rec_len == 0 ||
           offset + de->rec_len > block_size_)
         break;
-      if (de->inode != 0 && de->name_len > 0) {
-        if (out_count < max_entries) {
-          static char names_bank[128][64];
-          if (de->name_len < 64) {
-            for (uint32_t i = 0; i < de->name_len; ++i)
-              names_bank[out_count][i] =
-                  reinterpret_cast<const char *>(de + 1)[i];
-            names_bank[out_count][de->name_len] = '\0';
-            entries[out_count].name = names_bank[out_count];
-            entries[out_count].name_len = de->name_len;
-            entries[out_count].inode = de->inode;
-            entries[out_count].type = (de->file_type == 2) ? NodeType::Directory
-                                      : (de->file_type == 1)
-                                          ? NodeType::File
-                                          : NodeType::Unknown;
-            out_count++;
-          }
+      if (de->inode != 0 && de->name_len > 0 && out_count < max_entries) {
+        // Names are frame scratch of the calling CPU, so listings made while
+        // windows render in parallel do not overwrite each other
+        char *name = platform::frame_alloc_array<char>(de->name_len + 1u);
+        if (name != nullptr) {
+          for (uint32_t i = 0; i < de->name_len; ++i)
+            name[i] = reinterpret_cast<const char *>(de + 1)[i];
+          name[de->name_len] = '\0';
+          entries[out_count].name = name;
+          entries[out_count].name_len = de->name_len;
+          entries[out_count].inode = de->inode;
+          entries[out_count].type = (de->file_type == 2)   ? NodeType::Directory
+                                    : (de->file_type == 1) ? NodeType::File
+                                                           : NodeType::Unknown;
+          out_count++;
         }
       }
       offset += de->rec_len;
@@ -45,9 +45,9 @@ public:
   bool mount() override;
   bool is_mounted() const override { return mounted_; }
 
-  bool read_file_by_path(const char *path, void *buffer, uint64_t max_size,
+  bool read_file_by_path(const Path &path, void *buffer, uint64_t max_size,
                          uint64_t &out_size) override;
-  bool list_dir_by_path(const char *path, Dirent *entries, uint32_t max_entries,
+  bool list_dir_by_path(const Path &path, Dirent *entries, uint32_t max_entries,
                         uint32_t &out_count) override;
 
 private:
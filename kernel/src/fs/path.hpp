@@ -0,0 +1,121 @@
+// Absolute paths with inline storage
+#pragma once
+
+#include <cstdint>
+
+namespace fs {
+
+// A normalised absolute path ("/", "/docs", "/docs/notes.txt") kept inline,
+// with the offset of every component recorded as it is added. Appending a
+// name copies only that name, going to the parent is a truncation, and a
+// lookup walks the recorded components instead of re-scanning the string.
+// Copies (and so moves) touch only the bytes in use. A default-constructed
+// or zeroed Path is the root.
+class Path {
+public:
+  static constexpr uint32_t kMaxLength = 255; // bytes, without the null
+  static constexpr uint32_t kMaxDepth = 32;   // components
+
+  Path() = default;
+  explicit Path(const char *path) { assign(path); }
+
+  Path(const Path &other) { copy_from(other); }
+  Path &operator=(const Path &other) {
+    if (this != &other)
+      copy_from(other);
+    return *this;
+  }
+
+  // Replace the path with the parse of path. Empty components and "." are
+  // dropped and ".." goes up, so relative paths resolve from the root.
+  // Returns false if a component did not fit; the path then holds what did.
+  bool assign(const char *path) {
+    len_ = 0;
+    depth_ = 0;
+    if (path == nullptr)
+      return true;
+    while (*path != '\0') {
+      uint32_t len = 0;
+      while (path[len] != '\0' && path[len] != '/')
+        ++len;
+      if (len > 0 && !append(path, len))
+        return false;
+      path += len;
+      if (*path == '/')
+        ++path;
+    }
+    return true;
+  }
+
+  // Add the component name[0, len), which must not contain '/'. "." is a
+  // no-op and ".." goes up (staying at the root). Returns false, leaving the
+  // path unchanged, if the name is empty or invalid or the path would exceed
+  // kMaxLength or kMaxDepth.
+  bool append(const char *name, uint32_t len) {
+    if (len == 0 || (name[0] == '.' && len == 1))
+      return len != 0;
+    if (name[0] == '.' && name[1] == '.' && len == 2) {
+      parent();
+      return true;
+    }
+    if (depth_ == kMaxDepth || len_ + 1 + len > kMaxLength)
+      return false;
+    char *out = buf_ + len_ + 1;
+    for (uint32_t i = 0; i < len; ++i) {
+      if (name[i] == '/' || name[i] == '\0')
+        return false;
+      out[i] = name[i];
+    }
+    buf_[len_] = '/';
+    offsets_[depth_++] = static_cast<uint16_t>(len_ + 1);
+    len_ = static_cast<uint16_t>(len_ + 1 + len);
+    buf_[len_] = '\0';
+    return true;
+  }
+
+  // Drop the last component. Returns false at the root.
+  bool parent() {
+    if (depth_ == 0)
+      return false;
+    len_ = static_cast<uint16_t>(offsets_[--depth_] - 1);
+    buf_[len_] = '\0';
+    return true;
+  }
+
+  bool is_root() const { return depth_ == 0; }
+  uint32_t depth() const { return depth_; }
+  uint32_t length() const { return depth_ == 0 ? 1 : len_; }
+  const char *c_str() const { return depth_ == 0 ? "/" : buf_; }
+
+  // Component i, counting from the root, and its length; not null-terminated
+  // except for the last one
+  const char *component(uint32_t i, uint32_t &len) const {
+    const uint32_t end = i + 1 < depth_ ? offsets_[i + 1] - 1u : len_;
+    len = end - offsets_[i];
+    return buf_ + offsets_[i];
+  }
+
+  // The last component, "" at the root
+  const char *name() const {
+    return depth_ == 0 ? "" : buf_ + offsets_[depth_ - 1];
+  }
+
+private:
+  void copy_from(const Path &other) {
+    len_ = other.len_;
+    depth_ = other.depth_;
+    if (depth_ == 0)
+      return;
+    for (uint32_t i = 0; i <= len_; ++i)
+      buf_[i] = other.buf_[i];
+    for (uint32_t i = 0; i < depth_; ++i)
+      offsets_[i] = other.offsets_[i];
+  }
+
+  char buf_[kMaxLength + 1];
+  uint16_t offsets_[kMaxDepth]; // start of each component in buf_
+  uint16_t len_ = 0;            // bytes in buf_, 0 at the root
+  uint16_t depth_ = 0;
+};
+
+} // namespace fs
@@ -1,6 +1,7 @@
 // Minimal VFS interfaces and path helpers
 #pragma once
 
+#include "path.hpp"
 #include <cstdint>
 
 namespace fs {
@@ -27,9 +28,11 @@ public:
   virtual ~Filesystem() = default;
   virtual bool mount() = 0;
   virtual bool is_mounted() const = 0;
-  virtual bool read_file_by_path(const char *path, void *buffer,
+  virtual bool read_file_by_path(const Path &path, void *buffer,
                                  uint64_t max_size, uint64_t &out_size) = 0;
-  virtual bool list_dir_by_path(const char *path, Dirent *entries,
+  // Entry names are frame scratch (platform::frame_alloc()), valid until the
+  // event loop's next pass
+  virtual bool list_dir_by_path(const Path &path, Dirent *entries,
                                 uint32_t max_entries, uint32_t &out_count) = 0;
 };
 
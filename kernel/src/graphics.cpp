@@ -1,5 +1,23 @@
 #include "graphics.hpp"
 #include "font.hpp"
+#include "mm/vmm.hpp"
+
+Graphics::Graphics() {
+  framebuffer = nullptr;
+  fb_ptr = nullptr;
+  width = 0;
+  height = 0;
+  pitch = 0;
+  origin_x = origin_y = 0;
+  backbuffer = nullptr;
+  backbuffer_capacity_pixels = 0;
+  use_backbuffer = false;
+  direct_scanout = false;
+  vsync_enabled = false;
+  clip_enabled = false;
+  clip_x0 = clip_y0 = 0;
+  clip_x1 = clip_y1 = 0;
+}
 
 Graphics::Graphics(limine_framebuffer *fb) {
   framebuffer = fb;
@@ -7,33 +25,97 @@ Graphics::Graphics(limine_framebuffer *fb) {
   width = framebuffer->width;
   height = framebuffer->height;
   pitch = framebuffer->pitch / 4; // Assuming 32-bit pixels
+  origin_x = origin_y = 0;
   backbuffer = nullptr;
   backbuffer_capacity_pixels = 0;
   use_backbuffer = false;
+  direct_scanout = false;
   vsync_enabled = true;
   clip_enabled = false;
   clip_x0 = clip_y0 = 0;
   clip_x1 = clip_y1 = 0;
 }
 
+Graphics::Graphics(uint32_t *pixels, uint32_t w, uint32_t h, uint32_t stride) {
+  framebuffer = nullptr;
+  fb_ptr = pixels;
+  width = w;
+  height = h;
+  pitch = stride;
+  origin_x = origin_y = 0;
+  backbuffer = nullptr;
+  backbuffer_capacity_pixels = 0;
+  use_backbuffer = false;
+  direct_scanout = false;
+  vsync_enabled = false;
+  clip_enabled = false;
+  clip_x0 = clip_y0 = 0;
+  clip_x1 = clip_y1 = 0;
+}
+
+bool Graphics::to_local(uint32_t &x0, uint32_t &y0, uint32_t &x1,
+                        uint32_t &y1) const {
+  x0 = x0 > origin_x ? x0 - origin_x : 0;
+  x1 = x1 > origin_x ? x1 - origin_x : 0;
+  y0 = y0 > origin_y ? y0 - origin_y : 0;
+  y1 = y1 > origin_y ? y1 - origin_y : 0;
+  if (x1 > width)
+    x1 = width;
+  if (y1 > height)
+    y1 = height;
+  return x0 < x1 && y0 < y1;
+}
+
+bool Graphics::clip_bounds(uint32_t &x0, uint32_t &y0, uint32_t &x1,
+                           uint32_t &y1) const {
+  if (clip_enabled) {
+    if (x0 < clip_x0)
+      x0 = clip_x0;
+    if (y0 < clip_y0)
+      y0 = clip_y0;
+    if (x1 > clip_x1)
+      x1 = clip_x1;
+    if (y1 > clip_y1)
+      y1 = clip_y1;
+    if (x0 >= x1 || y0 >= y1)
+      return false;
+  }
+  return to_local(x0, y0, x1, y1);
+}
+
+bool Graphics::is_visible(uint32_t x, uint32_t y, uint32_t w,
+                          uint32_t h) const {
+  uint32_t x1 = x + w;
+  uint32_t y1 = y + h;
+  return clip_bounds(x, y, x1, y1);
+}
+
 void Graphics::set_pixel(uint32_t x, uint32_t y, uint32_t color) {
-  if (x >= width || y >= height)
-    return;
   if (clip_enabled) {
     if (x < clip_x0 || x >= clip_x1 || y < clip_y0 || y >= clip_y1)
       return;
   }
+  if (x < origin_x || y < origin_y)
+    return;
+  x -= origin_x;
+  y -= origin_y;
+  if (x >= width || y >= height)
+    return;
   if (use_backbuffer) {
-    backbuffer[y * width + x] = color;
+    backbuffer[y * pitch + x] = color;
   } else {
     fb_ptr[y * pitch + x] = color;
   }
 }
 
 uint32_t Graphics::get_pixel(uint32_t x, uint32_t y) {
+  if (x < origin_x || y < origin_y)
+    return 0;
+  x -= origin_x;
+  y -= origin_y;
   if (x < width && y < height) {
     if (use_backbuffer) {
-      return backbuffer[y * width + x];
+      return backbuffer[y * pitch + x];
     }
     return fb_ptr[y * pitch + x];
   }
@@ -45,6 +127,9 @@ void Graphics::draw_char(char c, uint32_t x, uint32_t y, uint32_t color,
   if (c < 32 || c > 126)
     return; // Only printable ASCII
 
+  if (!is_visible(x, y, font.char_width, font.char_height))
+    return;
+
   uint32_t char_index = c - 32;
   // Each character is 8 bytes (8 rows), so we need to access the correct
   // character data
@@ -102,14 +187,31 @@ void Graphics::draw_bitmap_rgba(const uint32_t *bitmap, uint32_t x, uint32_t y,
   }
 }
 
-void Graphics::clear_screen(uint32_t color) {
-  for (uint32_t y = 0; y < height; y++) {
-    for (uint32_t x = 0; x < width; x++) {
-      set_pixel(x, y, color);
+void Graphics::blit(const uint32_t *src, uint32_t src_pitch, uint32_t x,
+                    uint32_t y, uint32_t w, uint32_t h) {
+  uint32_t x0 = x;
+  uint32_t y0 = y;
+  uint32_t x1 = x + w;
+  uint32_t y1 = y + h;
+  if (!clip_bounds(x0, y0, x1, y1))
+    return;
+  uint32_t *base = use_backbuffer ? backbuffer : fb_ptr;
+  const uint32_t stride = pitch;
+  // Source offsets are in desktop coordinates
+  const uint32_t sx = x0 + origin_x - x;
+  for (uint32_t py = y0; py < y1; py++) {
+    const uint32_t *s = &src[(py + origin_y - y) * src_pitch + sx];
+    uint32_t *d = &base[py * stride + x0];
+    for (uint32_t px = x0; px < x1; px++) {
+      *d++ = *s++;
     }
   }
 }
 
+void Graphics::clear_screen(uint32_t color) {
+  fill_rect(origin_x, origin_y, width, height, color);
+}
+
 void Graphics::draw_string_centered(const char *str, uint32_t y, uint32_t color,
                                     const Font &font) {
   // Calculate string width
@@ -121,7 +223,7 @@ void Graphics::draw_string_centered(const char *str, uint32_t y, uint32_t color,
   }
 
   // Calculate x position to center the string
-  uint32_t x = (width - string_width) / 2;
+  uint32_t x = origin_x + (width - string_width) / 2;
   draw_string(str, x, y, color, font);
 }
 
@@ -175,13 +277,39 @@ void Graphics::draw_string_centered_scaled(const char *str, uint32_t y,
   }
 
   // Calculate x position to center the string
-  uint32_t x = (width - string_width) / 2;
+  uint32_t x = origin_x + (width - string_width) / 2;
   draw_string_scaled(str, x, y, color, font, scale);
 }
 
 bool Graphics::load_bmp(const uint8_t *bmp_data, uint32_t data_size,
                         uint32_t *&image_data, uint32_t &width,
                         uint32_t &height) {
+  // A shared buffer of up to 1024x1024 pixels, reserved on first use; only
+  // the pages an image actually fills get committed
+  static constexpr uint32_t kBufferPixels = 1024 * 1024;
+  static uint32_t *image_buffer = nullptr;
+  if (data_size < sizeof(BMPHeader)) {
+    return false;
+  }
+  const BMPHeader *header = reinterpret_cast<const BMPHeader *>(bmp_data);
+  // Check if the image is too large for the buffer
+  if (header->width > 1024 || header->height > 1024) {
+    return false;
+  }
+  if (image_buffer == nullptr)
+    image_buffer = static_cast<uint32_t *>(
+        mm::vmm::reserve(kBufferPixels * sizeof(uint32_t),
+                         platform::MemTag::Gfx));
+  if (image_buffer == nullptr)
+    return false;
+  image_data = image_buffer;
+  return load_bmp(bmp_data, data_size, image_buffer, kBufferPixels, width,
+                  height);
+}
+
+bool Graphics::load_bmp(const uint8_t *bmp_data, uint32_t data_size,
+                        uint32_t *image_data, uint32_t capacity_pixels,
+                        uint32_t &width, uint32_t &height) {
   if (data_size < sizeof(BMPHeader)) {
     return false;
   }
@@ -204,21 +332,24 @@ bool Graphics::load_bmp(const uint8_t *bmp_data, uint32_t data_size,
     return false;
   }
 
+  // Only bottom-up images that fit the destination
+  if (header->width <= 0 || header->height <= 0) {
+    return false;
+  }
   width = static_cast<uint32_t>(header->width);
   height = static_cast<uint32_t>(header->height);
-
-  // Check if the image is too large for stack allocation
-  if (width > 1024 || height > 1024 || width * height > 1024 * 1024) {
+  if (uint64_t(width) * height > capacity_pixels) {
     return false;
   }
 
-  // Use static buffer instead of dynamic allocation
-  static uint32_t image_buffer[1024 * 1024]; // 1MB buffer
-  image_data = image_buffer;
-
   // Calculate row size (BMP rows are padded to 4-byte boundaries)
   uint32_t row_size = (width * header->bits_per_pixel + 31) / 32 * 4;
 
+  // Pixel rows must lie within the data
+  if (header->data_offset + uint64_t(row_size) * height > data_size) {
+    return false;
+  }
+
   // Get pointer to color palette (for 8-bit BMPs)
   const uint8_t *palette_ptr = bmp_data + sizeof(BMPHeader);
 
@@ -283,7 +414,7 @@ void Graphics::draw_bmp_centered(const uint8_t *bmp_data, uint32_t data_size,
   uint32_t width, height;
 
   if (load_bmp(bmp_data, data_size, image_data, width, height)) {
-    uint32_t x = (this->width - width) / 2;
+    uint32_t x = origin_x + (this->width - width) / 2;
     draw_bitmap_rgba(image_data, x, y, width, height);
   }
 }
@@ -310,9 +441,17 @@ void Graphics::draw_rect(uint32_t x, uint32_t y, uint32_t w, uint32_t h,
 
 void Graphics::fill_rect(uint32_t x, uint32_t y, uint32_t w, uint32_t h,
                          uint32_t color) {
-  for (uint32_t py = 0; py < h; py++) {
-    for (uint32_t px = 0; px < w; px++) {
-      set_pixel(x + px, y + py, color);
+  // Clip once up front instead of per pixel
+  uint32_t x1 = x + w;
+  uint32_t y1 = y + h;
+  if (!clip_bounds(x, y, x1, y1))
+    return;
+  uint32_t *base = use_backbuffer ? backbuffer : fb_ptr;
+  const uint32_t stride = pitch;
+  for (uint32_t py = y; py < y1; py++) {
+    uint32_t *row = &base[py * stride];
+    for (uint32_t px = x; px < x1; px++) {
+      row[px] = color;
     }
   }
 }
@@ -324,11 +463,10 @@ void Graphics::enable_backbuffer(uint32_t *buffer, uint32_t capacity_pixels) {
     backbuffer_capacity_pixels = 0;
     return;
   }
-  const uint32_t needed = width * height;
-  if (capacity_pixels >= needed) {
+  if (capacity_pixels >= backbuffer_pixels()) {
     backbuffer = buffer;
     backbuffer_capacity_pixels = capacity_pixels;
-    use_backbuffer = true;
+    use_backbuffer = !direct_scanout;
   } else {
     use_backbuffer = false;
     backbuffer = nullptr;
@@ -336,6 +474,11 @@ void Graphics::enable_backbuffer(uint32_t *buffer, uint32_t capacity_pixels) {
   }
 }
 
+void Graphics::set_direct_scanout(bool enabled) {
+  direct_scanout = enabled;
+  use_backbuffer = !enabled && backbuffer != nullptr;
+}
+
 // VGA-compatible vblank wait using status register 0x3DA where available.
 // On non-x86_64 or when not applicable (e.g., pure framebuffer without VGA
 // emulation), this becomes a short busy-wait to throttle present slightly.
@@ -363,36 +506,33 @@ void Graphics::wait_for_vblank() {
 #endif
 }
 
-void Graphics::present() {
+void Graphics::present(bool sync) {
   if (!use_backbuffer)
     return;
-  if (vsync_enabled) {
+  if (sync && vsync_enabled) {
     wait_for_vblank();
   }
   for (uint32_t y = 0; y < height; y++) {
     for (uint32_t x = 0; x < width; x++) {
-      fb_ptr[y * pitch + x] = backbuffer[y * width + x];
+      fb_ptr[y * pitch + x] = backbuffer[y * pitch + x];
     }
   }
 }
 
-void Graphics::present_rect(uint32_t x0, uint32_t y0, uint32_t w, uint32_t h) {
+void Graphics::present_rect(uint32_t x0, uint32_t y0, uint32_t w, uint32_t h,
+                            bool sync) {
   if (!use_backbuffer)
     return;
-  if (x0 >= width || y0 >= height)
+  uint32_t x1 = x0 + w;
+  uint32_t y1 = y0 + h;
+  if (!to_local(x0, y0, x1, y1))
     return;
-  if (vsync_enabled) {
+  if (sync && vsync_enabled) {
     wait_for_vblank();
   }
-  uint32_t x1 = x0 + w;
-  if (x1 > width)
-    x1 = width;
-  uint32_t y1 = y0 + h;
-  if (y1 > height)
-    y1 = height;
   for (uint32_t y = y0; y < y1; ++y) {
     uint32_t *dst = &fb_ptr[y * pitch + x0];
-    uint32_t *src = &backbuffer[y * width + x0];
+    uint32_t *src = &backbuffer[y * pitch + x0];
     for (uint32_t x = x0; x < x1; ++x) {
       *dst++ = *src++;
     }
@@ -11,10 +11,16 @@ private:
   uint32_t height;
   uint32_t pitch;
 
+  // Position of this target on the desktop. Drawing coordinates are desktop
+  // coordinates; each output sees only its own slice.
+  uint32_t origin_x;
+  uint32_t origin_y;
+
   // Optional software backbuffer for double-buffering
   uint32_t *backbuffer;
   uint32_t backbuffer_capacity_pixels;
   bool use_backbuffer;
+  bool direct_scanout;
   bool vsync_enabled;
 
   // Optional clipping rectangle
@@ -27,8 +33,19 @@ private:
   // Wait for start of vertical blanking interval (if available)
   void wait_for_vblank();
 
+  // Translate desktop [x0,x1)x[y0,y1) to target coordinates, clamped to the
+  // target; false if empty
+  bool to_local(uint32_t &x0, uint32_t &y0, uint32_t &x1, uint32_t &y1) const;
+  // Like to_local() but also intersected with the clip rect
+  bool clip_bounds(uint32_t &x0, uint32_t &y0, uint32_t &x1,
+                   uint32_t &y1) const;
+
 public:
+  // Placeholder without a target; assign a real one before drawing
+  Graphics();
   Graphics(limine_framebuffer *fb);
+  // Offscreen target drawing into caller-owned pixels (pitch in pixels)
+  Graphics(uint32_t *pixels, uint32_t width, uint32_t height, uint32_t pitch);
 
   // Basic pixel operations
   void set_pixel(uint32_t x, uint32_t y, uint32_t color);
@@ -38,6 +55,14 @@ public:
   inline uint32_t get_width() const { return width; }
   inline uint32_t get_height() const { return height; }
 
+  // Desktop position of the target's top-left pixel
+  inline void set_origin(uint32_t x, uint32_t y) {
+    origin_x = x;
+    origin_y = y;
+  }
+  inline uint32_t get_origin_x() const { return origin_x; }
+  inline uint32_t get_origin_y() const { return origin_y; }
+
   // Text rendering
   void draw_char(char c, uint32_t x, uint32_t y, uint32_t color,
                  const Font &font);
@@ -57,9 +82,12 @@ public:
                    uint32_t width, uint32_t height, uint32_t color);
   void draw_bitmap_rgba(const uint32_t *bitmap, uint32_t x, uint32_t y,
                         uint32_t width, uint32_t height);
+  // Opaque copy of a pixel block (pitch in pixels), honoring the clip rect
+  void blit(const uint32_t *src, uint32_t src_pitch, uint32_t x, uint32_t y,
+            uint32_t w, uint32_t h);
 
-  // BMP file support
-  struct BMPHeader {
+  // BMP file support (file header followed by the BITMAPINFOHEADER)
+  struct __attribute__((packed)) BMPHeader {
     uint16_t signature;         // 'BM'
     uint32_t file_size;         // Size of the file
     uint16_t reserved1;         // Reserved
@@ -78,8 +106,13 @@ public:
     uint32_t important_colors;  // Important colors
   };
 
+  // Decode into a shared static buffer, up to 1024x1024
   bool load_bmp(const uint8_t *bmp_data, uint32_t data_size,
                 uint32_t *&image_data, uint32_t &width, uint32_t &height);
+  // Decode into caller-owned pixels (at least width * height), any size
+  static bool load_bmp(const uint8_t *bmp_data, uint32_t data_size,
+                       uint32_t *pixels, uint32_t capacity_pixels,
+                       uint32_t &width, uint32_t &height);
   void draw_bmp(const uint8_t *bmp_data, uint32_t data_size, uint32_t x,
                 uint32_t y);
   void draw_bmp_centered(const uint8_t *bmp_data, uint32_t data_size,
@@ -92,10 +125,23 @@ public:
   void fill_rect(uint32_t x, uint32_t y, uint32_t w, uint32_t h,
                  uint32_t color);
 
-  // Double buffering control
+  // Double buffering control. The backbuffer shares the framebuffer's pitch,
+  // so it needs backbuffer_pixels() pixels.
+  inline uint32_t backbuffer_pixels() const { return pitch * height; }
   void enable_backbuffer(uint32_t *buffer, uint32_t capacity_pixels);
-  void present();
-  void present_rect(uint32_t x, uint32_t y, uint32_t w, uint32_t h);
+  // Pass sync = false for all but the first of several presents that make up
+  // one frame (other rects, other outputs), so only one vblank wait happens.
+  void present(bool sync = true);
+  // Copy one rect (desktop coordinates) to the framebuffer
+  void present_rect(uint32_t x, uint32_t y, uint32_t w, uint32_t h,
+                    bool sync = true);
+
+  // Direct scanout: while enabled, drawing goes straight to the framebuffer
+  // and present()/present_rect() do nothing, so a single fullscreen surface
+  // skips the backbuffer copy. Disabling returns to the backbuffer, whose
+  // contents are stale and need a full redraw.
+  void set_direct_scanout(bool enabled);
+  inline bool is_direct_scanout() const { return direct_scanout; }
 
   // VSync control
   inline void set_vsync_enabled(bool enabled) { vsync_enabled = enabled; }
@@ -110,4 +156,6 @@ public:
     clip_y1 = y + h;
   }
   inline void clear_clip() { clip_enabled = false; }
+  // False if drawing into the rect would be entirely clipped away
+  bool is_visible(uint32_t x, uint32_t y, uint32_t w, uint32_t h) const;
 };
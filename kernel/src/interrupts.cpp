@@ -0,0 +1,184 @@
+#include "interrupts.hpp"
+#include "../../ui/include/log.hpp"
+#include "../../ui/include/smp.hpp"
+#include "smp.hpp"
+
+namespace platform {
+
+static PageFaultHandler s_page_fault = nullptr;
+
+void set_page_fault_handler(PageFaultHandler handler) {
+  s_page_fault = handler;
+}
+
+#if defined(__x86_64__)
+
+// Registers as the entry stubs below leave them on the stack
+struct Frame {
+  uint64_t r15, r14, r13, r12, r11, r10, r9, r8;
+  uint64_t rbp, rdi, rsi, rdx, rcx, rbx, rax;
+  uint64_t vector;
+  uint64_t error; // 0 for exceptions without an error code
+  uint64_t rip, cs, rflags, rsp, ss;
+};
+
+struct __attribute__((packed)) IdtEntry {
+  uint16_t offset_lo;
+  uint16_t selector;
+  uint8_t ist;
+  uint8_t type;
+  uint16_t offset_mid;
+  uint32_t offset_hi;
+  uint32_t reserved;
+};
+
+// Operand of lgdt and lidt
+struct __attribute__((packed)) TablePointer {
+  uint16_t limit;
+  uint64_t base;
+};
+
+static constexpr uint32_t kExceptionCount = 32;
+static constexpr uint8_t kInterruptGate = 0x8E; // present, ring 0
+static constexpr uint64_t kPageFault = 14;
+
+// The kernel's own GDT: Limine's lives in bootloader-reclaimable memory,
+// which must not stay in use once that memory is handed out. Ring 0 only,
+// so a 64-bit code and a data segment are all it needs. Both are marked
+// accessed up front so the CPU never writes to the table.
+static constexpr uint16_t kKernelCode = 0x08;
+static constexpr uint16_t kKernelData = 0x10;
+static uint64_t s_gdt[] = {
+    0,
+    0x00AF9B000000FFFFull, // code: present, ring 0, executable, long mode
+    0x00CF93000000FFFFull, // data: present, ring 0, writable
+};
+
+static IdtEntry s_idt[kExceptionCount];
+
+extern "C" const uint64_t isr_stub_table[kExceptionCount];
+
+// One stub per exception pushes a uniform frame (a zero error code where the
+// CPU pushes none, then the vector) and joins the common path, which saves
+// the general registers and calls isr_dispatch(). The kernel is built
+// without SSE, so there is no other register state to save.
+asm(R"(
+.pushsection .text.isr_stubs,"ax",@progbits
+.macro ISR_STUB n
+isr_stub_\n:
+.if !(\n == 8 || (\n >= 10 && \n <= 14) || \n == 17 || \n == 21 || \n == 29 || \n == 30)
+  pushq $0
+.endif
+  pushq $\n
+  jmp isr_common
+.endm
+.irp n, 0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,21,22,23,24,25,26,27,28,29,30,31
+  ISR_STUB \n
+.endr
+isr_common:
+  pushq %rax
+  pushq %rbx
+  pushq %rcx
+  pushq %rdx
+  pushq %rsi
+  pushq %rdi
+  pushq %rbp
+  pushq %r8
+  pushq %r9
+  pushq %r10
+  pushq %r11
+  pushq %r12
+  pushq %r13
+  pushq %r14
+  pushq %r15
+  movq %rsp, %rdi
+  cld
+  call isr_dispatch
+  popq %r15
+  popq %r14
+  popq %r13
+  popq %r12
+  popq %r11
+  popq %r10
+  popq %r9
+  popq %r8
+  popq %rbp
+  popq %rdi
+  popq %rsi
+  popq %rdx
+  popq %rcx
+  popq %rbx
+  popq %rax
+  addq $16, %rsp
+  iretq
+.popsection
+.pushsection .rodata.isr_stub_table,"a",@progbits
+.balign 8
+.global isr_stub_table
+isr_stub_table:
+.irp n, 0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,21,22,23,24,25,26,27,28,29,30,31
+  .quad isr_stub_\n
+.endr
+.popsection
+)");
+
+extern "C" void isr_dispatch(Frame *f) {
+  uint64_t cr2 = 0;
+  if (f->vector == kPageFault) {
+    asm volatile("mov %%cr2, %0" : "=r"(cr2));
+    if (s_page_fault != nullptr && s_page_fault(cr2, f->error))
+      return;
+  }
+  log("cpu%u: exception %lu at 0x%lx, error 0x%lx, cr2 0x%lx, rsp 0x%lx\n",
+      current_cpu(), f->vector, f->rip, f->error, cr2, f->rsp);
+  for (;;)
+    asm volatile("cli; hlt");
+}
+
+// Switch the calling CPU to the kernel's GDT and IDT. CS is reloaded with a
+// far return and the data segments directly; FS and GS keep their base MSRs
+// (current_cpu() reads GS), so their selectors are left alone.
+static void load_tables(void *) {
+  const TablePointer gdtr{sizeof(s_gdt) - 1,
+                          reinterpret_cast<uint64_t>(s_gdt)};
+  asm volatile("lgdt %0\n"
+               "pushq %1\n"
+               "leaq 1f(%%rip), %%rax\n"
+               "pushq %%rax\n"
+               "lretq\n"
+               "1:\n"
+               "movw %w2, %%ds\n"
+               "movw %w2, %%es\n"
+               "movw %w2, %%ss\n"
+               :
+               : "m"(gdtr), "i"(kKernelCode), "r"(uint32_t(kKernelData))
+               : "rax", "memory");
+  const TablePointer idtr{sizeof(s_idt) - 1,
+                          reinterpret_cast<uint64_t>(s_idt)};
+  asm volatile("lidt %0" : : "m"(idtr));
+}
+
+void interrupts_init() {
+  for (uint32_t i = 0; i < kExceptionCount; ++i) {
+    const uint64_t stub = isr_stub_table[i];
+    IdtEntry &e = s_idt[i];
+    e.offset_lo = static_cast<uint16_t>(stub);
+    e.selector = kKernelCode;
+    e.ist = 0;
+    e.type = kInterruptGate;
+    e.offset_mid = static_cast<uint16_t>(stub >> 16);
+    e.offset_hi = static_cast<uint32_t>(stub >> 32);
+    e.reserved = 0;
+  }
+  load_tables(nullptr);
+  call_others(&load_tables, nullptr);
+}
+
+#else
+
+// Other architectures keep the firmware's exception setup for now
+void interrupts_init() {}
+
+#endif
+
+} // namespace platform
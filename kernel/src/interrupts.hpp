@@ -0,0 +1,20 @@
+// Descriptor tables and CPU exception handling
+#pragma once
+
+#include <cstdint>
+
+namespace platform {
+
+// Move the calling CPU and every started application processor onto the
+// kernel's own GDT and install handlers for the CPU exceptions. An exception
+// nobody handles logs the CPU state to serial and halts that CPU. Call after
+// smp_init() and before anything reuses bootloader-reclaimable memory.
+void interrupts_init();
+
+// Page fault hook: gets the faulting address and the error code, and returns
+// true once the fault is resolved so the access is retried
+using PageFaultHandler = bool (*)(uint64_t address, uint64_t error);
+
+void set_page_fault_handler(PageFaultHandler handler);
+
+} // namespace platform
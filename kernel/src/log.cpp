@@ -0,0 +1,135 @@
+#include "../../ui/include/log.hpp"
+#include <cstdarg>
+#include <cstdint>
+
+namespace platform {
+
+static bool s_serial_ready = false;
+
+#if defined(__x86_64__)
+
+static constexpr uint16_t kCom1 = 0x3F8;
+
+static inline void outb(uint16_t port, uint8_t val) {
+  asm volatile("outb %0, %1" : : "a"(val), "Nd"(port));
+}
+
+static inline uint8_t inb(uint16_t port) {
+  uint8_t ret;
+  asm volatile("inb %1, %0" : "=a"(ret) : "Nd"(port));
+  return ret;
+}
+
+void log_init() {
+  outb(kCom1 + 1, 0x00); // no interrupts
+  outb(kCom1 + 3, 0x80); // DLAB on
+  outb(kCom1 + 0, 0x01); // divisor 1: 115200 baud
+  outb(kCom1 + 1, 0x00);
+  outb(kCom1 + 3, 0x03); // 8N1, DLAB off
+  outb(kCom1 + 2, 0xC7); // FIFO on, cleared, 14-byte threshold
+  // Loopback self-test so a missing port does not stall every log call
+  outb(kCom1 + 4, 0x1E);
+  outb(kCom1 + 0, 0xAE);
+  if (inb(kCom1 + 0) != 0xAE) {
+    s_serial_ready = false;
+    return;
+  }
+  outb(kCom1 + 4, 0x0F); // normal operation
+  s_serial_ready = true;
+}
+
+static void put_char(char c) {
+  // Bounded wait for the transmit holding register to drain
+  for (int i = 0; i < 100000 && (inb(kCom1 + 5) & 0x20) == 0; ++i) {
+  }
+  outb(kCom1, static_cast<uint8_t>(c));
+}
+
+#else
+
+void log_init() { s_serial_ready = false; }
+
+static void put_char(char) {}
+
+#endif
+
+static void put_string(const char *s) {
+  for (; *s; ++s) {
+    if (*s == '\n')
+      put_char('\r');
+    put_char(*s);
+  }
+}
+
+static void put_unsigned(uint64_t v, uint32_t base) {
+  char buf[21];
+  uint32_t n = 0;
+  do {
+    const uint32_t d = static_cast<uint32_t>(v % base);
+    buf[n++] = static_cast<char>(d < 10 ? '0' + d : 'a' + d - 10);
+    v /= base;
+  } while (v != 0);
+  while (n > 0)
+    put_char(buf[--n]);
+}
+
+void log(const char *fmt, ...) {
+  if (!s_serial_ready || fmt == nullptr)
+    return;
+  va_list args;
+  va_start(args, fmt);
+  for (const char *p = fmt; *p; ++p) {
+    if (*p != '%') {
+      if (*p == '\n')
+        put_char('\r');
+      put_char(*p);
+      continue;
+    }
+    ++p;
+    uint32_t longs = 0;
+    while (*p == 'l') {
+      ++longs;
+      ++p;
+    }
+    switch (*p) {
+    case 's': {
+      const char *s = va_arg(args, const char *);
+      put_string(s ? s : "(null)");
+      break;
+    }
+    case 'c':
+      put_char(static_cast<char>(va_arg(args, int)));
+      break;
+    case 'd': {
+      const int64_t v = longs ? va_arg(args, int64_t) : va_arg(args, int);
+      if (v < 0) {
+        put_char('-');
+        put_unsigned(static_cast<uint64_t>(-(v + 1)) + 1, 10);
+      } else {
+        put_unsigned(static_cast<uint64_t>(v), 10);
+      }
+      break;
+    }
+    case 'u':
+    case 'x': {
+      const uint64_t v =
+          longs ? va_arg(args, uint64_t) : va_arg(args, unsigned int);
+      put_unsigned(v, *p == 'x' ? 16 : 10);
+      break;
+    }
+    case '%':
+      put_char('%');
+      break;
+    case '\0':
+      --p; // trailing '%': stop at the terminator
+      break;
+    default:
+      put_char('%');
+      put_char(*p);
+      break;
+    }
+  }
+  va_end(args);
+}
+
+} // namespace platform
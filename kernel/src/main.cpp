@@ -1,19 +1,34 @@
 #include "../../input/include/mouse.hpp"
+#include "../../ui/include/compositor.hpp"
 #include "../../ui/include/cursor.hpp"
+#include "../../ui/include/frame_arena.hpp"
+#include "../../ui/include/hit_test.hpp"
+#include "../../ui/include/layer_cache.hpp"
+#include "../../ui/include/log.hpp"
+#include "../../ui/include/mem_account.hpp"
 #include "../../ui/include/startmenu.hpp"
 #include "../../ui/include/taskbar.hpp"
+#include "../../ui/include/time.hpp"
 #include "../../ui/include/ui.hpp"
+#include "../../ui/include/wallpaper.hpp"
 #include "../../ui/include/window.hpp"
 #include "../../ui/include/window_manager.hpp"
 #include "apps/about.hpp"
 #include "apps/finder.hpp"
+#include "apps/memstats.hpp"
 #include "apps/start_ids.hpp"
 #include "apps/textviewer.hpp"
 #include "apps/welcome.hpp"
+#include "bench.hpp"
 #include "font.hpp"
 #include "fs/blockdev.hpp"
 #include "fs/ext4.hpp"
 #include "graphics.hpp"
+#include "interrupts.hpp"
+#include "mm/bootmem.hpp"
+#include "mm/pmm.hpp"
+#include "mm/vmm.hpp"
+#include "smp.hpp"
 #include <cstddef>
 #include <cstdint>
 #include <limine.h>
@@ -49,6 +64,28 @@ __attribute__((used,
                       .internal_module_count = 0,
                       .internal_modules = nullptr};
 
+__attribute__((used,
+               section(".limine_requests"))) volatile limine_memmap_request
+    memmap_request = {
+        .id = LIMINE_MEMMAP_REQUEST, .revision = 0, .response = nullptr};
+
+__attribute__((used, section(".limine_requests"))) volatile limine_hhdm_request
+    hhdm_request = {
+        .id = LIMINE_HHDM_REQUEST, .revision = 0, .response = nullptr};
+
+__attribute__((
+    used,
+    section(".limine_requests"))) volatile limine_executable_address_request
+    executable_address_request = {.id = LIMINE_EXECUTABLE_ADDRESS_REQUEST,
+                                  .revision = 0,
+                                  .response = nullptr};
+
+__attribute__((used, section(".limine_requests"))) volatile limine_mp_request
+    mp_request = {.id = LIMINE_MP_REQUEST,
+                  .revision = 0,
+                  .response = nullptr,
+                  .flags = 0};
+
 } // namespace
 
 // Finally, define the start and end markers for the Limine requests.
@@ -65,90 +102,104 @@ __attribute__((
 
 } // namespace
 
-// GCC and Clang reserve the right to generate calls to the following
-// 4 functions even if they are not directly called.
-// Implement them as the C specification mandates.
-// DO NOT remove or rename these functions, or stuff will eventually break!
-// They CAN be moved to a different .cpp file.
-
-extern "C" {
-
-void *memcpy(void *dest, const void *src, std::size_t n) {
-  auto *d = static_cast<uint8_t *>(dest);
-  const auto *s = static_cast<const uint8_t *>(src);
+// memcpy, memset, memmove and memcmp live in mem.cpp.
 
-  for (std::size_t i = 0; i < n; ++i) {
-    d[i] = s[i];
+// Halt and catch fire function. Not static: newdelete.cpp halts with it too.
+extern "C" void hcf() {
+  for (;;) {
+#if defined(__x86_64__)
+    asm("hlt");
+#endif
   }
-
-  return dest;
 }
 
-void *memset(void *buffer, int value, std::size_t count) {
-  auto *p = static_cast<std::uint8_t *>(buffer);
-  auto byte_value = static_cast<std::uint8_t>(value);
-
-  for (std::size_t i = 0; i < count; ++i) {
-    p[i] = byte_value;
-  }
-
-  return buffer;
+// The following stubs are required by the Itanium C++ ABI (the one we use,
+// regardless of the "Itanium" nomenclature).
+// Like the memory functions in mem.cpp, these stubs can live in any .cpp file,
+// but should not be removed, unless you know what you are doing.
+extern "C" {
+int __cxa_atexit(void (*)(void *), void *, void *) { return 0; }
+void __cxa_pure_virtual() { hcf(); }
+void *__dso_handle;
 }
 
-void *memmove(void *dest, const void *src, std::size_t n) {
-  auto *pdest = static_cast<std::uint8_t *>(dest);
-  const auto *psrc = static_cast<const std::uint8_t *>(src);
-
-  if (src > dest) {
-    for (std::size_t i = 0; i < n; i++) {
-      pdest[i] = psrc[i];
-    }
-  } else if (src < dest) {
-    for (std::size_t i = n; i > 0; i--) {
-      pdest[i - 1] = psrc[i - 1];
-    }
-  }
+namespace {
 
-  return dest;
+// Memory for a large buffer (backbuffers, cached layers, the wallpaper) of
+// any size, charged to tag for what it really uses. On our own page tables it
+// is reserved address space whose pages are committed, and charged, as they
+// are first touched, so an output or layer that is never drawn costs nothing;
+// otherwise it is exactly enough contiguous pages from the page allocator,
+// charged up front. Freed with free_buffer().
+void *alloc_buffer(uint64_t bytes, platform::MemTag tag) {
+  if (void *buffer = mm::vmm::reserve(bytes, tag))
+    return buffer;
+  const uint64_t pages = (bytes + mm::pmm::kPageSize - 1) / mm::pmm::kPageSize;
+  void *buffer = mm::pmm::alloc_contiguous(pages);
+  if (buffer != nullptr)
+    platform::mem_charge(tag, pages * mm::pmm::kPageSize);
+  return buffer;
 }
 
-int memcmp(const void *s1, const void *s2, std::size_t n) {
-  const auto *p1 = static_cast<const std::uint8_t *>(s1);
-  const auto *p2 = static_cast<const std::uint8_t *>(s2);
-
-  for (std::size_t i = 0; i < n; i++) {
-    if (p1[i] != p2[i]) {
-      return p1[i] < p2[i] ? -1 : 1;
-    }
+void free_buffer(void *buffer, uint64_t bytes, platform::MemTag tag) {
+  if (buffer == nullptr)
+    return;
+  if (mm::vmm::reserved(buffer)) {
+    mm::vmm::release(buffer);
+    return;
   }
-
-  return 0;
+  const uint64_t pages = (bytes + mm::pmm::kPageSize - 1) / mm::pmm::kPageSize;
+  mm::pmm::free_contiguous(buffer, pages);
+  platform::mem_uncharge(tag, pages * mm::pmm::kPageSize);
 }
-}
-
-// Halt and catch fire function.
-namespace {
 
-void hcf() {
-  for (;;) {
-#if defined(__x86_64__)
-    asm("hlt");
-#endif
+// Largest wallpaper accepted: 8192x8192, 256 MiB decoded. The file may add
+// a palette and row padding on top of 24 or 32-bit pixels.
+constexpr uint64_t kMaxWallpaperPixels = 0x4000000;
+constexpr uint64_t kMaxWallpaperFile = kMaxWallpaperPixels * 4 + (1u << 20);
+
+// Load the wallpaper BMP from the root filesystem and hand it to the UI. The
+// file is decoded once into its own buffer; scaling happens when the
+// background cache renders.
+bool load_wallpaper(fs::Filesystem &fs, const fs::Path &path) {
+  // The header tells the file and image sizes to allocate for
+  Graphics::BMPHeader header{};
+  uint64_t got = 0;
+  if (!fs.read_file_by_path(path, &header, sizeof(header), got) ||
+      got != sizeof(header) || header.signature != 0x4D42 ||
+      header.width <= 0 || header.height <= 0)
+    return false;
+  const uint64_t pixels = uint64_t(header.width) * uint64_t(header.height);
+  if (header.file_size < sizeof(header) ||
+      header.file_size > kMaxWallpaperFile || pixels > kMaxWallpaperPixels)
+    return false;
+
+  // The file is only needed while decoding
+  const uint64_t file_bytes = header.file_size;
+  const uint64_t image_bytes = pixels * sizeof(uint32_t);
+  void *file = alloc_buffer(file_bytes, platform::MemTag::FsCache);
+  void *image = alloc_buffer(image_bytes, platform::MemTag::Gfx);
+  uint32_t w = 0;
+  uint32_t h = 0;
+  const bool ok =
+      file != nullptr && image != nullptr &&
+      fs.read_file_by_path(path, file, file_bytes, got) &&
+      Graphics::load_bmp(static_cast<const uint8_t *>(file),
+                         static_cast<uint32_t>(got),
+                         static_cast<uint32_t *>(image),
+                         static_cast<uint32_t>(pixels), w, h);
+  free_buffer(file, file_bytes, platform::MemTag::FsCache);
+  if (!ok) {
+    free_buffer(image, image_bytes, platform::MemTag::Gfx);
+    return false;
   }
+  ui::wallpaper::set(static_cast<const uint32_t *>(image), w, h);
+  platform::log("wallpaper: %s, %ux%u\n", path.c_str(), w, h);
+  return true;
 }
 
 } // namespace
 
-// The following stubs are required by the Itanium C++ ABI (the one we use,
-// regardless of the "Itanium" nomenclature).
-// Like the memory functions above, these stubs can be moved to a different .cpp
-// file, but should not be removed, unless you know what you are doing.
-extern "C" {
-int __cxa_atexit(void (*)(void *), void *, void *) { return 0; }
-void __cxa_pure_virtual() { hcf(); }
-void *__dso_handle;
-}
-
 // Extern declarations for global constructors array.
 extern void (*__init_array[])();
 extern void (*__init_array_end[])();
@@ -167,29 +218,69 @@ extern "C" void kmain() {
     __init_array[i]();
   }
 
+  // Establish the timestamp tick rate used for frame pacing and latency
+  platform::calibrate_timestamp();
+  // Seed the software wall clock from the RTC; later reads use the counter
+  platform::clock_init();
+  // Serial debug log for tuning (frame budget decisions and the like)
+  platform::log_init();
+  // Bring up the other CPUs; they idle until the renderer hands out tiles
+  platform::smp_init(mp_request.response);
+  // Kernel GDT and exception handlers on every CPU, before anything reuses
+  // bootloader memory; page faults commit reserved buffers
+  platform::interrupts_init();
+
   // Ensure we got a framebuffer.
   if (framebuffer_request.response == nullptr ||
       framebuffer_request.response->framebuffer_count < 1) {
     hcf();
   }
 
-  // Fetch the first framebuffer.
-  limine_framebuffer *framebuffer =
-      framebuffer_request.response->framebuffers[0];
+  // One output per framebuffer, placed left to right on the desktop in the
+  // order Limine reports them. The first is the primary screen.
+  using ui::compositor::kMaxOutputs;
+  static Graphics s_output_gfx[kMaxOutputs];
+  static ui::compositor::Output s_outputs[kMaxOutputs];
+  uint32_t output_count = 0;
+  uint32_t desktop_w = 0;
+  uint32_t desktop_h = 0;
+  for (uint64_t i = 0; i < framebuffer_request.response->framebuffer_count &&
+                       output_count < kMaxOutputs;
+       ++i) {
+    limine_framebuffer *fb = framebuffer_request.response->framebuffers[i];
+    if (fb == nullptr || fb->bpp != 32)
+      continue;
+    Graphics &gfx = s_output_gfx[output_count];
+    gfx = Graphics(fb);
+    gfx.set_origin(desktop_w, 0);
+    s_outputs[output_count].gfx = &gfx;
+    s_outputs[output_count].rect = ui::Rect{
+        desktop_w, 0, static_cast<uint32_t>(fb->width),
+        static_cast<uint32_t>(fb->height)};
+    desktop_w += static_cast<uint32_t>(fb->width);
+    if (fb->height > desktop_h)
+      desktop_h = static_cast<uint32_t>(fb->height);
+    ++output_count;
+  }
+  if (output_count == 0)
+    hcf();
 
-  // Initialize graphics system
-  Graphics graphics(framebuffer);
+  // Boot progress is shown on the primary output
+  Graphics &graphics = s_output_gfx[0];
+  const uint32_t boot_w = graphics.get_width();
+  const uint32_t boot_h = graphics.get_height();
 
-  // Clear screen to white
-  graphics.clear_screen(0x000000);
+  // Clear screen to black
+  for (uint32_t i = 0; i < output_count; ++i)
+    s_output_gfx[i].clear_screen(0x000000);
 
   // Draw centered, scaled text below the logo
-  graphics.draw_string_centered_scaled("hOS 0.1", framebuffer->height / 2,
+  graphics.draw_string_centered_scaled("hOS 0.1", boot_h / 2,
                                        0xFFFFFF, default_font, 4);
 
   // Draw loading bar outline
-  int bar_x = static_cast<int>(framebuffer->width) / 2 - 100;
-  int bar_y = static_cast<int>(framebuffer->height) / 2 + 50;
+  int bar_x = static_cast<int>(boot_w) / 2 - 100;
+  int bar_y = static_cast<int>(boot_h) / 2 + 50;
   int bar_width = 200;
   int bar_height = 20;
 
@@ -239,9 +330,45 @@ extern "C" void kmain() {
   // Found modules/rootfs info ~40%
   set_progress(rootfs ? 40 : 20);
 
-  // Enable double-buffering backbuffer
-  static uint32_t backbuffer_storage[1920 * 1080];
-  graphics.enable_backbuffer(backbuffer_storage, 1920u * 1080u);
+  // Memory management first: the boot allocator only hands the memory map to
+  // the page allocator, and our own page tables (large pages for the direct
+  // map, write-combining framebuffers) let big buffers be committed lazily
+  if (memmap_request.response && hhdm_request.response &&
+      mm::bootmem::init(memmap_request.response,
+                        hhdm_request.response->offset) &&
+      mm::pmm::init(memmap_request.response, hhdm_request.response->offset)) {
+    mm::vmm::init(memmap_request.response, hhdm_request.response->offset,
+                  executable_address_request.response);
+    // Enable double-buffering: every output gets its own backbuffer, sized
+    // from its mode. Without memory for it an output draws straight to its
+    // framebuffer.
+    for (uint32_t i = 0; i < output_count; ++i) {
+      Graphics &gfx = s_output_gfx[i];
+      const uint32_t needed = gfx.backbuffer_pixels();
+      void *buffer = alloc_buffer(uint64_t(needed) * sizeof(uint32_t),
+                                  platform::MemTag::Gfx);
+      if (buffer != nullptr)
+        gfx.enable_backbuffer(static_cast<uint32_t *>(buffer), needed);
+    }
+    // Cached surfaces for the static layers: each output's background and
+    // the taskbar band of the primary output
+    for (uint32_t i = 0; i < output_count; ++i) {
+      Graphics &gfx = s_output_gfx[i];
+      const uint32_t pixels = gfx.get_width() * gfx.get_height();
+      void *surface = alloc_buffer(uint64_t(pixels) * sizeof(uint32_t),
+                                   platform::MemTag::Gfx);
+      if (surface != nullptr)
+        ui::layer_cache::attach_background(
+            gfx, static_cast<uint32_t *>(surface), pixels);
+    }
+    const uint32_t band_pixels =
+        graphics.get_width() * ui::taskbar::height(graphics.get_height());
+    void *band = alloc_buffer(uint64_t(band_pixels) * sizeof(uint32_t),
+                              platform::MemTag::Gfx);
+    if (band != nullptr)
+      ui::layer_cache::attach_taskbar(static_cast<uint32_t *>(band),
+                                      band_pixels);
+  }
   // Backbuffer enabled ~50%
   set_progress(50);
   graphics.present();
@@ -249,6 +376,8 @@ extern "C" void kmain() {
   // Compute initial centered window rect
   const uint32_t screen_w = graphics.get_width();
   const uint32_t screen_h = graphics.get_height();
+  ui::set_desktop(ui::Desktop{ui::Rect{0, 0, screen_w, screen_h},
+                              ui::Rect{0, 0, desktop_w, desktop_h}});
   const uint32_t taskbar_h = ui::taskbar::height(screen_h);
   const uint32_t usable_h = screen_h - taskbar_h - 20;
   const uint32_t usable_w = screen_w - 40;
@@ -258,20 +387,32 @@ extern "C" void kmain() {
     win_w = 320;
   if (win_h < 200)
     win_h = 200;
+#if defined(KERNEL_LEAK_CHECK)
+  // Report app state a window leaves behind when it closes (serial log).
+  // Off by default: while on, every heap allocation a window makes is
+  // recorded under the accounting lock.
+  platform::mem_set_leak_check(true);
+#endif
   // Create initial windows
-  ui::window::Window windows[16];
-  windows[0] = ui::apps::welcome::create_window(screen_w, screen_h);
-  windows[1] = ui::apps::about::create_window(screen_w, screen_h, windows[0]);
-  uint32_t window_count = 2;
-
-  // Saved rects for restore after maximize
-  ui::Rect saved_rects[16];
-  bool saved_rect_valid[16];
-  for (uint32_t i = 0; i < 16; ++i)
-    saved_rect_valid[i] = false;
+  ui::window_manager::WindowManager wm;
+  // Open an app window. What the app charges while creating it belongs to
+  // the window, so the leak checker can tell what closing it left behind.
+  auto open_app = [&wm](const auto &create) {
+    platform::MemOwnerScope owner(platform::mem_new_owner());
+    return wm.open(create());
+  };
+  // Hit-test map of the last drawn scene (large, so not on the stack)
+  static ui::hit_test::HitMap s_hit_map;
+  const ui::window_manager::WindowHandle welcome_win = open_app(
+      [&] { return ui::apps::welcome::create_window(screen_w, screen_h); });
+  open_app([&] {
+    return ui::apps::about::create_window(screen_w, screen_h,
+                                          *wm.get(welcome_win));
+  });
 
   // Draw desktop with windows (to backbuffer), then present
-  ui::draw_desktop(graphics, windows, window_count);
+  ui::prepare_windows(wm);
+  ui::draw_desktop(graphics, wm);
   // Draw overlay if any (none at boot)
   graphics.present();
   // Initial desktop drawn ~60%
@@ -292,12 +433,16 @@ extern "C" void kmain() {
       // Filesystem mounted ~80%
       set_progress(80);
       graphics.present();
-      if (window_count < 16) {
-        windows[window_count++] =
-            ui::apps::finder::create_window(screen_w, screen_h, s_ext4);
-        for (uint32_t j = 0; j < window_count; ++j)
-          windows[j].focused = (j == window_count - 1);
-        ui::draw_desktop(graphics, windows, window_count);
+      if (load_wallpaper(s_ext4, fs::Path(ui::wallpaper::kDefaultPath))) {
+        ui::prepare_windows(wm);
+        ui::draw_desktop(graphics, wm);
+        graphics.present();
+      }
+      if (open_app([&] {
+            return ui::apps::finder::create_window(screen_w, screen_h, s_ext4);
+          }) != ui::window_manager::kNoWindow) {
+        ui::prepare_windows(wm);
+        ui::draw_desktop(graphics, wm);
         graphics.present();
       }
     }
@@ -307,9 +452,15 @@ extern "C" void kmain() {
   input::Ps2Mouse mouse;
   mouse.initialize();
   ui::Cursor cursor;
-  cursor.set_position(screen_w / 2, screen_h / 2, screen_w, screen_h);
+  cursor.set_position(screen_w / 2, screen_h / 2, desktop_w, desktop_h);
   cursor.draw(graphics);
   graphics.present();
+  // The other outputs show the desktop as soon as input is live
+  ui::prepare_windows(wm);
+  for (uint32_t i = 1; i < output_count; ++i) {
+    ui::draw_desktop(s_output_gfx[i], wm);
+    s_output_gfx[i].present(false);
+  }
   // Input ready, UI responsive ~100%
   set_progress(100);
 
@@ -319,6 +470,7 @@ extern "C" void kmain() {
       {"About", apps::Start_About},
       {"Finder", apps::Start_Finder},
       {"Text Viewer", apps::Start_TextViewer},
+      {"Memory", apps::Start_Memory},
   };
   ui::startmenu::State start_state{};
   ui::startmenu::init(start_state, screen_w, screen_h, kStartItems,
@@ -329,57 +481,111 @@ extern "C" void kmain() {
   uint32_t resize_mask = 0;
   uint32_t drag_off_x = 0;
   uint32_t drag_off_y = 0;
-  int dragging_index = -1;
+  using ui::window_manager::kNoWindow;
+  using ui::window_manager::WindowHandle;
+  WindowHandle dragging_window = kNoWindow;
   bool prev_left = false;
-  bool perf_border_only =
-      false; // performance-over-visuals flag (future setting)
 
-  // Simple event loop: poll mouse, move cursor, support window dragging
-  for (;;) {
-    int8_t dx = 0, dy = 0, dz = 0;
-    bool left = false, right = false, middle = false;
-    if (!mouse.poll_packet(dx, dy, dz, left, right, middle)) {
-      continue;
+  // Pending frame work: screen damage collected through ui::invalidate() and
+  // a cursor move. Cleared once the frame is presented.
+  bool cursor_dirty = false;
+  uint32_t cursor_prev_x = cursor.x();
+  uint32_t cursor_prev_y = cursor.y();
+
+  // Output showing a desktop point; the primary one for points in no output
+  auto output_at = [&](uint32_t x, uint32_t y) -> ui::compositor::Output & {
+    for (uint32_t i = 0; i < output_count; ++i) {
+      const ui::Rect &r = s_outputs[i].rect;
+      if (x >= r.x && x < r.x + r.w && y >= r.y && y < r.y + r.h)
+        return s_outputs[i];
     }
+    return s_outputs[0];
+  };
+
+  auto invalidate_window = [&](WindowHandle h) {
+    const ui::window::Window *w = wm.get(h);
+    if (w && !w->minimized)
+      ui::invalidate(ui::window::get_frame_rect(*w, screen_w, screen_h));
+  };
+  // Focusing restyles the old and new focused windows, and raising repaints
+  // the window over whatever covered it. Taskbar buttons are handled by
+  // ui::taskbar::update().
+  auto focus_window = [&](WindowHandle h) {
+    if (wm.focused() != h)
+      invalidate_window(wm.focused());
+    if (wm.focused() != h || wm.top() != h)
+      invalidate_window(h);
+    wm.focus(h);
+  };
+
+  input::EventQueue input_queue;
+  ui::compositor::FramePacer frame_pacer;
+  ui::compositor::FrameBudget frame_budget;
+  uint64_t pacing_logged = 0; // timestamp() of the last pacing report
+
+  // What a repainted band shows: the desktop and the start menu over it.
+  // Every CPU reads it; nothing in it changes while render() runs.
+  struct Scene {
+    const ui::window_manager::WindowManager *wm;
+    const ui::startmenu::State *start;
+  };
+  const Scene scene{&wm, &start_state};
+  auto draw_scene = [](Graphics &gfx, const void *ctx) {
+    const Scene &sc = *static_cast<const Scene *>(ctx);
+    ui::draw_desktop(gfx, *sc.wm);
+    ui::startmenu::draw_surface(gfx, *sc.start);
+  };
+  static ui::compositor::TileRenderer tile_renderer;
+  // Window currently drawn as an outline by the frame budget
+  WindowHandle outline_window = kNoWindow;
 
-    // Track if UI changed this frame; drop region rendering entirely
-    bool ui_changed = false;
-    auto add_dirty = [&](const ui::Rect &) { ui_changed = true; };
+  // Apply one input packet to UI state. Rendering is deferred to the frame
+  // stage of the event loop, so a burst of packets costs one redraw.
+  auto apply_packet = [&](const input::MousePacket &pkt) {
+    const int8_t dz = pkt.dz;
+    const bool left = pkt.left, right = pkt.right, middle = pkt.middle;
 
-    const bool cursor_moved = (dx != 0) || (dy != 0);
+    const bool cursor_moved = (pkt.dx != 0) || (pkt.dy != 0);
     if (cursor_moved) {
       // Restore background under old cursor before any updates
-      cursor.erase(graphics);
-      cursor.move_by(dx, dy, screen_w, screen_h);
+      if (!cursor_dirty) {
+        cursor_prev_x = cursor.x();
+        cursor_prev_y = cursor.y();
+      }
+      cursor.erase(*output_at(cursor.x(), cursor.y()).gfx);
+      cursor.move_by(pkt.dx, pkt.dy, desktop_w, desktop_h);
+      cursor_dirty = true;
+      if (start_state.open) {
+        // Repaint only the rows that gained or lost the hover highlight
+        const int32_t prev_hover = start_state.hover_index;
+        if (ui::startmenu::update_hover(start_state, cursor.x(), cursor.y())) {
+          ui::invalidate(ui::startmenu::item_rect(start_state, prev_hover));
+          ui::invalidate(
+              ui::startmenu::item_rect(start_state, start_state.hover_index));
+        }
+      }
     }
 
     // Handle drag begin/end, start menu, and taskbar clicks
     if (left && !prev_left) {
       // Check taskbar click first (includes Start)
+      WindowHandle tb_win = kNoWindow;
       uint32_t tb_hit = ui::taskbar::hit_test(cursor.x(), cursor.y(), screen_w,
-                                              screen_h, windows, window_count);
+                                              screen_h, wm, tb_win);
       if (tb_hit == ui::taskbar::kHitStart) {
         // Toggle Start menu
         start_state.open = !start_state.open;
-        ui_changed = true;
-      } else if (tb_hit != UINT32_MAX && tb_hit < window_count) {
-        // Toggle minimize; if restoring, bring to front by moving to end
-        bool was_min = windows[tb_hit].minimized;
-        windows[tb_hit].minimized = !windows[tb_hit].minimized;
-        ui::Rect affected = windows[tb_hit].rect;
-        if (was_min) {
-          // bring to front
-          ui::window::Window tmp = windows[tb_hit];
-          for (uint32_t i = tb_hit; i + 1 < window_count; ++i)
-            windows[i] = windows[i + 1];
-          windows[window_count - 1] = tmp;
-          // focus restored window
-          for (uint32_t j = 0; j < window_count; ++j)
-            windows[j].focused = (j == window_count - 1);
-        }
-        // Dirty: the window area and the taskbar band
-        add_dirty(ui::Rect{affected.x, affected.y, affected.w, affected.h});
-        add_dirty(ui::Rect{0, screen_h - taskbar_h, screen_w, taskbar_h});
+        ui::invalidate(start_state.rect);
+      } else if (tb_hit == ui::taskbar::kHitWindow) {
+        // Toggle minimize; if restoring, bring to front and focus
+        ui::window::Window &tw = *wm.get(tb_win);
+        bool was_min = tw.minimized;
+        tw.minimized = !tw.minimized;
+        ui::Rect affected = tw.rect;
+        if (was_min)
+          focus_window(tb_win);
+        // Dirty: the window area; the taskbar repaints its own button
+        ui::invalidate(affected);
       } else {
         // If Start menu is open, check for menu item clicks or outside close
         if (start_state.open) {
@@ -387,18 +593,22 @@ extern "C" void kmain() {
                                                       cursor.y());
           if (sm == 0xFFFFFFFEu) {
             start_state.open = false;
-            ui_changed = true;
+            ui::invalidate(start_state.rect);
           } else if (sm != UINT32_MAX) {
-            // Launch app by id
-            if (sm == apps::Start_Welcome && window_count < 16) {
-              windows[window_count++] =
-                  ui::apps::welcome::create_window(screen_w, screen_h);
-            } else if (sm == apps::Start_About && window_count < 16) {
-              uint32_t current_count = window_count;
-              windows[window_count++] = ui::apps::about::create_window(
-                  screen_w, screen_h, windows[current_count - 1]);
-            } else if (sm == apps::Start_Finder && window_count < 16 &&
-                       rootfs && rootfs->address && rootfs->size > 4096) {
+            // Launch app by id; WindowManager::open focuses the new window
+            if (sm == apps::Start_Welcome) {
+              open_app([&] {
+                return ui::apps::welcome::create_window(screen_w, screen_h);
+              });
+            } else if (sm == apps::Start_About) {
+              const ui::window::Window *anchor = wm.get(wm.top());
+              open_app([&] {
+                return ui::apps::about::create_window(
+                    screen_w, screen_h,
+                    anchor ? *anchor : ui::window::Window{});
+              });
+            } else if (sm == apps::Start_Finder && rootfs && rootfs->address &&
+                       rootfs->size > 4096) {
               // Reuse mounted fs if available
               static fs::MemoryBlockDevice s_memdev2(nullptr, 0);
               static fs::Ext4 s_ext4_2(s_memdev2);
@@ -409,11 +619,13 @@ extern "C" void kmain() {
                 init2 = s_ext4_2.mount();
               }
               if (init2) {
-                windows[window_count++] = ui::apps::finder::create_window(
-                    screen_w, screen_h, s_ext4_2);
+                open_app([&] {
+                  return ui::apps::finder::create_window(screen_w, screen_h,
+                                                         s_ext4_2);
+                });
               }
-            } else if (sm == apps::Start_TextViewer && window_count < 16 &&
-                       rootfs && rootfs->address && rootfs->size > 4096) {
+            } else if (sm == apps::Start_TextViewer && rootfs &&
+                       rootfs->address && rootfs->size > 4096) {
               // Reuse mounted fs if available
               static fs::MemoryBlockDevice s_memdev3(nullptr, 0);
               static fs::Ext4 s_ext4_3(s_memdev3);
@@ -424,218 +636,112 @@ extern "C" void kmain() {
                 init3 = s_ext4_3.mount();
               }
               if (init3) {
-                windows[window_count++] = ui::apps::textviewer::create_window(
-                    screen_w, screen_h, s_ext4_3, nullptr);
+                open_app([&] {
+                  return ui::apps::textviewer::create_window(
+                      screen_w, screen_h, s_ext4_3, fs::Path());
+                });
               }
+            } else if (sm == apps::Start_Memory) {
+              open_app([&] {
+                return ui::apps::memstats::create_window(screen_w, screen_h);
+              });
             }
-            // Focus the newly created window
-            for (uint32_t j = 0; j < window_count; ++j)
-              windows[j].focused = (j == window_count - 1);
             start_state.open = false;
-            ui_changed = true;
+            ui::invalidate_all();
           }
         }
-        // Click on windows from topmost to bottom: handle buttons first, then
-        // drag
-        bool handled = false;
-        for (int i = static_cast<int>(window_count) - 1; i >= 0; --i) {
-          if (windows[i].minimized)
-            continue;
-          // First try resize edges
-          uint32_t hm =
-              ui::window::hit_test_resize(windows[i], cursor.x(), cursor.y());
-          if (hm != 0) {
-            resizing = true;
-            dragging_index = i;
-            resize_mask = hm;
-            drag_off_x = cursor.x() - windows[i].rect.x;
-            drag_off_y = cursor.y() - windows[i].rect.y;
-            // Bring to front
-            if (static_cast<unsigned int>(i) != window_count - 1) {
-              ui::window::Window tmp = windows[i];
-              for (auto k = static_cast<unsigned int>(i); k + 1 < window_count;
-                   ++k)
-                windows[k] = windows[k + 1];
-              windows[window_count - 1] = tmp;
-              dragging_index = static_cast<int>(window_count - 1);
-            }
-            for (uint32_t j = 0; j < window_count; ++j)
-              windows[j].focused = (j == static_cast<uint32_t>(dragging_index));
-            handled = true;
-            break;
-          }
-          uint32_t btn =
-              ui::window::hit_test_button(windows[i], cursor.x(), cursor.y());
-          if (btn != UINT32_MAX) {
-            // Focus this window
-            for (uint32_t j = 0; j < window_count; ++j)
-              windows[j].focused = (j == static_cast<uint32_t>(i));
-            // Handle button action
-            if (btn == 0 && windows[i].closeable) {
-              // Close window: remove from array
-              ui::Rect oldr = windows[i].rect;
-              for (uint32_t k = i; k + 1 < window_count; ++k) {
-                windows[k] = windows[k + 1];
-                saved_rects[k] = saved_rects[k + 1];
-                saved_rect_valid[k] = saved_rect_valid[k + 1];
-              }
-              window_count--;
-              add_dirty(ui::Rect{oldr.x, oldr.y, oldr.w, oldr.h});
-              add_dirty(ui::Rect{0, screen_h - taskbar_h, screen_w, taskbar_h});
-            } else if (btn == 1) {
-              // Minimize
-              bool was_min_local = windows[i].minimized;
-              windows[i].minimized = !windows[i].minimized;
-              add_dirty(ui::Rect{windows[i].rect.x, windows[i].rect.y,
-                                 windows[i].rect.w, windows[i].rect.h});
-              add_dirty(ui::Rect{0, screen_h - taskbar_h, screen_w, taskbar_h});
-              if (!was_min_local) {
-                // If minimized the focused window, clear focus
-                if (windows[i].focused)
-                  windows[i].focused = false;
-              }
-            } else if (btn == 2) {
-              // Maximize/restore
-              ui::Rect oldr = windows[i].rect;
-              if (!windows[i].maximized) {
-                saved_rects[i] = windows[i].rect;
-                saved_rect_valid[i] = true;
-                windows[i].maximized = true;
-                windows[i].fullscreen = false;
-                windows[i].rect.x = 0;
-                windows[i].rect.y = 0;
-                windows[i].rect.w = screen_w;
-                windows[i].rect.h = screen_h - taskbar_h;
-              } else {
-                windows[i].maximized = false;
-                if (saved_rect_valid[i]) {
-                  windows[i].rect = saved_rects[i];
-                  saved_rect_valid[i] = false;
-                }
-              }
-              // bring to front
-              if (static_cast<uint32_t>(i) != window_count - 1) {
-                ui::window::Window tmp = windows[i];
-                ui::Rect sr = saved_rects[i];
-                bool srv = saved_rect_valid[i];
-                for (uint32_t k = i; k + 1 < window_count; ++k) {
-                  windows[k] = windows[k + 1];
-                  saved_rects[k] = saved_rects[k + 1];
-                  saved_rect_valid[k] = saved_rect_valid[k + 1];
-                }
-                windows[window_count - 1] = tmp;
-                saved_rects[window_count - 1] = sr;
-                saved_rect_valid[window_count - 1] = srv;
-              }
-              for (uint32_t j = 0; j < window_count; ++j)
-                windows[j].focused = (j == window_count - 1);
-              // Dirty union
-              uint32_t rx0 = oldr.x < windows[window_count - 1].rect.x
-                                 ? oldr.x
-                                 : windows[window_count - 1].rect.x;
-              uint32_t ry0 = oldr.y < windows[window_count - 1].rect.y
-                                 ? oldr.y
-                                 : windows[window_count - 1].rect.y;
-              uint32_t rx1 =
-                  (oldr.x + oldr.w) > (windows[window_count - 1].rect.x +
-                                       windows[window_count - 1].rect.w)
-                      ? (oldr.x + oldr.w)
-                      : (windows[window_count - 1].rect.x +
-                         windows[window_count - 1].rect.w);
-              uint32_t ry1 =
-                  (oldr.y + oldr.h) > (windows[window_count - 1].rect.y +
-                                       windows[window_count - 1].rect.h)
-                      ? (oldr.y + oldr.h)
-                      : (windows[window_count - 1].rect.y +
-                         windows[window_count - 1].rect.h);
-              add_dirty(ui::Rect{rx0, ry0, rx1 - rx0, ry1 - ry0});
-              add_dirty(ui::Rect{0, screen_h - taskbar_h, screen_w, taskbar_h});
-            } else if (btn == 3) {
-              // Toggle always_on_top (pin)
-              windows[i].always_on_top = !windows[i].always_on_top;
-              // bring to front for interaction consistency
-              if (static_cast<uint32_t>(i) != window_count - 1) {
-                ui::window::Window tmp = windows[i];
-                ui::Rect sr = saved_rects[i];
-                bool srv = saved_rect_valid[i];
-                for (uint32_t k = i; k + 1 < window_count; ++k) {
-                  windows[k] = windows[k + 1];
-                  saved_rects[k] = saved_rects[k + 1];
-                  saved_rect_valid[k] = saved_rect_valid[k + 1];
-                }
-                windows[window_count - 1] = tmp;
-                saved_rects[window_count - 1] = sr;
-                saved_rect_valid[window_count - 1] = srv;
-              }
-              for (uint32_t j = 0; j < window_count; ++j)
-                windows[j].focused = (j == window_count - 1);
-              add_dirty(ui::Rect{windows[window_count - 1].rect.x,
-                                 windows[window_count - 1].rect.y,
-                                 windows[window_count - 1].rect.w,
-                                 windows[window_count - 1].rect.h});
+        // Click on the window drawn under the cursor: resize edges first,
+        // then buttons, then titlebar drag
+        const ui::hit_test::Hit hit = s_hit_map.query(cursor.x(), cursor.y());
+        ui::window::Window *hw = wm.get(hit.window);
+        if (hw && hit.zone == ui::hit_test::Zone::Resize) {
+          ui::window::Window &w = *hw;
+          resizing = true;
+          dragging_window = hit.window;
+          resize_mask = hit.detail;
+          drag_off_x = cursor.x() - w.rect.x;
+          drag_off_y = cursor.y() - w.rect.y;
+          focus_window(hit.window);
+        } else if (hw && hit.zone == ui::hit_test::Zone::Button) {
+          ui::window::Window &w = *hw;
+          const WindowHandle h = hit.window;
+          const uint32_t btn = hit.detail;
+          // Handle button action
+          if (btn == 0 && w.closeable) {
+            // Close window: release its slot
+            ui::Rect oldr = w.rect;
+            wm.close(h);
+            ui::invalidate(oldr);
+          } else if (btn == 1) {
+            // Minimize; a minimized window gives up focus
+            w.minimized = !w.minimized;
+            ui::invalidate(w.rect);
+            if (w.minimized) {
+              if (wm.focused() == h)
+                wm.clear_focus();
+            } else {
+              focus_window(h);
             }
-            handled = true;
-            break;
-          }
-        }
-        if (!handled) {
-          // Check for titlebar drag
-          for (int i = static_cast<int>(window_count) - 1; i >= 0; --i) {
-            if (windows[i].minimized)
-              continue;
-            if (ui::window::point_in_titlebar(windows[i], cursor.x(),
-                                              cursor.y())) {
-              dragging = true;
-              dragging_index = i;
-              drag_off_x = cursor.x() - windows[i].rect.x;
-              drag_off_y = cursor.y() - windows[i].rect.y;
-              // bring to front if not already
-              if (static_cast<uint32_t>(i) != window_count - 1) {
-                ui::window::Window tmp = windows[i];
-                ui::Rect sr = saved_rects[i];
-                bool srv = saved_rect_valid[i];
-                for (uint32_t k = i; k + 1 < window_count; ++k) {
-                  windows[k] = windows[k + 1];
-                  saved_rects[k] = saved_rects[k + 1];
-                  saved_rect_valid[k] = saved_rect_valid[k + 1];
-                }
-                windows[window_count - 1] = tmp;
-                saved_rects[window_count - 1] = sr;
-                saved_rect_valid[window_count - 1] = srv;
-                dragging_index = static_cast<int>(window_count - 1);
-                add_dirty(ui::Rect{windows[dragging_index].rect.x,
-                                   windows[dragging_index].rect.y,
-                                   windows[dragging_index].rect.w,
-                                   windows[dragging_index].rect.h});
-              }
-              for (uint32_t j = 0; j < window_count; ++j)
-                windows[j].focused =
-                    (j == static_cast<uint32_t>(dragging_index));
-              break;
+          } else if (btn == 2) {
+            // Maximize/restore
+            ui::Rect oldr = w.rect;
+            if (!w.maximized) {
+              wm.save_restore_rect(h, w.rect);
+              w.maximized = true;
+              w.fullscreen = false;
+              w.rect.x = 0;
+              w.rect.y = 0;
+              w.rect.w = screen_w;
+              w.rect.h = screen_h - taskbar_h;
+            } else {
+              w.maximized = false;
+              ui::Rect restored{};
+              if (wm.take_restore_rect(h, restored))
+                w.rect = restored;
             }
+            focus_window(h);
+            // Dirty union
+            uint32_t rx0 = oldr.x < w.rect.x ? oldr.x : w.rect.x;
+            uint32_t ry0 = oldr.y < w.rect.y ? oldr.y : w.rect.y;
+            uint32_t rx1 = (oldr.x + oldr.w) > (w.rect.x + w.rect.w)
+                               ? (oldr.x + oldr.w)
+                               : (w.rect.x + w.rect.w);
+            uint32_t ry1 = (oldr.y + oldr.h) > (w.rect.y + w.rect.h)
+                               ? (oldr.y + oldr.h)
+                               : (w.rect.y + w.rect.h);
+            ui::invalidate(ui::Rect{rx0, ry0, rx1 - rx0, ry1 - ry0});
+          } else if (btn == 3) {
+            // Toggle always_on_top (pin); bring to front for interaction
+            // consistency
+            w.always_on_top = !w.always_on_top;
+            focus_window(h);
+            ui::invalidate(w.rect);
+          } else {
+            focus_window(h);
           }
+        } else if (hw && hit.zone == ui::hit_test::Zone::Titlebar) {
+          ui::window::Window &w = *hw;
+          dragging = true;
+          dragging_window = hit.window;
+          drag_off_x = cursor.x() - w.rect.x;
+          drag_off_y = cursor.y() - w.rect.y;
+          // bring to front if not already
+          focus_window(hit.window);
         }
       }
     } else if (!left && prev_left) {
-      bool was_dragging = dragging;
-      bool was_resizing = resizing;
       dragging = false;
       if (resizing) {
         // Finalize resize
         resizing = false;
         resize_mask = 0;
       }
-      dragging_index = -1;
-      // If we were in perf-border-only mode and just finished an interaction,
-      // trigger a full redraw so the window contents are rendered.
-      if (perf_border_only && (was_dragging || was_resizing)) {
-        ui_changed = true;
-      }
+      dragging_window = kNoWindow;
     }
 
     // Update window position if dragging
-    if (dragging && dragging_index >= 0) {
-      ui::window::Window &w = windows[dragging_index];
+    if (dragging && wm.valid(dragging_window)) {
+      ui::window::Window &w = *wm.get(dragging_window);
       uint32_t old_x = w.rect.x;
       uint32_t old_y = w.rect.y;
       int64_t new_x =
@@ -646,8 +752,9 @@ extern "C" void kmain() {
         new_x = 0;
       if (new_y < 0)
         new_y = 0;
-      if (new_x > static_cast<int64_t>(screen_w - w.rect.w))
-        new_x = screen_w - w.rect.w;
+      // Windows move freely between outputs
+      if (new_x > static_cast<int64_t>(desktop_w - w.rect.w))
+        new_x = desktop_w - w.rect.w;
       uint32_t bottom_limit = screen_h - taskbar_h - w.rect.h;
       if (new_y > static_cast<int64_t>(bottom_limit))
         new_y = bottom_limit;
@@ -663,13 +770,13 @@ extern "C" void kmain() {
                                                             : (nx + w.rect.w);
         uint32_t ry1 = (old_y + w.rect.h) > (ny + w.rect.h) ? (old_y + w.rect.h)
                                                             : (ny + w.rect.h);
-        add_dirty(ui::Rect{rx0, ry0, rx1 - rx0, ry1 - ry0});
+        ui::invalidate(ui::Rect{rx0, ry0, rx1 - rx0, ry1 - ry0});
       }
     }
 
     // Update window size if resizing
-    if (resizing && dragging_index >= 0) {
-      ui::window::Window &w = windows[dragging_index];
+    if (resizing && wm.valid(dragging_window)) {
+      ui::window::Window &w = *wm.get(dragging_window);
       uint32_t old_x = w.rect.x;
       uint32_t old_y = w.rect.y;
       uint32_t old_w = w.rect.w;
@@ -694,8 +801,8 @@ extern "C" void kmain() {
       }
       if (resize_mask & ui::window::ResizeRight) {
         int64_t new_right = static_cast<int64_t>(cursor.x());
-        if (new_right > static_cast<int64_t>(screen_w))
-          new_right = screen_w;
+        if (new_right > static_cast<int64_t>(desktop_w))
+          new_right = desktop_w;
         nw = new_right - static_cast<int64_t>(w.rect.x);
         if (nw < min_w)
           nw = min_w;
@@ -736,55 +843,35 @@ extern "C" void kmain() {
         uint32_t ry1 = (old_y + old_h) > (w.rect.y + w.rect.h)
                            ? (old_y + old_h)
                            : (w.rect.y + w.rect.h);
-        add_dirty(ui::Rect{rx0, ry0, rx1 - rx0, ry1 - ry0});
+        ui::invalidate(ui::Rect{rx0, ry0, rx1 - rx0, ry1 - ry0});
       }
     }
 
     // Check for file opening requests from finder windows
-    for (uint32_t i = 0; i < window_count; ++i) {
-      ui::window::Window &w = windows[i];
-      if (w.user_data) {
-        // Check if this is a finder window with a file to open
-        // We need to cast and check the state
-        auto *finder_state =
-            static_cast<ui::apps::finder::FinderState *>(w.user_data);
-        if (finder_state && finder_state->should_open_file &&
-            finder_state->file_to_open[0] != '\0' && window_count < 16) {
-
-          // Clear the file opening request immediately to prevent multiple
-          // windows
-          char file_path_to_open[256];
-          uint32_t path_len = 0;
-          for (; finder_state->file_to_open[path_len] &&
-                 path_len < sizeof(file_path_to_open) - 1;
-               ++path_len) {
-            file_path_to_open[path_len] = finder_state->file_to_open[path_len];
+    for (WindowHandle h = wm.first(); h != kNoWindow; h = wm.next(h)) {
+      // Only Finder windows carry open requests
+      auto *finder_state = ui::apps::finder::state_of(*wm.get(h));
+      if (finder_state && finder_state->should_open_file) {
+        // Clear the file opening request immediately to prevent multiple
+        // windows; the viewer copies the path straight from the Finder
+        finder_state->should_open_file = false;
+
+        // Create text viewer for the file
+        if (rootfs && rootfs->address && rootfs->size > 4096) {
+          static fs::MemoryBlockDevice s_memdev4(nullptr, 0);
+          static fs::Ext4 s_ext4_4(s_memdev4);
+          static bool init4 = false;
+          if (!init4) {
+            s_memdev4 = fs::MemoryBlockDevice(rootfs->address, rootfs->size);
+            init4 = s_ext4_4.mount();
           }
-          file_path_to_open[path_len] = '\0';
-
-          finder_state->file_to_open[0] = '\0';
-          finder_state->should_open_file = false;
-
-          // Create text viewer for the file
-          if (rootfs && rootfs->address && rootfs->size > 4096) {
-            static fs::MemoryBlockDevice s_memdev4(nullptr, 0);
-            static fs::Ext4 s_ext4_4(s_memdev4);
-            static bool init4 = false;
-            if (!init4) {
-              s_memdev4 = fs::MemoryBlockDevice(rootfs->address, rootfs->size);
-              init4 = s_ext4_4.mount();
-            }
-            if (init4) {
-              windows[window_count++] = ui::apps::textviewer::create_window(
-                  screen_w, screen_h, s_ext4_4, file_path_to_open);
-
-              // Focus the new text viewer
-              for (uint32_t j = 0; j < window_count; ++j) {
-                windows[j].focused = (j == window_count - 1);
-              }
-
-              ui_changed = true;
-            }
+          if (init4) {
+            // Opening focuses the new text viewer
+            open_app([&] {
+              return ui::apps::textviewer::create_window(
+                  screen_w, screen_h, s_ext4_4, finder_state->file_to_open);
+            });
+            ui::invalidate_all();
           }
         }
       }
@@ -792,30 +879,26 @@ extern "C" void kmain() {
 
     // Dispatch mouse events to window content (topmost first)
     auto dispatch_to_content = [&](ui::window::MouseEvent::Type etype) {
-      // Find topmost window whose content rect contains the cursor
-      for (int i = static_cast<int>(window_count) - 1; i >= 0; --i) {
-        const ui::window::Window &w = windows[i];
-        if (w.minimized || w.on_mouse == nullptr)
-          continue;
-        ui::Rect content = ui::window::get_content_rect(w, screen_w, screen_h);
-        uint32_t cx = cursor.x();
-        uint32_t cy = cursor.y();
-        if (cx >= content.x && cx < content.x + content.w && cy >= content.y &&
-            cy < content.y + content.h) {
-          ui::window::MouseEvent ev{};
-          ev.type = etype;
-          ev.x = cx - content.x;
-          ev.y = cy - content.y;
-          ev.left = left;
-          ev.right = right;
-          ev.middle = middle;
-          ev.wheel_y = 0;
-          w.on_mouse(ev, w.user_data);
-          // Assume content may have changed (e.g., hover highlight)
-          ui_changed = true;
-          break;
-        }
-      }
+      // Only the window drawn under the cursor receives content events
+      const ui::hit_test::Hit hit = s_hit_map.query(cursor.x(), cursor.y());
+      const ui::window::Window *w = wm.get(hit.window);
+      if (!w || hit.zone != ui::hit_test::Zone::Content ||
+          w->on_mouse == nullptr)
+        return;
+      ui::Rect content = ui::window::get_content_rect(*w, screen_w, screen_h);
+      ui::window::MouseEvent ev{};
+      ev.type = etype;
+      ev.x = cursor.x() - content.x;
+      ev.y = cursor.y() - content.y;
+      ev.left = left;
+      ev.right = right;
+      ev.middle = middle;
+      ev.wheel_y = etype == ui::window::MouseEvent::Type::Wheel ? dz : 0;
+      ev.content = content;
+      // The handler invalidates whatever it changed; what it charges belongs
+      // to the window
+      platform::MemOwnerScope owner(w->mem_owner);
+      w->on_mouse(ev, w->user_data);
     };
 
     // Generate events based on current state
@@ -829,51 +912,150 @@ extern "C" void kmain() {
       dispatch_to_content(ui::window::MouseEvent::Type::Up);
     }
     if (dz != 0) {
-      // Deliver a wheel event to the window under cursor
-      for (int i = static_cast<int>(window_count) - 1; i >= 0; --i) {
-        const ui::window::Window &w = windows[i];
-        if (w.minimized || w.on_mouse == nullptr)
-          continue;
-        ui::Rect content = ui::window::get_content_rect(w, screen_w, screen_h);
-        uint32_t cx = cursor.x();
-        uint32_t cy = cursor.y();
-        if (cx >= content.x && cx < content.x + content.w && cy >= content.y &&
-            cy < content.y + content.h) {
-          ui::window::MouseEvent ev{};
-          ev.type = ui::window::MouseEvent::Type::Wheel;
-          ev.x = cx - content.x;
-          ev.y = cy - content.y;
-          ev.left = left;
-          ev.right = right;
-          ev.middle = middle;
-          // Treat positive dz as wheel up (scroll up)
-          ev.wheel_y = dz;
-          w.on_mouse(ev, w.user_data);
-          ui_changed = true;
-          break;
-        }
-      }
+      // Deliver a wheel event to the window under cursor; positive dz is
+      // wheel up (scroll up)
+      dispatch_to_content(ui::window::MouseEvent::Type::Wheel);
     }
 
-    // Present: prefer minimal redraw on cursor-only movement
-    if (ui_changed) {
-      // Full scene redraw invalidates cursor underlay cache
-      ui::draw_desktop(graphics, windows, window_count);
-      if (start_state.open) {
-        ui::startmenu::draw(graphics, start_state);
-      }
-      cursor.invalidate();
-      cursor.draw(graphics);
-      graphics.present();
-    } else if (cursor_moved) {
-      if (start_state.open) {
-        ui::startmenu::update_hover(start_state, cursor.x(), cursor.y());
-        ui::startmenu::draw(graphics, start_state);
-      }
-      cursor.draw(graphics);
-      graphics.present();
+    prev_left = left;
+  };
+
+  s_hit_map.rebuild(wm);
+
+#if defined(KERNEL_BENCH)
+  // Full repaints of every output at each CPU count, without presenting
+  struct RenderBench {
+    ui::compositor::Output *outputs;
+    uint32_t output_count;
+    const Scene *scene;
+    ui::compositor::SceneFn draw;
+    const ui::window_manager::WindowManager *wm;
+  };
+  RenderBench render_bench{s_outputs, output_count, &scene, draw_scene, &wm};
+  bench::cpu_scaling(
+      "render", 60,
+      [](void *ctx) {
+        const RenderBench &b = *static_cast<RenderBench *>(ctx);
+        platform::frame_reset();
+        for (uint32_t o = 0; o < b.output_count; ++o)
+          b.outputs[o].damage.add_all();
+        ui::prepare_windows(*b.wm);
+        tile_renderer.render(b.outputs, b.output_count, b.draw, b.scene);
+        for (uint32_t o = 0; o < b.output_count; ++o)
+          b.outputs[o].damage.clear();
+      },
+      &render_bench);
+  bench::heap_contention();
+#endif
+
+  // Event loop in three stages: drain all pending input into the queue, apply
+  // every queued packet to UI state, then render and present at most once per
+  // frame deadline.
+  for (;;) {
+    // Scratch from the last pass (directory listings and the like) is done
+    platform::frame_reset();
+    mouse.drain(input_queue);
+
+    input::MousePacket pkt{};
+    while (input_queue.pop(pkt)) {
+      frame_pacer.note_input(pkt.timestamp);
+      apply_packet(pkt);
     }
 
-    prev_left = left;
+    // Over budget, taskbar and clock changes wait; they catch up once quality
+    // is restored since both compare against what they last scheduled
+    using ui::compositor::Quality;
+    if (!frame_budget.at_least(Quality::DeferChrome)) {
+      ui::taskbar::update(wm, screen_w, screen_h);
+      ui::taskbar::update_clock(screen_w, screen_h);
+      ui::apps::memstats::update(wm, screen_w, screen_h);
+    }
+
+    // Rendering shortcuts follow the frame budget; turning one on or off
+    // repaints what it affects
+    const WindowHandle outline =
+        ((dragging || resizing) && frame_budget.at_least(Quality::OutlineDrag))
+            ? dragging_window
+            : kNoWindow;
+    if (outline != outline_window) {
+      invalidate_window(outline_window);
+      invalidate_window(outline);
+      outline_window = outline;
+    }
+    const bool focused_only = frame_budget.at_least(Quality::FocusedContent);
+    if (focused_only != ui::render_shortcuts().focused_content_only)
+      ui::invalidate_all();
+    ui::set_render_shortcuts(ui::RenderShortcuts{wm.get(outline), focused_only});
+
+    ui::compositor::DamageRegion &damage = ui::compositor::damage();
+    if (damage.empty() && !cursor_dirty)
+      continue;
+    if (!frame_pacer.frame_due(platform::timestamp()))
+      continue;
+    frame_budget.frame_begin(platform::timestamp());
+
+    // A fullscreen window scans out directly from the primary framebuffer,
+    // skipping the backbuffer copy. Entering or leaving that mode needs a
+    // full redraw of that output.
+    const bool want_direct = ui::fullscreen_window(wm) != kNoWindow;
+    if (want_direct != graphics.is_direct_scanout()) {
+      graphics.set_direct_scanout(want_direct);
+      damage.add(s_outputs[0].rect);
+    }
+
+    // Each output repaints and presents only the damage that landed on it
+    ui::compositor::route_damage(damage, s_outputs, output_count);
+    ui::compositor::Output &cursor_out = output_at(cursor.x(), cursor.y());
+    if (!damage.empty()) {
+      cursor.erase(*cursor_out.gfx);
+      // Whatever the scene draws lazily is brought up to date here; the bands
+      // then render on every CPU and only read shared state
+      ui::layer_cache::prepare(wm);
+      ui::taskbar::prepare(wm, screen_w, screen_h);
+      ui::startmenu::prepare(start_state);
+      ui::prepare_windows(wm);
+      tile_renderer.render(s_outputs, output_count, draw_scene, &scene);
+      s_hit_map.rebuild(wm);
+    }
+    cursor.draw(*cursor_out.gfx);
+    // The budget covers drawing; presenting includes the vblank wait
+    frame_budget.frame_end(platform::timestamp());
+
+    // Present the repainted areas and the cursor's old and new positions
+    bool sync = true;
+    for (uint32_t o = 0; o < output_count; ++o) {
+      Graphics &gfx = *s_outputs[o].gfx;
+      ui::compositor::DamageRegion &od = s_outputs[o].damage;
+      if (od.full()) {
+        gfx.present(sync);
+        sync = false;
+      } else {
+        for (uint32_t i = 0; i < od.count(); ++i) {
+          const ui::Rect &r = od.rect(i);
+          gfx.present_rect(r.x, r.y, r.w, r.h, sync);
+          sync = false;
+        }
+      }
+      od.clear();
+    }
+    if (cursor_dirty)
+      output_at(cursor_prev_x, cursor_prev_y)
+          .gfx->present_rect(cursor_prev_x, cursor_prev_y, 1, 1, sync);
+    cursor_out.gfx->present_rect(cursor.x(), cursor.y(), 1, 1, false);
+    const uint64_t presented = platform::timestamp();
+    frame_pacer.frame_presented(presented);
+    // Once a second, frame rate and input-to-photon latency go to the serial
+    // log next to the budget's quality steps
+    if (presented - pacing_logged >= platform::timestamp_frequency()) {
+      pacing_logged = presented;
+      const ui::compositor::FrameStats &fs = frame_pacer.stats();
+      platform::log("compositor: %u fps, latency %uus last, %uus avg, %uus "
+                    "max, %lu packets in %lu frames\n",
+                    fs.frames_per_second, fs.last_latency_us,
+                    fs.avg_latency_us, fs.max_latency_us, fs.packets_applied,
+                    fs.frames_presented);
+    }
+    damage.clear();
+    cursor_dirty = false;
   }
 }
@@ -0,0 +1,231 @@
+#include <cstddef>
+#include <cstdint>
+
+// GCC and Clang reserve the right to generate calls to the following
+// 4 functions even if they are not directly called.
+// Implement them as the C specification mandates.
+// DO NOT remove or rename these functions, or stuff will eventually break!
+//
+// Every struct copy and clear lands here, so sizes up to 16 bytes take a
+// straight-line path, mid sizes a word loop, and large sizes a string
+// instruction on x86_64 ("rep movsb"/"rep stosb" where the CPU has ERMS,
+// enhanced REP MOVSB/STOSB, otherwise the quadword forms).
+
+// Keep the compiler from turning the loops below back into calls to these
+// very functions
+#if defined(__clang__)
+#define MEM_NO_LIBCALLS __attribute__((no_builtin))
+#else
+#define MEM_NO_LIBCALLS                                                        \
+  __attribute__((optimize("no-tree-loop-distribute-patterns")))
+#endif
+
+namespace {
+
+// Unaligned, alias-safe word access
+typedef uint64_t __attribute__((may_alias, aligned(1))) u64_unaligned;
+typedef uint32_t __attribute__((may_alias, aligned(1))) u32_unaligned;
+typedef uint16_t __attribute__((may_alias, aligned(1))) u16_unaligned;
+
+inline uint64_t load64(const uint8_t *p) {
+  return *reinterpret_cast<const u64_unaligned *>(p);
+}
+inline void store64(uint8_t *p, uint64_t v) {
+  *reinterpret_cast<u64_unaligned *>(p) = v;
+}
+inline uint32_t load32(const uint8_t *p) {
+  return *reinterpret_cast<const u32_unaligned *>(p);
+}
+inline void store32(uint8_t *p, uint32_t v) {
+  *reinterpret_cast<u32_unaligned *>(p) = v;
+}
+inline uint16_t load16(const uint8_t *p) {
+  return *reinterpret_cast<const u16_unaligned *>(p);
+}
+inline void store16(uint8_t *p, uint16_t v) {
+  *reinterpret_cast<u16_unaligned *>(p) = v;
+}
+
+// Below this the word loops beat the string instructions' startup cost
+constexpr std::size_t kStringThreshold = 256;
+
+// Copy n <= 16 bytes as a head and a tail that may overlap. Everything is
+// loaded before anything is stored, so this is also a correct memmove.
+inline void copy_small(uint8_t *d, const uint8_t *s, std::size_t n) {
+  if (n >= 8) {
+    const uint64_t head = load64(s), tail = load64(s + n - 8);
+    store64(d, head);
+    store64(d + n - 8, tail);
+  } else if (n >= 4) {
+    const uint32_t head = load32(s), tail = load32(s + n - 4);
+    store32(d, head);
+    store32(d + n - 4, tail);
+  } else if (n >= 2) {
+    const uint16_t head = load16(s), tail = load16(s + n - 2);
+    store16(d, head);
+    store16(d + n - 2, tail);
+  } else if (n == 1) {
+    d[0] = s[0];
+  }
+}
+
+// n > 16, copying upward: safe unless d lies inside (s, s + n). The last
+// word is loaded up front so it is read before any store can reach it.
+MEM_NO_LIBCALLS inline void copy_forward(uint8_t *d, const uint8_t *s,
+                                         std::size_t n) {
+  const uint64_t tail = load64(s + n - 8);
+  for (std::size_t i = 0; i + 8 < n; i += 8)
+    store64(d + i, load64(s + i));
+  store64(d + n - 8, tail);
+}
+
+// n > 16, copying downward for d inside (s, s + n)
+MEM_NO_LIBCALLS inline void copy_backward(uint8_t *d, const uint8_t *s,
+                                          std::size_t n) {
+  const uint64_t head = load64(s);
+  for (std::size_t i = n; i > 8; i -= 8)
+    store64(d + i - 8, load64(s + i - 8));
+  store64(d, head);
+}
+
+MEM_NO_LIBCALLS inline void fill_words(uint8_t *d, uint64_t pattern,
+                                       std::size_t n) {
+  for (std::size_t i = 0; i + 8 < n; i += 8)
+    store64(d + i, pattern);
+  store64(d + n - 8, pattern);
+}
+
+#if defined(__x86_64__)
+
+// Enhanced REP MOVSB/STOSB: CPUID.(EAX=7,ECX=0):EBX bit 9. Detected on first
+// use, since these run before anything else in the kernel (constructors).
+int s_erms = -1;
+
+inline bool has_erms() {
+  if (s_erms < 0) {
+    uint32_t a = 0, b, c = 0, d;
+    asm volatile("cpuid" : "+a"(a), "=b"(b), "+c"(c), "=d"(d));
+    bool erms = false;
+    if (a >= 7) {
+      a = 7;
+      c = 0;
+      asm volatile("cpuid" : "+a"(a), "=b"(b), "+c"(c), "=d"(d));
+      erms = (b >> 9) & 1;
+    }
+    s_erms = erms ? 1 : 0;
+  }
+  return s_erms == 1;
+}
+
+inline void copy_string(uint8_t *d, const uint8_t *s, std::size_t n) {
+  if (has_erms()) {
+    asm volatile("rep movsb" : "+D"(d), "+S"(s), "+c"(n) : : "memory");
+    return;
+  }
+  std::size_t words = n / 8;
+  asm volatile("rep movsq" : "+D"(d), "+S"(s), "+c"(words) : : "memory");
+  copy_small(d, s, n % 8);
+}
+
+inline void fill_string(uint8_t *d, uint8_t value, uint64_t pattern,
+                        std::size_t n) {
+  if (has_erms()) {
+    asm volatile("rep stosb" : "+D"(d), "+c"(n) : "a"(value) : "memory");
+    return;
+  }
+  std::size_t words = n / 8;
+  asm volatile("rep stosq" : "+D"(d), "+c"(words) : "a"(pattern) : "memory");
+  for (std::size_t i = 0; i < n % 8; ++i)
+    d[i] = value;
+}
+
+#endif
+
+} // namespace
+
+extern "C" {
+
+MEM_NO_LIBCALLS void *memcpy(void *dest, const void *src, std::size_t n) {
+  auto *d = static_cast<uint8_t *>(dest);
+  const auto *s = static_cast<const uint8_t *>(src);
+  if (n <= 16) {
+    copy_small(d, s, n);
+    return dest;
+  }
+#if defined(__x86_64__)
+  if (n >= kStringThreshold) {
+    copy_string(d, s, n);
+    return dest;
+  }
+#endif
+  copy_forward(d, s, n);
+  return dest;
+}
+
+MEM_NO_LIBCALLS void *memset(void *buffer, int value, std::size_t count) {
+  auto *d = static_cast<uint8_t *>(buffer);
+  const auto byte = static_cast<uint8_t>(value);
+  const uint64_t pattern = byte * 0x0101010101010101ull;
+  if (count >= 8) {
+#if defined(__x86_64__)
+    if (count >= kStringThreshold) {
+      fill_string(d, byte, pattern, count);
+      return buffer;
+    }
+#endif
+    if (count <= 16) {
+      store64(d, pattern);
+      store64(d + count - 8, pattern);
+    } else {
+      fill_words(d, pattern, count);
+    }
+    return buffer;
+  }
+  for (std::size_t i = 0; i < count; ++i)
+    d[i] = byte;
+  return buffer;
+}
+
+MEM_NO_LIBCALLS void *memmove(void *dest, const void *src, std::size_t n) {
+  auto *d = static_cast<uint8_t *>(dest);
+  const auto *s = static_cast<const uint8_t *>(src);
+  if (n <= 16) {
+    copy_small(d, s, n);
+    return dest;
+  }
+  // Unsigned distance: d before s or past its end copies forward
+  if (static_cast<std::size_t>(d - s) >= n) {
+#if defined(__x86_64__)
+    // Forward string moves are defined byte by byte, so overlap with d
+    // below s is fine
+    if (n >= kStringThreshold) {
+      copy_string(d, s, n);
+      return dest;
+    }
+#endif
+    copy_forward(d, s, n);
+  } else {
+    copy_backward(d, s, n);
+  }
+  return dest;
+}
+
+MEM_NO_LIBCALLS int memcmp(const void *s1, const void *s2, std::size_t n) {
+  const auto *p1 = static_cast<const uint8_t *>(s1);
+  const auto *p2 = static_cast<const uint8_t *>(s2);
+  std::size_t i = 0;
+  // Whole words while equal; byte order decides the first differing byte
+  for (; i + 8 <= n; i += 8) {
+    const uint64_t a = load64(p1 + i), b = load64(p2 + i);
+    if (a != b) {
+      const uint64_t x = __builtin_bswap64(a), y = __builtin_bswap64(b);
+      return x < y ? -1 : 1;
+    }
+  }
+  for (; i < n; ++i) {
+    if (p1[i] != p2[i])
+      return p1[i] < p2[i] ? -1 : 1;
+  }
+  return 0;
+}
+}
@@ -0,0 +1,231 @@
+#include "../../ui/include/mem_account.hpp"
+#include "../../ui/include/frame_arena.hpp"
+#include "../../ui/include/log.hpp"
+#include "../../ui/include/smp.hpp"
+#include "../../ui/include/time.hpp"
+#include "mm/heap.hpp"
+#include "mm/pmm.hpp"
+#include "mm/vmm.hpp"
+
+namespace platform {
+
+static constexpr uint32_t kTagCount = static_cast<uint32_t>(MemTag::Count);
+// Recorded charges the leak checker can hold at once
+static constexpr uint32_t kMaxRecords = 256;
+
+static const char *const kTagNames[kTagCount] = {"gfx", "fs-cache", "ui",
+                                                 "apps", "heap"};
+
+struct TagCounters {
+  uint64_t live_bytes;
+  uint64_t peak_bytes;
+  uint64_t charges;
+  uint64_t uncharges;
+  uint64_t rate_base; // charges at the start of the current second
+  uint64_t rate;      // charges over the last full second
+};
+
+struct Record {
+  const void *ptr; // nullptr when the entry is free
+  uint64_t bytes;
+  uint32_t owner;
+  MemTag tag;
+};
+
+static TagCounters s_tags[kTagCount];
+static uint64_t s_rate_start = 0; // timestamp() of the current second
+static Record s_records[kMaxRecords];
+static uint32_t s_dropped = 0; // charges not recorded, the table was full
+static bool s_leak_check = false;
+static uint32_t s_next_owner = 1;
+static uint32_t s_owners[kMaxCpus]; // current owner of each CPU
+static SpinLock s_lock;
+
+const char *mem_tag_name(MemTag tag) {
+  const uint32_t i = static_cast<uint32_t>(tag);
+  return i < kTagCount ? kTagNames[i] : "?";
+}
+
+// Close the rate window once a second has passed. Called with s_lock held.
+static void roll_rates() {
+  const uint64_t now = timestamp();
+  const uint64_t elapsed = now - s_rate_start;
+  const uint64_t freq = timestamp_frequency();
+  if (elapsed < freq)
+    return;
+  for (TagCounters &t : s_tags) {
+    // Scaled to a second; a window can run long if nobody asks for a while
+    t.rate = (t.charges - t.rate_base) * freq / elapsed;
+    t.rate_base = t.charges;
+  }
+  s_rate_start = now;
+}
+
+// Count a charge to t. Called with s_lock held.
+static void add(TagCounters &t, uint64_t bytes) {
+  t.live_bytes += bytes;
+  if (t.live_bytes > t.peak_bytes)
+    t.peak_bytes = t.live_bytes;
+  ++t.charges;
+}
+
+static void sub(TagCounters &t, uint64_t bytes) {
+  t.live_bytes = t.live_bytes > bytes ? t.live_bytes - bytes : 0;
+  ++t.uncharges;
+}
+
+// Record ptr for owner; false if the table is full. Called with s_lock held.
+static bool record(const void *ptr, uint64_t bytes, uint32_t owner,
+                   MemTag tag) {
+  for (Record &r : s_records) {
+    if (r.ptr == nullptr) {
+      r = Record{ptr, bytes, owner, tag};
+      return true;
+    }
+  }
+  ++s_dropped;
+  return false;
+}
+
+// The record of ptr, or nullptr. Called with s_lock held.
+static Record *record_of(const void *ptr) {
+  for (Record &r : s_records)
+    if (r.ptr == ptr)
+      return &r;
+  return nullptr;
+}
+
+void mem_charge(MemTag tag, uint64_t bytes, const void *ptr) {
+  const uint32_t i = static_cast<uint32_t>(tag);
+  if (i >= kTagCount)
+    return;
+  SpinGuard guard(s_lock);
+  add(s_tags[i], bytes);
+  if (ptr != nullptr && s_leak_check)
+    record(ptr, bytes, s_owners[current_cpu()], tag);
+}
+
+void mem_uncharge(MemTag tag, uint64_t bytes, const void *ptr) {
+  const uint32_t i = static_cast<uint32_t>(tag);
+  if (i >= kTagCount)
+    return;
+  SpinGuard guard(s_lock);
+  sub(s_tags[i], bytes);
+  if (ptr == nullptr)
+    return;
+  // Charges made while leak checking was off have no record
+  if (Record *r = record_of(ptr))
+    r->ptr = nullptr;
+}
+
+bool mem_charge_owned(uint64_t bytes, const void *ptr) {
+  const uint32_t owner = s_owners[current_cpu()];
+  if (owner == 0)
+    return false;
+  SpinGuard guard(s_lock);
+  if (!s_leak_check || !record(ptr, bytes, owner, MemTag::Heap))
+    return false;
+  add(s_tags[static_cast<uint32_t>(MemTag::Heap)], bytes);
+  return true;
+}
+
+bool mem_uncharge_owned(const void *ptr) {
+  SpinGuard guard(s_lock);
+  Record *r = record_of(ptr);
+  if (r == nullptr || r->tag != MemTag::Heap)
+    return false;
+  sub(s_tags[static_cast<uint32_t>(MemTag::Heap)], r->bytes);
+  r->ptr = nullptr;
+  return true;
+}
+
+void mem_stats(MemTag tag, MemTagStats &out) {
+  const uint32_t i = static_cast<uint32_t>(tag);
+  if (i >= kTagCount) {
+    out = MemTagStats{};
+    return;
+  }
+  SpinGuard guard(s_lock);
+  roll_rates();
+  const TagCounters &t = s_tags[i];
+  out.live_bytes = t.live_bytes;
+  out.peak_bytes = t.peak_bytes;
+  out.charges = t.charges;
+  out.uncharges = t.uncharges;
+  out.charges_per_sec = t.rate;
+}
+
+void mem_dump() {
+  for (uint32_t i = 0; i < kTagCount; ++i) {
+    MemTagStats s;
+    mem_stats(static_cast<MemTag>(i), s);
+    log("mem: %s: %lu KiB live, %lu KiB peak, %lu charges (%lu/s), %lu "
+        "uncharges\n",
+        kTagNames[i], s.live_bytes >> 10, s.peak_bytes >> 10, s.charges,
+        s.charges_per_sec, s.uncharges);
+  }
+  mm::pmm::Stats pages;
+  mm::pmm::stats(pages);
+  const uint64_t page_kib = mm::pmm::kPageSize >> 10;
+  log("mem: pages %lu of %lu KiB free\n", pages.free_pages * page_kib,
+      pages.total_pages * page_kib);
+  mm::heap::Stats heap;
+  mm::heap::stats(heap);
+  uint64_t small = 0, slabs = 0;
+  for (uint32_t c = 0; c < mm::heap::kClassCount; ++c) {
+    small += heap.live_bytes[c];
+    slabs += heap.slabs[c];
+  }
+  log("mem: heap %lu KiB in small objects (%lu slabs), %lu KiB in %lu large\n",
+      small >> 10, slabs, heap.large_live_bytes >> 10, heap.large_live_count);
+  mm::vmm::Stats vm;
+  mm::vmm::stats(vm);
+  log("mem: %lu KiB reserved, %lu KiB committed, %lu demand faults\n",
+      vm.reserved_bytes >> 10, vm.committed_bytes >> 10, vm.demand_faults);
+  log("mem: frame scratch peak %lu KiB\n", frame_peak_bytes() >> 10);
+  if (s_dropped != 0)
+    log("mem: %u charges not recorded for leak checking\n", s_dropped);
+}
+
+void mem_set_leak_check(bool enabled) {
+  SpinGuard guard(s_lock);
+  s_leak_check = enabled;
+  if (enabled)
+    return;
+  // Heap charges exist only as records, so they go with them
+  for (Record &r : s_records) {
+    if (r.ptr != nullptr && r.tag == MemTag::Heap)
+      sub(s_tags[static_cast<uint32_t>(MemTag::Heap)], r.bytes);
+    r.ptr = nullptr;
+  }
+}
+
+uint32_t mem_new_owner() {
+  return __atomic_fetch_add(&s_next_owner, 1, __ATOMIC_RELAXED);
+}
+
+uint32_t mem_current_owner() { return s_owners[current_cpu()]; }
+
+uint32_t mem_swap_owner(uint32_t owner) {
+  uint32_t &slot = s_owners[current_cpu()];
+  const uint32_t prev = slot;
+  slot = owner;
+  return prev;
+}
+
+uint32_t mem_report_leaks(uint32_t owner) {
+  if (owner == 0)
+    return 0;
+  SpinGuard guard(s_lock);
+  uint32_t count = 0;
+  for (const Record &r : s_records) {
+    if (r.ptr == nullptr || r.owner != owner)
+      continue;
+    log("mem: leak: owner %u still holds %lu bytes of %s at 0x%lx\n", owner,
+        r.bytes, mem_tag_name(r.tag), reinterpret_cast<uint64_t>(r.ptr));
+    ++count;
+  }
+  return count;
+}
+
+} // namespace platform
@@ -0,0 +1,74 @@
+#include "bootmem.hpp"
+
+namespace mm::bootmem {
+
+// Usable memory still available, as [base, end) physical ranges
+struct Range {
+  uint64_t base;
+  uint64_t end;
+};
+
+static constexpr uint32_t kMaxRanges = 64;
+// Leave real-mode memory alone; firmware and SMP trampolines live there
+static constexpr uint64_t kLowMemoryEnd = 0x100000;
+
+static Range s_ranges[kMaxRanges];
+static uint32_t s_range_count = 0;
+static uint64_t s_hhdm_offset = 0;
+static uint64_t s_allocated = 0;
+
+bool init(const limine_memmap_response *memmap, uint64_t hhdm_offset) {
+  s_range_count = 0;
+  s_hhdm_offset = hhdm_offset;
+  if (memmap == nullptr)
+    return false;
+  for (uint64_t i = 0; i < memmap->entry_count && s_range_count < kMaxRanges;
+       ++i) {
+    const limine_memmap_entry *e = memmap->entries[i];
+    if (e == nullptr || e->type != LIMINE_MEMMAP_USABLE)
+      continue;
+    uint64_t base = e->base;
+    const uint64_t end = e->base + e->length;
+    if (base < kLowMemoryEnd)
+      base = kLowMemoryEnd;
+    if (base >= end)
+      continue;
+    s_ranges[s_range_count++] = Range{base, end};
+  }
+  return s_range_count > 0;
+}
+
+void *alloc(uint64_t bytes, uint64_t align) {
+  if (bytes == 0)
+    return nullptr;
+  if (align == 0 || (align & (align - 1)) != 0)
+    align = 4096;
+  // First fit; the range keeps whatever is left past the allocation, while
+  // the alignment gap in front of it is given up
+  for (uint32_t i = 0; i < s_range_count; ++i) {
+    Range &r = s_ranges[i];
+    const uint64_t start = (r.base + align - 1) & ~(align - 1);
+    if (start < r.base || start >= r.end || r.end - start < bytes)
+      continue;
+    r.base = start + bytes;
+    s_allocated += bytes;
+    return phys_to_virt(start);
+  }
+  return nullptr;
+}
+
+void *phys_to_virt(uint64_t phys) {
+  return reinterpret_cast<void *>(phys + s_hhdm_offset);
+}
+
+uint64_t allocated_bytes() { return s_allocated; }
+
+void retire(void (*fn)(uint64_t base, uint64_t end)) {
+  for (uint32_t i = 0; i < s_range_count; ++i) {
+    if (s_ranges[i].base < s_ranges[i].end)
+      fn(s_ranges[i].base, s_ranges[i].end);
+  }
+  s_range_count = 0;
+}
+
+} // namespace mm::bootmem
@@ -0,0 +1,29 @@
+// Early boot allocator carving memory out of the Limine memory map
+#pragma once
+
+#include <cstdint>
+#include <limine.h>
+
+namespace mm::bootmem {
+
+// Record the usable ranges of the memory map and the higher-half direct map
+// offset. Returns false if the map has no usable memory.
+bool init(const limine_memmap_response *memmap, uint64_t hhdm_offset);
+
+// Allocate bytes of physical memory, aligned to align (a power of two), and
+// return it through the direct map. Memory is not zeroed and is never freed.
+// Returns nullptr when no usable range can hold the request.
+void *alloc(uint64_t bytes, uint64_t align = 4096);
+
+// Virtual address of a physical address through the direct map
+void *phys_to_virt(uint64_t phys);
+
+// Bytes handed out so far
+uint64_t allocated_bytes();
+
+// Hand every range not allocated yet to fn as physical [base, end) and stop
+// allocating: alloc() returns nullptr from then on. Used by the page
+// allocator to take over the rest of memory.
+void retire(void (*fn)(uint64_t base, uint64_t end));
+
+} // namespace mm::bootmem
@@ -0,0 +1,401 @@
+#include "heap.hpp"
+#include "../../../ui/include/mem_account.hpp"
+#include "../../../ui/include/smp.hpp"
+#include "pmm.hpp"
+
+namespace mm::heap {
+
+// Every block the heap takes from the page allocator is at least kSlabSize
+// and aligned to it, and starts with a header. Masking any pointer the heap
+// returned down to kSlabSize therefore finds its header, which is what lets
+// free() work without a size.
+static constexpr uint32_t kSlabOrder = 4; // 64 KiB
+static constexpr uint64_t kSlabSize = pmm::kPageSize << kSlabOrder;
+static constexpr uint32_t kHeaderSize = 64;
+static constexpr uint32_t kMagic = 0x51AB51AB;
+static constexpr uint32_t kLarge = UINT32_MAX;
+// Objects per magazine, and full magazines the depot holds per class
+static constexpr uint32_t kMagazineSize = 32;
+static constexpr uint32_t kDepotMagazines = 8;
+
+static constexpr uint32_t kClassSizes[kClassCount] = {
+    16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048, 4096};
+
+struct FreeObject {
+  FreeObject *next;
+};
+
+struct alignas(kHeaderSize) Slab {
+  uint32_t magic;
+  uint32_t size_class; // or kLarge for a large allocation's block
+  uint32_t order;      // block order of a large allocation
+  uint32_t in_use;
+  FreeObject *free;
+  // Slabs of a class with free objects
+  Slab *next;
+  Slab *prev;
+  bool listed;
+  // Objects charged to an owner for leak checking; changed atomically, as
+  // objects are allocated and freed outside the class lock
+  uint32_t owned;
+};
+static_assert(sizeof(Slab) == kHeaderSize, "slab header size");
+
+struct SizeClass {
+  platform::SpinLock lock;
+  Slab *partial;
+  Slab *empty;  // one fully free slab kept back to avoid page churn
+  uint64_t live; // objects out of the slabs, cached ones included
+  uint64_t slabs;
+  uint64_t slab_batches;
+};
+
+// Free objects of one class, cached in front of the slabs
+struct Magazine {
+  uint32_t count;
+  void *objects[kMagazineSize];
+};
+
+// Per-CPU cache of a class: a loaded magazine and a spare, so alternating
+// allocs and frees at a magazine boundary do not hit the depot each time
+struct CpuCache {
+  Magazine loaded;
+  Magazine previous;
+  uint64_t allocs;
+  uint64_t frees;
+};
+
+// Full magazines shared between CPUs
+struct Depot {
+  platform::SpinLock lock;
+  uint32_t full_count;
+  Magazine full[kDepotMagazines];
+  uint64_t exchanges;
+};
+
+static SizeClass s_classes[kClassCount];
+static CpuCache s_caches[platform::kMaxCpus][kClassCount];
+static Depot s_depots[kClassCount];
+static platform::SpinLock s_large_lock;
+static uint64_t s_large_bytes = 0;
+static uint64_t s_large_count = 0;
+
+uint32_t class_size(uint32_t index) {
+  return index < kClassCount ? kClassSizes[index] : 0;
+}
+
+// Offset of a class's first object in its slab. Objects of power-of-two
+// classes larger than the header start one object in, so each sits at a
+// multiple of its size and is aligned to it. No object is lost by this: the
+// header already kept the first one from fitting.
+static constexpr uint32_t first_object(uint32_t size) {
+  return (size & (size - 1)) == 0 && size > kHeaderSize ? size : kHeaderSize;
+}
+
+// Smallest class holding bytes whose objects are aligned to align. Every
+// object is 16-byte aligned and those of power-of-two classes are aligned
+// to their size, so only alignment past kMaxSmall takes the large path.
+static uint32_t class_for(std::size_t bytes, std::size_t align) {
+  for (uint32_t i = 0; i < kClassCount; ++i) {
+    const uint32_t size = kClassSizes[i];
+    if (size < bytes)
+      continue;
+    if (align <= 16 || ((size & (size - 1)) == 0 && size >= align))
+      return i;
+  }
+  return kLarge;
+}
+
+static inline Slab *slab_of(const void *ptr) {
+  return reinterpret_cast<Slab *>(reinterpret_cast<uintptr_t>(ptr) &
+                                  ~(kSlabSize - 1));
+}
+
+static void list_push(Slab *&head, Slab *s) {
+  s->prev = nullptr;
+  s->next = head;
+  if (head)
+    head->prev = s;
+  head = s;
+  s->listed = true;
+}
+
+static void list_remove(Slab *&head, Slab *s) {
+  if (s->prev)
+    s->prev->next = s->next;
+  else
+    head = s->next;
+  if (s->next)
+    s->next->prev = s->prev;
+  s->next = s->prev = nullptr;
+  s->listed = false;
+}
+
+// Carve a fresh slab into objects of one class
+static Slab *new_slab(uint32_t index) {
+  void *block = pmm::alloc_pages(kSlabOrder);
+  if (block == nullptr)
+    return nullptr;
+  Slab *s = static_cast<Slab *>(block);
+  s->magic = kMagic;
+  s->size_class = index;
+  s->order = kSlabOrder;
+  s->in_use = 0;
+  s->free = nullptr;
+  s->next = s->prev = nullptr;
+  s->listed = false;
+  s->owned = 0;
+  const uint32_t size = kClassSizes[index];
+  const uint32_t offset = first_object(size);
+  const uint32_t count = (kSlabSize - offset) / size;
+  uint8_t *base = static_cast<uint8_t *>(block) + offset;
+  for (uint32_t i = count; i > 0; --i) {
+    FreeObject *o = reinterpret_cast<FreeObject *>(base + (i - 1) * size);
+    o->next = s->free;
+    s->free = o;
+  }
+  return s;
+}
+
+static void *alloc_large(std::size_t bytes, std::size_t align) {
+  // The payload starts past the header, at the requested alignment
+  const uint64_t offset = align > kHeaderSize ? align : kHeaderSize;
+  uint32_t order = pmm::order_for(offset + bytes);
+  if (order < kSlabOrder)
+    order = kSlabOrder;
+  if (offset >= kSlabSize || order > pmm::kMaxOrder)
+    return nullptr;
+  void *block = pmm::alloc_pages(order);
+  if (block == nullptr)
+    return nullptr;
+  Slab *s = static_cast<Slab *>(block);
+  s->magic = kMagic;
+  s->size_class = kLarge;
+  s->order = order;
+  s->owned = 0;
+  {
+    platform::SpinGuard guard(s_large_lock);
+    s_large_bytes += pmm::kPageSize << order;
+    ++s_large_count;
+  }
+  return static_cast<uint8_t *>(block) + offset;
+}
+
+// Slab layer. Callers hold the class lock.
+
+static void *slab_pop(SizeClass &c, uint32_t index) {
+  Slab *s = c.partial;
+  if (s == nullptr) {
+    if (c.empty != nullptr) {
+      s = c.empty;
+      c.empty = nullptr;
+    } else {
+      s = new_slab(index);
+      if (s == nullptr)
+        return nullptr;
+      ++c.slabs;
+    }
+    list_push(c.partial, s);
+  }
+  FreeObject *o = s->free;
+  s->free = o->next;
+  ++s->in_use;
+  ++c.live;
+  if (s->free == nullptr)
+    list_remove(c.partial, s);
+  return o;
+}
+
+// Returns a slab that became surplus; the caller frees its pages unlocked
+static Slab *slab_push(SizeClass &c, void *ptr) {
+  Slab *s = slab_of(ptr);
+  FreeObject *o = static_cast<FreeObject *>(ptr);
+  o->next = s->free;
+  s->free = o;
+  --s->in_use;
+  --c.live;
+  if (!s->listed)
+    list_push(c.partial, s);
+  if (s->in_use != 0)
+    return nullptr;
+  // Keep one empty slab per class; give the pages of any other back
+  list_remove(c.partial, s);
+  if (c.empty == nullptr) {
+    c.empty = s;
+    return nullptr;
+  }
+  --c.slabs;
+  return s;
+}
+
+static void release_slab(Slab *s) {
+  s->magic = 0;
+  pmm::free_pages(s, kSlabOrder);
+}
+
+// Move up to n objects between the slabs and a magazine under one lock
+static void slab_fill(uint32_t index, Magazine &m, uint32_t n) {
+  SizeClass &c = s_classes[index];
+  platform::SpinGuard guard(c.lock);
+  ++c.slab_batches;
+  while (m.count < n) {
+    void *o = slab_pop(c, index);
+    if (o == nullptr)
+      return;
+    m.objects[m.count++] = o;
+  }
+}
+
+static void slab_drain(uint32_t index, Magazine &m) {
+  SizeClass &c = s_classes[index];
+  Slab *surplus[kMagazineSize];
+  uint32_t surplus_count = 0;
+  {
+    platform::SpinGuard guard(c.lock);
+    ++c.slab_batches;
+    while (m.count > 0) {
+      Slab *s = slab_push(c, m.objects[--m.count]);
+      if (s != nullptr)
+        surplus[surplus_count++] = s;
+    }
+  }
+  for (uint32_t i = 0; i < surplus_count; ++i)
+    release_slab(surplus[i]);
+}
+
+// Magazine layer. A CPU's cache is only touched by that CPU, so the fast
+// paths take no lock; the depot is entered one whole magazine at a time.
+
+static inline void swap(Magazine &a, Magazine &b) {
+  Magazine t = a;
+  a = b;
+  b = t;
+}
+
+static void *cache_alloc(uint32_t index) {
+  CpuCache &cc = s_caches[platform::current_cpu()][index];
+  ++cc.allocs;
+  if (cc.loaded.count == 0) {
+    if (cc.previous.count > 0) {
+      swap(cc.loaded, cc.previous);
+    } else {
+      // Trade the empty magazine for a full one from the depot, or fill it
+      // from the slabs half way so the next frees have room
+      Depot &d = s_depots[index];
+      {
+        platform::SpinGuard guard(d.lock);
+        if (d.full_count > 0) {
+          ++d.exchanges;
+          cc.loaded = d.full[--d.full_count];
+        }
+      }
+      if (cc.loaded.count == 0)
+        slab_fill(index, cc.loaded, kMagazineSize / 2);
+      if (cc.loaded.count == 0) {
+        --cc.allocs;
+        return nullptr;
+      }
+    }
+  }
+  return cc.loaded.objects[--cc.loaded.count];
+}
+
+static void cache_free(uint32_t index, void *ptr) {
+  CpuCache &cc = s_caches[platform::current_cpu()][index];
+  ++cc.frees;
+  if (cc.loaded.count == kMagazineSize) {
+    if (cc.previous.count < kMagazineSize) {
+      swap(cc.loaded, cc.previous);
+    } else {
+      // Both full: park one in the depot, or return it to the slabs if the
+      // depot is full too, and keep going with an empty magazine
+      Depot &d = s_depots[index];
+      bool parked = false;
+      {
+        platform::SpinGuard guard(d.lock);
+        if (d.full_count < kDepotMagazines) {
+          ++d.exchanges;
+          d.full[d.full_count++] = cc.previous;
+          parked = true;
+        }
+      }
+      if (parked)
+        cc.previous.count = 0;
+      else
+        slab_drain(index, cc.previous);
+      swap(cc.loaded, cc.previous);
+    }
+  }
+  cc.loaded.objects[cc.loaded.count++] = ptr;
+}
+
+void *alloc(std::size_t bytes, std::size_t align) {
+  if (bytes == 0)
+    bytes = 1;
+  if (align == 0 || (align & (align - 1)) != 0)
+    return nullptr;
+  const uint32_t index = class_for(bytes, align);
+  void *p = index == kLarge ? alloc_large(bytes, align) : cache_alloc(index);
+  // What a window allocates is recorded for the leak checker. The owner
+  // check is a per-CPU load, so the fast path only pays for it when set.
+  if (p != nullptr && platform::mem_current_owner() != 0) {
+    Slab *s = slab_of(p);
+    const uint64_t size = index == kLarge ? pmm::kPageSize << s->order
+                                          : kClassSizes[index];
+    if (platform::mem_charge_owned(size, p))
+      __atomic_fetch_add(&s->owned, 1, __ATOMIC_RELAXED);
+  }
+  return p;
+}
+
+void free(void *ptr) {
+  if (ptr == nullptr)
+    return;
+  Slab *s = slab_of(ptr);
+  if (s->magic != kMagic)
+    return;
+  if (__atomic_load_n(&s->owned, __ATOMIC_RELAXED) != 0 &&
+      platform::mem_uncharge_owned(ptr))
+    __atomic_fetch_sub(&s->owned, 1, __ATOMIC_RELAXED);
+  if (s->size_class == kLarge) {
+    const uint32_t order = s->order;
+    {
+      platform::SpinGuard guard(s_large_lock);
+      s_large_bytes -= pmm::kPageSize << order;
+      --s_large_count;
+    }
+    s->magic = 0;
+    pmm::free_pages(s, order);
+    return;
+  }
+  cache_free(s->size_class, ptr);
+}
+
+void stats(Stats &out) {
+  for (uint32_t i = 0; i < kClassCount; ++i) {
+    // Per-CPU counters are read without stopping their CPUs, so a snapshot
+    // taken while others allocate is approximate
+    int64_t live = 0;
+    for (uint32_t cpu = 0; cpu < platform::kMaxCpus; ++cpu)
+      live += int64_t(s_caches[cpu][i].allocs - s_caches[cpu][i].frees);
+    if (live < 0)
+      live = 0;
+    SizeClass &c = s_classes[i];
+    {
+      platform::SpinGuard guard(c.lock);
+      out.live_objects[i] = uint64_t(live);
+      out.live_bytes[i] = uint64_t(live) * kClassSizes[i];
+      out.cached_objects[i] = c.live > uint64_t(live) ? c.live - live : 0;
+      out.slabs[i] = c.slabs;
+      out.slab_batches[i] = c.slab_batches;
+    }
+    Depot &d = s_depots[i];
+    platform::SpinGuard guard(d.lock);
+    out.depot_exchanges[i] = d.exchanges;
+  }
+  platform::SpinGuard guard(s_large_lock);
+  out.large_live_bytes = s_large_bytes;
+  out.large_live_count = s_large_count;
+}
+
+} // namespace mm::heap
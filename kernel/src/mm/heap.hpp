@@ -0,0 +1,42 @@
+// Kernel heap: size-class slabs for small objects, page blocks for the rest.
+// Small objects pass through per-CPU magazine caches, so allocating and
+// freeing on the same CPU usually takes no lock.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace mm::heap {
+
+// Size classes served from slabs; larger requests get their own page block
+static constexpr uint32_t kClassCount = 15;
+static constexpr uint32_t kMaxSmall = 4096;
+
+// Allocate bytes aligned to align (a power of two). Needs the page allocator;
+// returns nullptr before mm::pmm::init() or when memory runs out. What is
+// allocated while a memory owner is current is recorded for leak checking
+// (see platform::mem_charge_owned()).
+void *alloc(std::size_t bytes, std::size_t align = 16);
+
+// Free memory from alloc(); nullptr is ignored
+void free(void *ptr);
+
+// Object size of each size class
+uint32_t class_size(uint32_t index);
+
+struct Stats {
+  uint64_t live_objects[kClassCount];
+  uint64_t live_bytes[kClassCount];     // objects in use times the class size
+  uint64_t cached_objects[kClassCount]; // free, held in per-CPU magazines
+  uint64_t slabs[kClassCount];
+  // Trips past the per-CPU caches: magazines traded with the depot, and
+  // batches moved to or from the slabs under the class lock
+  uint64_t depot_exchanges[kClassCount];
+  uint64_t slab_batches[kClassCount];
+  uint64_t large_live_bytes; // page blocks backing large allocations
+  uint64_t large_live_count;
+};
+
+void stats(Stats &out);
+
+} // namespace mm::heap
@@ -0,0 +1,250 @@
+#include "pmm.hpp"
+#include "../../../ui/include/log.hpp"
+#include "../../../ui/include/smp.hpp"
+#include "bootmem.hpp"
+
+namespace mm::pmm {
+
+// Free blocks are linked through their own first bytes. A bitmap per order
+// marks the page frame numbers that start a free block of that order, so
+// freeing finds out in O(1) whether the buddy can be merged.
+struct FreeBlock {
+  FreeBlock *next;
+  FreeBlock *prev;
+};
+
+static FreeBlock *s_free[kMaxOrder + 1];
+static uint64_t *s_bitmap[kMaxOrder + 1];
+static uint64_t s_free_blocks[kMaxOrder + 1];
+static uint64_t s_page_limit = 0; // frames at or above are not tracked
+static uint64_t s_total_pages = 0;
+static uint64_t s_free_pages = 0;
+static uint64_t s_hhdm_offset = 0;
+static platform::SpinLock s_lock;
+
+uint64_t virt_to_phys(const void *virt) {
+  return reinterpret_cast<uint64_t>(virt) - s_hhdm_offset;
+}
+
+void *phys_to_virt(uint64_t phys) {
+  return reinterpret_cast<void *>(phys + s_hhdm_offset);
+}
+
+static inline bool test_bit(uint32_t order, uint64_t pfn) {
+  const uint64_t i = pfn >> order;
+  return (s_bitmap[order][i >> 6] >> (i & 63)) & 1;
+}
+
+static inline void set_bit(uint32_t order, uint64_t pfn, bool value) {
+  const uint64_t i = pfn >> order;
+  const uint64_t mask = uint64_t(1) << (i & 63);
+  if (value)
+    s_bitmap[order][i >> 6] |= mask;
+  else
+    s_bitmap[order][i >> 6] &= ~mask;
+}
+
+static inline FreeBlock *block_at(uint64_t pfn) {
+  return static_cast<FreeBlock *>(phys_to_virt(pfn * kPageSize));
+}
+
+static void push(uint32_t order, uint64_t pfn) {
+  FreeBlock *b = block_at(pfn);
+  b->prev = nullptr;
+  b->next = s_free[order];
+  if (b->next)
+    b->next->prev = b;
+  s_free[order] = b;
+  set_bit(order, pfn, true);
+  ++s_free_blocks[order];
+}
+
+static void unlink(uint32_t order, uint64_t pfn) {
+  FreeBlock *b = block_at(pfn);
+  if (b->prev)
+    b->prev->next = b->next;
+  else
+    s_free[order] = b->next;
+  if (b->next)
+    b->next->prev = b->prev;
+  set_bit(order, pfn, false);
+  --s_free_blocks[order];
+}
+
+// Put a block back, merging it with its buddy for as long as that is free
+static void release(uint64_t pfn, uint32_t order) {
+  s_free_pages += uint64_t(1) << order;
+  while (order < kMaxOrder) {
+    const uint64_t buddy = pfn ^ (uint64_t(1) << order);
+    if (buddy + (uint64_t(1) << order) > s_page_limit ||
+        !test_bit(order, buddy))
+      break;
+    unlink(order, buddy);
+    pfn &= ~(uint64_t(1) << order);
+    ++order;
+  }
+  push(order, pfn);
+}
+
+// Free the frames [pfn, last) as the largest aligned blocks that fit
+static void release_range(uint64_t pfn, uint64_t last) {
+  while (pfn < last) {
+    uint32_t order = kMaxOrder;
+    while (order > 0 && ((pfn & ((uint64_t(1) << order) - 1)) != 0 ||
+                         pfn + (uint64_t(1) << order) > last))
+      --order;
+    release(pfn, order);
+    pfn += uint64_t(1) << order;
+  }
+}
+
+// Hand a usable range over to the allocator
+static void add_range(uint64_t base, uint64_t end) {
+  const uint64_t pfn = (base + kPageSize - 1) / kPageSize;
+  uint64_t last = end / kPageSize;
+  if (last > s_page_limit)
+    last = s_page_limit;
+  if (pfn >= last)
+    return;
+  s_total_pages += last - pfn;
+  release_range(pfn, last);
+}
+
+bool init(const limine_memmap_response *memmap, uint64_t hhdm_offset) {
+  if (memmap == nullptr)
+    return false;
+  s_hhdm_offset = hhdm_offset;
+
+  // Frames are numbered from physical 0 up to the end of usable memory
+  uint64_t limit = 0;
+  for (uint64_t i = 0; i < memmap->entry_count; ++i) {
+    const limine_memmap_entry *e = memmap->entries[i];
+    if (e != nullptr && e->type == LIMINE_MEMMAP_USABLE &&
+        (e->base + e->length) / kPageSize > limit)
+      limit = (e->base + e->length) / kPageSize;
+  }
+  // Round up so every order's bitmap covers whole blocks
+  const uint64_t max_block = uint64_t(1) << kMaxOrder;
+  limit = (limit + max_block - 1) & ~(max_block - 1);
+  for (uint32_t order = 0; order <= kMaxOrder; ++order) {
+    const uint64_t words = ((limit >> order) + 63) / 64;
+    s_bitmap[order] = static_cast<uint64_t *>(
+        bootmem::alloc(words * sizeof(uint64_t), sizeof(uint64_t)));
+    if (s_bitmap[order] == nullptr)
+      return false;
+    for (uint64_t w = 0; w < words; ++w)
+      s_bitmap[order][w] = 0;
+    s_free[order] = nullptr;
+    s_free_blocks[order] = 0;
+  }
+  s_page_limit = limit;
+  bootmem::retire(&add_range);
+
+  platform::log("pmm: %lu MiB free, largest order %u\n",
+                s_free_pages * kPageSize >> 20, kMaxOrder);
+  return s_free_pages > 0;
+}
+
+// Take a free block of the order, splitting a larger one if need be; its
+// first frame, or UINT64_MAX if there is none. Called with s_lock held.
+static uint64_t take(uint32_t order) {
+  uint32_t k = order;
+  while (k <= kMaxOrder && s_free[k] == nullptr)
+    ++k;
+  if (k > kMaxOrder)
+    return UINT64_MAX;
+  const uint64_t pfn = virt_to_phys(s_free[k]) / kPageSize;
+  unlink(k, pfn);
+  // Split down to the requested order, freeing the upper halves
+  while (k > order) {
+    --k;
+    push(k, pfn + (uint64_t(1) << k));
+  }
+  s_free_pages -= uint64_t(1) << order;
+  return pfn;
+}
+
+void *alloc_pages(uint32_t order) {
+  if (order > kMaxOrder)
+    return nullptr;
+  platform::SpinGuard guard(s_lock);
+  const uint64_t pfn = take(order);
+  return pfn == UINT64_MAX ? nullptr : phys_to_virt(pfn * kPageSize);
+}
+
+void free_pages(void *pages, uint32_t order) {
+  if (pages == nullptr || order > kMaxOrder)
+    return;
+  platform::SpinGuard guard(s_lock);
+  release(virt_to_phys(pages) / kPageSize, order);
+}
+
+void *alloc_contiguous(uint64_t pages) {
+  if (pages == 0)
+    return nullptr;
+  const uint64_t max_block = uint64_t(1) << kMaxOrder;
+  platform::SpinGuard guard(s_lock);
+  if (pages <= max_block) {
+    // The smallest block that holds the run, less the pages past it
+    const uint32_t order = order_for(pages * kPageSize);
+    const uint64_t pfn = take(order);
+    if (pfn == UINT64_MAX)
+      return nullptr;
+    release_range(pfn + pages, pfn + (uint64_t(1) << order));
+    return phys_to_virt(pfn * kPageSize);
+  }
+  // Longer runs are made of largest blocks lying back to back
+  const uint64_t blocks = (pages + max_block - 1) / max_block;
+  for (FreeBlock *b = s_free[kMaxOrder]; b != nullptr; b = b->next) {
+    const uint64_t pfn = virt_to_phys(b) / kPageSize;
+    uint64_t n = 1;
+    while (n < blocks && pfn + (n + 1) * max_block <= s_page_limit &&
+           test_bit(kMaxOrder, pfn + n * max_block))
+      ++n;
+    if (n < blocks)
+      continue;
+    for (uint64_t i = 0; i < blocks; ++i)
+      unlink(kMaxOrder, pfn + i * max_block);
+    s_free_pages -= blocks * max_block;
+    release_range(pfn + pages, pfn + blocks * max_block);
+    return phys_to_virt(pfn * kPageSize);
+  }
+  return nullptr;
+}
+
+void free_contiguous(void *pages, uint64_t count) {
+  if (pages == nullptr)
+    return;
+  platform::SpinGuard guard(s_lock);
+  const uint64_t pfn = virt_to_phys(pages) / kPageSize;
+  release_range(pfn, pfn + count);
+}
+
+uint32_t order_for(uint64_t bytes) {
+  uint32_t order = 0;
+  while (order <= kMaxOrder && (kPageSize << order) < bytes)
+    ++order;
+  return order;
+}
+
+void stats(Stats &out) {
+  platform::SpinGuard guard(s_lock);
+  out.total_pages = s_total_pages;
+  out.free_pages = s_free_pages;
+  for (uint32_t order = 0; order <= kMaxOrder; ++order)
+    out.free_blocks[order] = s_free_blocks[order];
+}
+
+uint32_t fragmentation(uint32_t order) {
+  if (order > kMaxOrder)
+    return 100;
+  platform::SpinGuard guard(s_lock);
+  if (s_free_pages == 0)
+    return 100;
+  uint64_t usable = 0;
+  for (uint32_t k = order; k <= kMaxOrder; ++k)
+    usable += s_free_blocks[k] << k;
+  return static_cast<uint32_t>((s_free_pages - usable) * 100 / s_free_pages);
+}
+
+} // namespace mm::pmm
@@ -0,0 +1,55 @@
+// Physical page allocator: a binary buddy system over the Limine memory map
+#pragma once
+
+#include <cstdint>
+#include <limine.h>
+
+namespace mm::pmm {
+
+static constexpr uint64_t kPageSize = 4096;
+// Blocks are 2^order pages, from one page up to 16 MiB
+static constexpr uint32_t kMaxOrder = 12;
+
+// Take over the memory the boot allocator has not handed out. Call once
+// bootmem::init() and the early allocations are done; bootmem::alloc() fails
+// afterwards. Returns false if there is no memory to manage.
+bool init(const limine_memmap_response *memmap, uint64_t hhdm_offset);
+
+// Allocate 2^order contiguous pages aligned to their size, through the
+// direct map. Not zeroed. Returns nullptr when no block is large enough.
+void *alloc_pages(uint32_t order);
+
+// Return a block from alloc_pages() with the same order
+void free_pages(void *pages, uint32_t order);
+
+// Allocate exactly pages contiguous pages through the direct map, of any
+// length memory allows: runs past the largest block are taken as several of
+// them back to back, and the pages past the run are kept free. Aligned to
+// the smallest block holding the run, or to the largest block. Not zeroed.
+// Returns nullptr if no free run is long enough.
+void *alloc_contiguous(uint64_t pages);
+
+// Return count pages from alloc_contiguous(); part of a run may be returned
+// and the rest kept
+void free_contiguous(void *pages, uint64_t count);
+
+// Smallest order whose blocks hold bytes, or kMaxOrder + 1 if none does
+uint32_t order_for(uint64_t bytes);
+
+// Physical address of a direct-map address, and back
+uint64_t virt_to_phys(const void *virt);
+void *phys_to_virt(uint64_t phys);
+
+struct Stats {
+  uint64_t total_pages; // managed by the allocator
+  uint64_t free_pages;
+  uint64_t free_blocks[kMaxOrder + 1]; // free blocks of each order
+};
+
+void stats(Stats &out);
+
+// Share of free memory, in percent, held in blocks too small for an
+// allocation of the given order (0 = none, 100 = it cannot be satisfied)
+uint32_t fragmentation(uint32_t order);
+
+} // namespace mm::pmm
@@ -0,0 +1,641 @@
+#include "vmm.hpp"
+#include "../../../ui/include/log.hpp"
+#include "../../../ui/include/smp.hpp"
+#include "../interrupts.hpp"
+#include "../smp.hpp"
+#include "pmm.hpp"
+
+namespace mm::vmm {
+
+#if defined(__x86_64__)
+
+// Segment boundaries from the linker script
+extern "C" char __kernel_start[], __text_start[], __rodata_start[],
+    __data_start[], __kernel_end[];
+
+// Table entry bits
+static constexpr uint64_t kPresent = 1ull << 0;
+static constexpr uint64_t kWrite = 1ull << 1;
+static constexpr uint64_t kPwt = 1ull << 3;
+static constexpr uint64_t kPcd = 1ull << 4;
+static constexpr uint64_t kHuge = 1ull << 7;    // large leaf above level 0
+static constexpr uint64_t kPat4k = 1ull << 7;   // PAT bit of a 4 KiB leaf
+static constexpr uint64_t kPatHuge = 1ull << 12; // PAT bit of a large leaf
+static constexpr uint64_t kNoExec = 1ull << 63;
+static constexpr uint64_t kAddrMask = 0x000FFFFFFFFFF000ull;
+
+// The PAT layout Limine documents (WB, WT, UC-, UC, WP, WC, UC-, UC),
+// written again on every CPU so they are guaranteed to agree. Entry 5 (PAT +
+// PWT) is write-combining, entry 3 (PCD + PWT) uncached.
+static constexpr uint32_t kPatMsr = 0x277;
+static constexpr uint64_t kPatValue = 0x0007010500070406ull;
+static constexpr uint32_t kEferMsr = 0xC0000080;
+
+// Ranges up to this many pages are flushed page by page, larger ones by
+// reloading CR3
+static constexpr uint64_t kFlushPageLimit = 64;
+
+// Reservations are carved from their own window above the direct map; its
+// address space is handed out once and not reused after release
+static constexpr uint64_t kReserveBase = 0xFFFFC00000000000ull;
+static constexpr uint64_t kReserveSize = 64ull << 30;
+static constexpr uint32_t kMaxReservations = 64;
+static constexpr uint64_t kPresentFault = 1; // page fault error code bit
+
+// Levels count up from the leaves: 0 maps 4 KiB, 1 maps 2 MiB, 2 maps 1 GiB,
+// 3 is the PML4
+static uint64_t *s_pml4 = nullptr;
+static uint64_t s_pml4_phys = 0;
+static bool s_active = false;
+static bool s_pages_1g = false;
+static uint64_t s_no_exec = 0; // kNoExec once EFER.NXE is known to be on
+static uint64_t s_leaves[3];
+static uint64_t s_table_pages = 0;
+static uint64_t s_shootdowns = 0;
+static platform::SpinLock s_lock;
+
+struct Reservation {
+  uint64_t base; // 0 when the slot is free
+  uint64_t bytes;
+  uint32_t flags;
+  platform::MemTag tag; // charged for committed pages
+};
+
+// Guards the reservations and commits into them; taken before s_lock
+static Reservation s_reservations[kMaxReservations];
+static uint64_t s_reserve_next = kReserveBase;
+static uint64_t s_reserved_bytes = 0;
+static uint64_t s_committed_bytes = 0;
+static uint64_t s_demand_faults = 0;
+static platform::SpinLock s_reserve_lock;
+
+static inline uint64_t level_size(uint32_t level) {
+  return pmm::kPageSize << (9 * level);
+}
+
+static inline uint32_t index_of(uint64_t virt, uint32_t level) {
+  return (virt >> (12 + 9 * level)) & 511;
+}
+
+static inline bool is_leaf(uint64_t entry, uint32_t level) {
+  return level == 0 || (entry & kHuge) != 0;
+}
+
+static inline uint64_t leaf_phys(uint64_t entry, uint32_t level) {
+  return entry & kAddrMask & ~(level_size(level) - 1);
+}
+
+static inline uint64_t *table_of(uint64_t entry) {
+  return static_cast<uint64_t *>(pmm::phys_to_virt(entry & kAddrMask));
+}
+
+static inline uint64_t read_msr(uint32_t msr) {
+  uint32_t lo, hi;
+  asm volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+  return lo | (uint64_t(hi) << 32);
+}
+
+static inline void write_msr(uint32_t msr, uint64_t value) {
+  asm volatile("wrmsr"
+               :
+               : "c"(msr), "a"(static_cast<uint32_t>(value)),
+                 "d"(static_cast<uint32_t>(value >> 32)));
+}
+
+static inline void cpuid(uint32_t leaf, uint32_t &a, uint32_t &b, uint32_t &c,
+                         uint32_t &d) {
+  a = leaf;
+  c = 0;
+  asm volatile("cpuid" : "+a"(a), "=b"(b), "+c"(c), "=d"(d));
+}
+
+static uint64_t leaf_bits(uint32_t flags, uint32_t level) {
+  uint64_t bits = kPresent;
+  if (flags & kWritable)
+    bits |= kWrite;
+  if (!(flags & kExecutable))
+    bits |= s_no_exec;
+  if (flags & kUncached)
+    bits |= kPcd | kPwt;
+  else if (flags & kWriteCombining)
+    bits |= (level == 0 ? kPat4k : kPatHuge) | kPwt;
+  if (level > 0)
+    bits |= kHuge;
+  return bits;
+}
+
+static uint64_t *new_table() {
+  auto *table = static_cast<uint64_t *>(pmm::alloc_pages(0));
+  if (table == nullptr)
+    return nullptr;
+  for (uint32_t i = 0; i < 512; ++i)
+    table[i] = 0;
+  ++s_table_pages;
+  return table;
+}
+
+// Replace a large leaf with a table of 512 leaves one level down that map
+// the same memory with the same attributes
+static bool split(uint64_t &entry, uint32_t level) {
+  uint64_t *table = new_table();
+  if (table == nullptr)
+    return false;
+  const uint64_t phys = leaf_phys(entry, level);
+  const bool pat = (entry & kPatHuge) != 0;
+  uint64_t bits = entry & ~kAddrMask & ~kHuge;
+  const uint32_t child = level - 1;
+  if (child > 0)
+    bits |= kHuge | (pat ? kPatHuge : 0);
+  else if (pat)
+    bits |= kPat4k;
+  const uint64_t step = level_size(child);
+  for (uint32_t i = 0; i < 512; ++i)
+    table[i] = (phys + i * step) | bits;
+  --s_leaves[level];
+  s_leaves[child] += 512;
+  entry = pmm::virt_to_phys(table) | kPresent | kWrite;
+  return true;
+}
+
+// The entry at level that covers virt, creating tables and splitting large
+// pages above it on the way; nullptr when out of memory
+static uint64_t *entry_for(uint64_t virt, uint32_t level) {
+  uint64_t *table = s_pml4;
+  for (uint32_t l = 3; l > level; --l) {
+    uint64_t &e = table[index_of(virt, l)];
+    if (!(e & kPresent)) {
+      uint64_t *child = new_table();
+      if (child == nullptr)
+        return nullptr;
+      e = pmm::virt_to_phys(child) | kPresent | kWrite;
+    } else if (l < 3 && is_leaf(e, l) && !split(e, l)) {
+      return nullptr;
+    }
+    table = table_of(e);
+  }
+  return &table[index_of(virt, level)];
+}
+
+// The leaf that maps virt and its level, or nullptr and the level of the
+// missing entry
+static uint64_t *find_leaf(uint64_t virt, uint32_t &level) {
+  uint64_t *table = s_pml4;
+  for (uint32_t l = 3;; --l) {
+    uint64_t &e = table[index_of(virt, l)];
+    level = l;
+    if (!(e & kPresent))
+      return nullptr;
+    if (l < 3 && is_leaf(e, l))
+      return &e;
+    table = table_of(e);
+  }
+}
+
+// Call fn(entry, level) on every leaf in [virt, end), splitting large pages
+// that stick out of the range first. Holes are skipped; returns false if
+// there were any or a split ran out of memory.
+template <typename Fn>
+static bool for_each_leaf(uint64_t virt, uint64_t end, Fn fn) {
+  bool complete = true;
+  while (virt < end) {
+    uint32_t level;
+    uint64_t *e = find_leaf(virt, level);
+    const uint64_t size = level_size(level);
+    const uint64_t next = (virt & ~(size - 1)) + size;
+    if (e != nullptr && level > 0 && ((virt & (size - 1)) != 0 || next > end)) {
+      if (split(*e, level))
+        continue;
+      e = nullptr;
+    }
+    if (e == nullptr)
+      complete = false;
+    else
+      fn(*e, level);
+    if (next <= virt) // wrapped past the top of the address space
+      break;
+    virt = next;
+  }
+  return complete;
+}
+
+struct FlushRange {
+  uint64_t virt;
+  uint64_t bytes;
+};
+
+static void flush_local(void *ctx) {
+  const FlushRange &r = *static_cast<const FlushRange *>(ctx);
+  if (r.bytes / pmm::kPageSize > kFlushPageLimit) {
+    uint64_t cr3;
+    asm volatile("mov %%cr3, %0" : "=r"(cr3));
+    asm volatile("mov %0, %%cr3" : : "r"(cr3) : "memory");
+    return;
+  }
+  for (uint64_t off = 0; off < r.bytes; off += pmm::kPageSize)
+    asm volatile("invlpg (%0)" : : "r"(r.virt + off) : "memory");
+}
+
+// Flush a changed range from every CPU's TLB. Called without s_lock held:
+// another CPU spinning on it would never answer the call.
+static void shootdown(uint64_t virt, uint64_t bytes) {
+  if (!s_active)
+    return;
+  FlushRange r{virt, bytes};
+  flush_local(&r);
+  if (platform::online_cpu_count() > 1) {
+    platform::call_others(&flush_local, &r);
+    __atomic_fetch_add(&s_shootdowns, 1, __ATOMIC_RELAXED);
+  }
+}
+
+// Switch the calling CPU to the kernel tables. Toggling CR4.PGE first drops
+// global entries left from Limine's tables, which a CR3 load would keep.
+static void activate(void *) {
+  write_msr(kPatMsr, kPatValue);
+  uint64_t cr4;
+  asm volatile("mov %%cr4, %0" : "=r"(cr4));
+  if (cr4 & (1u << 7)) {
+    asm volatile("mov %0, %%cr4" : : "r"(cr4 & ~uint64_t(1u << 7)) : "memory");
+    asm volatile("mov %0, %%cr4" : : "r"(cr4) : "memory");
+  }
+  asm volatile("mov %0, %%cr3" : : "r"(s_pml4_phys) : "memory");
+}
+
+// Memory map types Limine's direct map covers
+static bool in_direct_map(uint64_t type) {
+  switch (type) {
+  case LIMINE_MEMMAP_USABLE:
+  case LIMINE_MEMMAP_BOOTLOADER_RECLAIMABLE:
+  case LIMINE_MEMMAP_EXECUTABLE_AND_MODULES:
+  case LIMINE_MEMMAP_FRAMEBUFFER:
+  case LIMINE_MEMMAP_ACPI_RECLAIMABLE:
+  case LIMINE_MEMMAP_ACPI_NVS:
+    return true;
+  default:
+    return false;
+  }
+}
+
+static bool handle_fault(uint64_t addr, uint64_t error);
+
+bool init(const limine_memmap_response *memmap, uint64_t hhdm_offset,
+          const limine_executable_address_response *kernel) {
+  if (memmap == nullptr || kernel == nullptr)
+    return false;
+  uint32_t a, b, c, d;
+  cpuid(0x80000000, a, b, c, d);
+  if (a >= 0x80000001) {
+    cpuid(0x80000001, a, b, c, d);
+    s_pages_1g = (d >> 26) & 1;
+    if (((d >> 20) & 1) && (read_msr(kEferMsr) & (1u << 11)))
+      s_no_exec = kNoExec;
+  }
+  s_pml4 = new_table();
+  if (s_pml4 == nullptr)
+    return false;
+  s_pml4_phys = pmm::virt_to_phys(s_pml4);
+
+  // The direct map, with neighbouring ranges of the same kind merged so
+  // large pages can span them
+  const uint64_t page_mask = pmm::kPageSize - 1;
+  bool ok = true;
+  uint64_t run_base = 0, run_end = 0;
+  uint32_t run_flags = 0;
+  for (uint64_t i = 0; i <= memmap->entry_count; ++i) {
+    const limine_memmap_entry *e =
+        i < memmap->entry_count ? memmap->entries[i] : nullptr;
+    if (i < memmap->entry_count && (e == nullptr || !in_direct_map(e->type)))
+      continue;
+    uint64_t base = 0, end = 0;
+    uint32_t flags = 0;
+    if (e != nullptr) {
+      base = e->base & ~page_mask;
+      end = (e->base + e->length + page_mask) & ~page_mask;
+      flags = kWritable;
+      if (e->type == LIMINE_MEMMAP_FRAMEBUFFER)
+        flags |= kWriteCombining;
+      if (run_end > run_base && base <= run_end && flags == run_flags) {
+        if (end > run_end)
+          run_end = end;
+        continue;
+      }
+    }
+    if (run_end > run_base)
+      ok &= map(hhdm_offset + run_base, run_base, run_end - run_base,
+                run_flags);
+    run_base = base;
+    run_end = end;
+    run_flags = flags;
+  }
+
+  // The kernel image, each segment with its own permissions
+  struct Segment {
+    const char *start;
+    const char *end;
+    uint32_t flags;
+  };
+  const Segment segments[] = {
+      {__kernel_start, __text_start, kWritable}, // Limine requests
+      {__text_start, __rodata_start, kExecutable},
+      {__rodata_start, __data_start, 0},
+      {__data_start, __kernel_end, kWritable},
+  };
+  for (const Segment &s : segments) {
+    const uint64_t start = reinterpret_cast<uint64_t>(s.start);
+    const uint64_t end =
+        (reinterpret_cast<uint64_t>(s.end) + page_mask) & ~page_mask;
+    if (end > start)
+      ok &= map(start, start - kernel->virtual_base + kernel->physical_base,
+                end - start, s.flags);
+  }
+  if (!ok) {
+    // The tables built so far are leaked; this only happens at boot
+    platform::log("vmm: out of memory for page tables, keeping Limine's\n");
+    s_pml4 = nullptr;
+    return false;
+  }
+
+  activate(nullptr);
+  platform::call_others(&activate, nullptr);
+  s_active = true;
+  platform::set_page_fault_handler(&handle_fault);
+  platform::log("vmm: %lu 1G, %lu 2M, %lu 4K pages in %lu table pages\n",
+                s_leaves[2], s_leaves[1], s_leaves[0], s_table_pages);
+  return true;
+}
+
+bool map(uint64_t virt, uint64_t phys, uint64_t bytes, uint32_t flags) {
+  if (s_pml4 == nullptr)
+    return false;
+  const uint64_t start = virt;
+  const uint64_t length = bytes;
+  bool ok = true;
+  bool replaced = false;
+  {
+    platform::SpinGuard guard(s_lock);
+    while (bytes > 0) {
+      uint32_t level = 0;
+      for (uint32_t l = s_pages_1g ? 2 : 1; l > 0; --l) {
+        const uint64_t size = level_size(l);
+        if (((virt | phys) & (size - 1)) == 0 && bytes >= size) {
+          level = l;
+          break;
+        }
+      }
+      uint64_t *e;
+      for (;;) {
+        e = entry_for(virt, level);
+        if (e == nullptr || !(*e & kPresent) || is_leaf(*e, level))
+          break;
+        // A table already sits here; fill it in instead of dropping it
+        --level;
+      }
+      if (e == nullptr) {
+        ok = false;
+        break;
+      }
+      if (*e & kPresent) {
+        replaced = true;
+        --s_leaves[level];
+      }
+      *e = phys | leaf_bits(flags, level);
+      ++s_leaves[level];
+      const uint64_t size = level_size(level);
+      virt += size;
+      phys += size;
+      bytes -= size;
+    }
+  }
+  if (replaced)
+    shootdown(start, length);
+  return ok;
+}
+
+void unmap(uint64_t virt, uint64_t bytes) {
+  if (s_pml4 == nullptr || bytes == 0)
+    return;
+  {
+    platform::SpinGuard guard(s_lock);
+    for_each_leaf(virt, virt + bytes, [](uint64_t &e, uint32_t level) {
+      e = 0;
+      --s_leaves[level];
+    });
+  }
+  shootdown(virt, bytes);
+}
+
+bool protect(uint64_t virt, uint64_t bytes, uint32_t flags) {
+  if (s_pml4 == nullptr)
+    return false;
+  bool ok;
+  {
+    platform::SpinGuard guard(s_lock);
+    const auto apply = [flags](uint64_t &e, uint32_t level) {
+      e = leaf_phys(e, level) | leaf_bits(flags, level);
+    };
+    ok = for_each_leaf(virt, virt + bytes, apply);
+  }
+  shootdown(virt, bytes);
+  return ok;
+}
+
+bool translate(uint64_t virt, uint64_t &phys) {
+  if (s_pml4 == nullptr)
+    return false;
+  platform::SpinGuard guard(s_lock);
+  uint32_t level;
+  const uint64_t *e = find_leaf(virt, level);
+  if (e == nullptr)
+    return false;
+  phys = leaf_phys(*e, level) + (virt & (level_size(level) - 1));
+  return true;
+}
+
+// The reservation containing addr. Called with s_reserve_lock held.
+static Reservation *reservation_at(uint64_t addr) {
+  for (Reservation &r : s_reservations)
+    if (r.base != 0 && addr - r.base < r.bytes)
+      return &r;
+  return nullptr;
+}
+
+// Whether nothing in the 2 MiB block at base is mapped yet
+static bool block_empty(uint64_t base) {
+  platform::SpinGuard guard(s_lock);
+  uint32_t level;
+  return find_leaf(base, level) == nullptr && level >= 1;
+}
+
+// Back the page around addr with zeroed memory: the whole 2 MiB block when it
+// lies inside the reservation and is still empty, else one 4 KiB page.
+// Called with s_reserve_lock held.
+static bool commit_at(const Reservation &r, uint64_t addr) {
+  const uint64_t block = level_size(1);
+  const uint64_t base = addr & ~(block - 1);
+  if (base >= r.base && base + block <= r.base + r.bytes && block_empty(base)) {
+    if (void *p = pmm::alloc_pages(9)) {
+      __builtin_memset(p, 0, block);
+      if (map(base, pmm::virt_to_phys(p), block, r.flags)) {
+        s_committed_bytes += block;
+        platform::mem_charge(r.tag, block);
+        return true;
+      }
+      pmm::free_pages(p, 9);
+    }
+  }
+  void *p = pmm::alloc_pages(0);
+  if (p == nullptr)
+    return false;
+  __builtin_memset(p, 0, pmm::kPageSize);
+  if (!map(addr & ~(pmm::kPageSize - 1), pmm::virt_to_phys(p), pmm::kPageSize,
+           r.flags)) {
+    pmm::free_pages(p, 0);
+    return false;
+  }
+  s_committed_bytes += pmm::kPageSize;
+  platform::mem_charge(r.tag, pmm::kPageSize);
+  return true;
+}
+
+// Page fault hook: first touch of a reserved page commits it
+static bool handle_fault(uint64_t addr, uint64_t error) {
+  if (error & kPresentFault)
+    return false; // a protection fault, not a missing page
+  platform::SpinGuard guard(s_reserve_lock);
+  const Reservation *r = reservation_at(addr);
+  if (r == nullptr)
+    return false;
+  uint64_t phys;
+  if (translate(addr, phys))
+    return true; // another CPU committed it first
+  if (!commit_at(*r, addr)) {
+    platform::log("vmm: out of memory committing 0x%lx\n", addr);
+    return false;
+  }
+  ++s_demand_faults;
+  return true;
+}
+
+void *reserve(uint64_t bytes, platform::MemTag tag, uint32_t flags) {
+  if (!s_active || bytes == 0)
+    return nullptr;
+  bytes = (bytes + pmm::kPageSize - 1) & ~(pmm::kPageSize - 1);
+  // Buffers big enough for a large page start on a 2 MiB boundary
+  const uint64_t block = level_size(1);
+  const uint64_t align = bytes >= block ? block : pmm::kPageSize;
+  platform::SpinGuard guard(s_reserve_lock);
+  const uint64_t base = (s_reserve_next + align - 1) & ~(align - 1);
+  const uint64_t end = kReserveBase + kReserveSize;
+  if (base > end || bytes > end - base)
+    return nullptr;
+  for (Reservation &r : s_reservations) {
+    if (r.base != 0)
+      continue;
+    r = Reservation{base, bytes, flags, tag};
+    s_reserve_next = base + bytes;
+    s_reserved_bytes += bytes;
+    return reinterpret_cast<void *>(base);
+  }
+  return nullptr;
+}
+
+bool commit(void *ptr, uint64_t bytes) {
+  const uint64_t start = reinterpret_cast<uint64_t>(ptr);
+  platform::SpinGuard guard(s_reserve_lock);
+  const Reservation *r = reservation_at(start);
+  if (r == nullptr || bytes > r->base + r->bytes - start)
+    return false;
+  const uint64_t end = start + bytes;
+  for (uint64_t addr = start & ~(pmm::kPageSize - 1); addr < end;
+       addr += pmm::kPageSize) {
+    uint64_t phys;
+    if (!translate(addr, phys) && !commit_at(*r, addr))
+      return false;
+  }
+  return true;
+}
+
+bool reserved(const void *ptr) {
+  return reinterpret_cast<uint64_t>(ptr) - kReserveBase < kReserveSize;
+}
+
+void release(void *ptr) {
+  const uint64_t base = reinterpret_cast<uint64_t>(ptr);
+  uint64_t bytes = 0;
+  platform::MemTag tag;
+  {
+    platform::SpinGuard guard(s_reserve_lock);
+    Reservation *r = reservation_at(base);
+    if (r == nullptr || r->base != base)
+      return;
+    bytes = r->bytes;
+    tag = r->tag;
+    r->base = 0;
+    s_reserved_bytes -= bytes;
+  }
+  // The committed pages are chained through their direct map view while the
+  // entries are cleared, and only freed once no TLB can reach them
+  struct Freed {
+    Freed *next;
+    uint32_t order;
+  };
+  Freed *freed = nullptr;
+  uint64_t committed = 0;
+  {
+    platform::SpinGuard guard(s_lock);
+    for_each_leaf(base, base + bytes, [&](uint64_t &e, uint32_t level) {
+      auto *f = static_cast<Freed *>(pmm::phys_to_virt(leaf_phys(e, level)));
+      f->next = freed;
+      f->order = 9 * level;
+      freed = f;
+      committed += level_size(level);
+      e = 0;
+      --s_leaves[level];
+    });
+  }
+  shootdown(base, bytes);
+  while (freed != nullptr) {
+    Freed *next = freed->next;
+    pmm::free_pages(freed, freed->order);
+    freed = next;
+  }
+  platform::mem_uncharge(tag, committed);
+  platform::SpinGuard guard(s_reserve_lock);
+  s_committed_bytes -= committed;
+}
+
+void stats(Stats &out) {
+  {
+    platform::SpinGuard guard(s_reserve_lock);
+    out.reserved_bytes = s_reserved_bytes;
+    out.committed_bytes = s_committed_bytes;
+    out.demand_faults = s_demand_faults;
+  }
+  platform::SpinGuard guard(s_lock);
+  out.pages_1g = s_leaves[2];
+  out.pages_2m = s_leaves[1];
+  out.pages_4k = s_leaves[0];
+  out.table_pages = s_table_pages;
+  out.shootdowns = __atomic_load_n(&s_shootdowns, __ATOMIC_RELAXED);
+}
+
+#else
+
+// Other architectures stay on Limine's tables for now
+bool init(const limine_memmap_response *, uint64_t,
+          const limine_executable_address_response *) {
+  return false;
+}
+bool map(uint64_t, uint64_t, uint64_t, uint32_t) { return false; }
+void unmap(uint64_t, uint64_t) {}
+bool protect(uint64_t, uint64_t, uint32_t) { return false; }
+bool translate(uint64_t, uint64_t &) { return false; }
+void *reserve(uint64_t, platform::MemTag, uint32_t) { return nullptr; }
+bool commit(void *, uint64_t) { return false; }
+bool reserved(const void *) { return false; }
+void release(void *) {}
+void stats(Stats &out) { out = Stats{}; }
+
+#endif
+
+} // namespace mm::vmm
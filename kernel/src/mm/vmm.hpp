@@ -0,0 +1,78 @@
+// Kernel virtual memory: the kernel's own 4-level page tables
+#pragma once
+
+#include "../../../ui/include/mem_account.hpp"
+#include <cstdint>
+#include <limine.h>
+
+namespace mm::vmm {
+
+// Mapping attributes; without any, a mapping is read-only and not executable
+enum Flags : uint32_t {
+  kWritable = 1u << 0,
+  kExecutable = 1u << 1,
+  kWriteCombining = 1u << 2, // framebuffers
+  kUncached = 1u << 3,       // device registers
+};
+
+// Build tables covering the direct map (every memory map range Limine maps
+// there, framebuffers write-combining) and the kernel image (per-segment
+// permissions), using 1 GiB and 2 MiB pages wherever alignment allows, then
+// switch every started CPU over to them. Needs the page allocator. Returns
+// false, leaving Limine's tables in place, if there is no memory for tables.
+bool init(const limine_memmap_response *memmap, uint64_t hhdm_offset,
+          const limine_executable_address_response *kernel);
+
+// Map [virt, virt + bytes) to physical memory starting at phys; all three
+// 4 KiB aligned. Large pages are used where both sides are aligned. Replacing
+// an existing mapping flushes it from every CPU. Returns false if a page
+// table could not be allocated; pages mapped before that stay mapped.
+bool map(uint64_t virt, uint64_t phys, uint64_t bytes, uint32_t flags);
+
+// Remove every mapping in [virt, virt + bytes), splitting large pages that
+// are only partly covered, and flush it from every CPU. Page tables are kept.
+void unmap(uint64_t virt, uint64_t bytes);
+
+// Change the attributes of [virt, virt + bytes), splitting large pages that
+// are only partly covered. Returns false if part of the range is not mapped
+// or a split ran out of memory; the mapped rest is still changed.
+bool protect(uint64_t virt, uint64_t bytes, uint32_t flags);
+
+// Physical address behind virt, or false if it is not mapped
+bool translate(uint64_t virt, uint64_t &phys);
+
+// Reserve address space for a buffer of bytes without backing it. Pages are
+// committed zeroed the first time they are touched (2 MiB at a time where a
+// whole aligned block lies in the buffer and memory allows, so large buffers
+// keep large pages), and until then cost nothing. Pages are charged to tag
+// as they are committed and uncharged by release(), so the tag shows the
+// memory actually in use. Returns nullptr before init() has succeeded or
+// when the reserve window or its table is full.
+void *reserve(uint64_t bytes, platform::MemTag tag, uint32_t flags = kWritable);
+
+// Back [ptr, ptr + bytes) of a reservation now instead of on first touch,
+// for memory that must not fault later. Returns false if memory ran out.
+bool commit(void *ptr, uint64_t bytes);
+
+// True if ptr lies in the address range reserve() hands out, telling a
+// buffer from reserve() apart from one taken from the page allocator
+bool reserved(const void *ptr);
+
+// Unmap a reservation and free whatever was committed in it; ptr is what
+// reserve() returned. Nothing may still be using the range.
+void release(void *ptr);
+
+struct Stats {
+  uint64_t pages_1g; // leaf entries of each size currently mapped
+  uint64_t pages_2m;
+  uint64_t pages_4k;
+  uint64_t table_pages;     // page table pages allocated
+  uint64_t shootdowns;      // flushes sent to the other CPUs
+  uint64_t reserved_bytes;  // address space held by live reservations
+  uint64_t committed_bytes; // memory backing them
+  uint64_t demand_faults;   // commits made by first touch
+};
+
+void stats(Stats &out);
+
+} // namespace mm::vmm
@@ -1,42 +1,63 @@
+#include "mm/heap.hpp"
 #include <cstddef>
 #include <new>
 
-// Minimal global new/delete operators for freestanding kernel
-// No allocator yet; new will halt to avoid silent misuse.
+// Global new/delete for the freestanding kernel, backed by the slab heap.
+// Plain new cannot report failure, so running out of memory (or allocating
+// before the page allocator is up) halts; the nothrow forms return nullptr.
+
+// The nothrow tag normally comes with the C++ runtime library
+namespace std {
+const nothrow_t nothrow{};
+} // namespace std
 
 extern "C" void hcf(); // from main.cpp
 
-void *operator new(std::size_t) {
-  hcf();
-  return nullptr;
+static void *checked(void *p) {
+  if (p == nullptr)
+    hcf();
+  return p;
 }
 
-void *operator new[](std::size_t) {
-  hcf();
-  return nullptr;
+void *operator new(std::size_t size) { return checked(mm::heap::alloc(size)); }
+
+void *operator new[](std::size_t size) {
+  return checked(mm::heap::alloc(size));
 }
 
-void *operator new(std::size_t, std::align_val_t) {
-  hcf();
-  return nullptr;
+void *operator new(std::size_t size, std::align_val_t align) {
+  return checked(mm::heap::alloc(size, static_cast<std::size_t>(align)));
 }
 
-void *operator new[](std::size_t, std::align_val_t) {
-  hcf();
-  return nullptr;
+void *operator new[](std::size_t size, std::align_val_t align) {
+  return checked(mm::heap::alloc(size, static_cast<std::size_t>(align)));
 }
 
-void operator delete(void *) noexcept {}
-void operator delete[](void *) noexcept {}
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  return mm::heap::alloc(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+  return mm::heap::alloc(size);
+}
 
-void operator delete(void *, std::size_t) noexcept {}
-void operator delete[](void *, std::size_t) noexcept {}
+void operator delete(void *p) noexcept { mm::heap::free(p); }
+void operator delete[](void *p) noexcept { mm::heap::free(p); }
 
-void operator delete(void *, std::align_val_t) noexcept {}
-void operator delete[](void *, std::align_val_t) noexcept {}
+void operator delete(void *p, std::size_t) noexcept { mm::heap::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { mm::heap::free(p); }
 
-void operator delete(void *, std::size_t, std::align_val_t) noexcept {}
-void operator delete[](void *, std::size_t, std::align_val_t) noexcept {}
+void operator delete(void *p, std::align_val_t) noexcept { mm::heap::free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept {
+  mm::heap::free(p);
+}
+
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept {
+  mm::heap::free(p);
+}
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept {
+  mm::heap::free(p);
+}
 
 // Itanium C++ ABI guard variables for thread-safe local statics
 extern "C" int __cxa_guard_acquire(long long *guard) {
@@ -0,0 +1,213 @@
+#include "smp.hpp"
+#include "../../ui/include/log.hpp"
+#include "../../ui/include/time.hpp"
+
+namespace platform {
+
+// Per-CPU block. On x86_64 the GS base points at the running CPU's block, so
+// current_cpu() is a single load.
+struct alignas(64) Cpu {
+  uint32_t index; // must stay first: read through %gs:0
+  uint32_t lapic_id;
+  uint32_t go;   // generation the boot CPU last posted to this CPU
+  uint32_t done; // generation this CPU last finished
+  uint32_t call_done; // call_others() generation this CPU last ran
+  // Work this CPU did in the last parallel_for()
+  uint32_t items;
+  uint64_t busy_ticks;
+};
+
+// The item range of the current parallel_for()
+struct Work {
+  void (*fn)(uint32_t, void *);
+  void *ctx;
+  uint32_t count;
+  uint32_t next;
+};
+
+static Cpu s_cpus[kMaxCpus];
+static uint32_t s_cpu_count = 1;
+static uint32_t s_parallel_cpus = 1; // the first this many run parallel_for()
+static bool s_started = false;
+static Work s_work;
+static uint32_t s_generation = 0;
+
+// The call_others() in flight; one at a time under s_call_lock
+struct Call {
+  void (*fn)(void *);
+  void *ctx;
+};
+
+static Call s_call;
+static uint32_t s_call_generation = 0;
+static SpinLock s_call_lock;
+
+static inline void cpu_relax() {
+#if defined(__x86_64__)
+  asm volatile("pause");
+#endif
+}
+
+// Run the posted call if this CPU has not run it yet
+static void poll_call(Cpu &cpu) {
+  const uint32_t gen = __atomic_load_n(&s_call_generation, __ATOMIC_ACQUIRE);
+  if (cpu.call_done == gen)
+    return;
+  s_call.fn(s_call.ctx);
+  __atomic_store_n(&cpu.call_done, gen, __ATOMIC_RELEASE);
+}
+
+static void run_items(Cpu &cpu) {
+  cpu.items = 0;
+  cpu.busy_ticks = 0;
+  for (;;) {
+    poll_call(cpu);
+    const uint32_t i = __atomic_fetch_add(&s_work.next, 1, __ATOMIC_RELAXED);
+    if (i >= s_work.count)
+      return;
+    const uint64_t start = timestamp();
+    s_work.fn(i, s_work.ctx);
+    cpu.busy_ticks += timestamp() - start;
+    ++cpu.items;
+  }
+}
+
+#if defined(__x86_64__)
+
+static inline void set_gs_base(const Cpu *cpu) {
+  const uint64_t v = reinterpret_cast<uint64_t>(cpu);
+  asm volatile("wrmsr"
+               :
+               : "c"(0xC0000101u), "a"(static_cast<uint32_t>(v)),
+                 "d"(static_cast<uint32_t>(v >> 32)));
+}
+
+uint32_t current_cpu() {
+  if (!s_started)
+    return 0;
+  uint32_t index;
+  asm volatile("movl %%gs:0, %0" : "=r"(index));
+  return index;
+}
+
+// Application processors land here and wait for generations to be posted
+static void ap_entry(limine_mp_info *info) {
+  Cpu &cpu = s_cpus[info->extra_argument];
+  set_gs_base(&cpu);
+  uint32_t seen = 0;
+  for (;;) {
+    uint32_t gen;
+    while ((gen = __atomic_load_n(&cpu.go, __ATOMIC_ACQUIRE)) == seen) {
+      poll_call(cpu);
+      cpu_relax();
+    }
+    seen = gen;
+    run_items(cpu);
+    __atomic_store_n(&cpu.done, seen, __ATOMIC_RELEASE);
+  }
+}
+
+void smp_init(limine_mp_response *mp) {
+  s_cpus[0].index = 0;
+  s_cpus[0].lapic_id = mp ? mp->bsp_lapic_id : 0;
+  set_gs_base(&s_cpus[0]);
+  s_cpu_count = 1;
+  s_started = true;
+  if (mp == nullptr)
+    return;
+  for (uint64_t i = 0; i < mp->cpu_count && s_cpu_count < kMaxCpus; ++i) {
+    limine_mp_info *info = mp->cpus[i];
+    if (info == nullptr || info->lapic_id == mp->bsp_lapic_id)
+      continue;
+    Cpu &cpu = s_cpus[s_cpu_count];
+    cpu.index = s_cpu_count;
+    cpu.lapic_id = info->lapic_id;
+    cpu.go = 0;
+    cpu.done = 0;
+    cpu.call_done = s_call_generation;
+    info->extra_argument = s_cpu_count;
+    // Writing goto_address releases the processor
+    __atomic_store_n(&info->goto_address, &ap_entry, __ATOMIC_SEQ_CST);
+    ++s_cpu_count;
+  }
+  s_parallel_cpus = s_cpu_count;
+  log("smp: %u of %lu CPUs online\n", s_cpu_count, mp->cpu_count);
+}
+
+#else
+
+uint32_t current_cpu() { return 0; }
+
+// Other architectures run everything on the boot CPU for now
+void smp_init(limine_mp_response *) {
+  s_cpu_count = 1;
+  s_started = true;
+}
+
+#endif
+
+uint32_t cpu_count() { return s_parallel_cpus; }
+
+uint32_t online_cpu_count() { return s_cpu_count; }
+
+void set_parallel_cpus(uint32_t cpus) {
+  s_parallel_cpus = cpus == 0 ? 1 : (cpus < s_cpu_count ? cpus : s_cpu_count);
+}
+
+void parallel_for(uint32_t count, void (*fn)(uint32_t, void *), void *ctx) {
+  if (count == 0)
+    return;
+  s_work.fn = fn;
+  s_work.ctx = ctx;
+  s_work.count = count;
+  s_work.next = 0;
+  const uint32_t cpus = s_parallel_cpus;
+  if (cpus == 1) {
+    run_items(s_cpus[0]);
+    return;
+  }
+  // Every AP posted to acknowledges its generation, so none can still be
+  // reading s_work when the next call rewrites it
+  const uint32_t gen = ++s_generation;
+  for (uint32_t c = 1; c < cpus; ++c)
+    __atomic_store_n(&s_cpus[c].go, gen, __ATOMIC_RELEASE);
+  run_items(s_cpus[0]);
+  // Barrier: every CPU has finished its items, and its stats are visible
+  for (uint32_t c = 1; c < cpus; ++c) {
+    while (__atomic_load_n(&s_cpus[c].done, __ATOMIC_ACQUIRE) != gen) {
+      poll_call(s_cpus[0]);
+      cpu_relax();
+    }
+  }
+}
+
+void call_others(void (*fn)(void *), void *ctx) {
+  if (s_cpu_count == 1)
+    return;
+  Cpu &self = s_cpus[current_cpu()];
+  // Keep answering other CPUs' calls while waiting for our turn
+  while (!s_call_lock.try_lock()) {
+    poll_call(self);
+    cpu_relax();
+  }
+  s_call.fn = fn;
+  s_call.ctx = ctx;
+  const uint32_t gen = s_call_generation + 1;
+  self.call_done = gen;
+  __atomic_store_n(&s_call_generation, gen, __ATOMIC_RELEASE);
+  for (uint32_t c = 0; c < s_cpu_count; ++c) {
+    while (__atomic_load_n(&s_cpus[c].call_done, __ATOMIC_ACQUIRE) != gen)
+      cpu_relax();
+  }
+  s_call_lock.unlock();
+}
+
+void last_parallel_stats(ParallelStats &out) {
+  out.cpus = s_parallel_cpus;
+  for (uint32_t c = 0; c < s_parallel_cpus; ++c) {
+    out.items[c] = s_cpus[c].items;
+    out.busy_ticks[c] = s_cpus[c].busy_ticks;
+  }
+}
+
+} // namespace platform
@@ -0,0 +1,29 @@
+// Application processor bring-up
+#pragma once
+
+#include "../../ui/include/smp.hpp"
+#include <limine.h>
+
+namespace platform {
+
+// Start up to kMaxCpus - 1 application processors from the Limine MP
+// response. They park until parallel_for() hands them work. Safe to call with
+// a null response; the boot CPU then works alone.
+void smp_init(limine_mp_response *mp);
+
+// Run fn(ctx) once on every other started CPU and return when all of them
+// have, e.g. for TLB shootdown. CPUs answer while idle, between
+// parallel_for() items and while waiting for one to finish, so any CPU may
+// call this, including from inside an item. fn must be short and must not
+// call call_others() itself.
+void call_others(void (*fn)(void *ctx), void *ctx);
+
+// Every started CPU. cpu_count() may be lower while parallel work is limited;
+// call_others() always reaches all of them.
+uint32_t online_cpu_count();
+
+// Let parallel_for() use only the first cpus CPUs (clamped to [1, online]),
+// to measure how work scales. Boot CPU only, outside parallel_for().
+void set_parallel_cpus(uint32_t cpus);
+
+} // namespace platform
@@ -90,6 +90,12 @@ bool get_current_datetime(DateTime &out) {
   return true;
 }
 
+static inline uint64_t rdtsc() {
+  uint32_t lo, hi;
+  asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+  return (static_cast<uint64_t>(hi) << 32) | lo;
+}
+
 #else
 
 bool get_current_datetime(DateTime &out) {
@@ -99,4 +105,148 @@ bool get_current_datetime(DateTime &out) {
 
 #endif
 
+// Timestamp tick rate; assume 1 GHz until calibrated
+static uint64_t s_timestamp_hz = 1000000000ull;
+
+#if defined(__x86_64__)
+
+uint64_t timestamp() { return rdtsc(); }
+
+void calibrate_timestamp() {
+  // Use PIT channel 2 in one-shot mode as a 10 ms reference window.
+  // Port 0x61 bit 0 gates channel 2, bit 1 drives the speaker (keep off),
+  // bit 5 reflects the channel 2 output which goes high at terminal count.
+  const uint32_t kPitHz = 1193182;
+  const uint16_t count = static_cast<uint16_t>(kPitHz / 100);
+  uint8_t gate = inb(0x61);
+  outb(0x61, (uint8_t)((gate & ~0x02) & ~0x01));
+  outb(0x43, 0xB0); // channel 2, lobyte/hibyte, mode 0, binary
+  outb(0x42, (uint8_t)(count & 0xFF));
+  outb(0x42, (uint8_t)(count >> 8));
+  outb(0x61, (uint8_t)((gate & ~0x02) | 0x01)); // start counting
+  const uint64_t t0 = rdtsc();
+  bool expired = false;
+  for (uint32_t i = 0; i < 100000000u; ++i) {
+    if (inb(0x61) & 0x20) {
+      expired = true;
+      break;
+    }
+  }
+  const uint64_t t1 = rdtsc();
+  outb(0x61, gate);
+  if (expired && t1 > t0) {
+    s_timestamp_hz = (t1 - t0) * 100u;
+  }
+}
+
+#elif defined(__aarch64__)
+
+uint64_t timestamp() {
+  uint64_t v;
+  asm volatile("mrs %0, cntvct_el0" : "=r"(v));
+  return v;
+}
+
+void calibrate_timestamp() {
+  uint64_t hz;
+  asm volatile("mrs %0, cntfrq_el0" : "=r"(hz));
+  if (hz != 0)
+    s_timestamp_hz = hz;
+}
+
+#else
+
+// No portable counter wired up yet: advance a software counter per read so
+// callers still observe monotonic progress.
+static uint64_t s_soft_ticks = 0;
+
+uint64_t timestamp() { return s_soft_ticks += 1000u; }
+
+void calibrate_timestamp() {}
+
+#endif
+
+uint64_t timestamp_frequency() { return s_timestamp_hz; }
+
+// Software clock state: RTC reading at boot, as Unix seconds, and the
+// timestamp it was taken at
+static bool s_clock_valid = false;
+static uint64_t s_clock_base_seconds = 0;
+static uint64_t s_clock_base_ticks = 0;
+
+// Days since 1970-01-01 for a proleptic Gregorian date
+static int64_t days_from_civil(int64_t y, int64_t m, int64_t d) {
+  y -= m <= 2;
+  const int64_t era = (y >= 0 ? y : y - 399) / 400;
+  const int64_t yoe = y - era * 400;
+  const int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  const int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+// Inverse of days_from_civil
+static void civil_from_days(int64_t z, int &year, int &month, int &day) {
+  z += 719468;
+  const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+  const int64_t doe = z - era * 146097;
+  const int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  const int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  const int64_t mp = (5 * doy + 2) / 153;
+  const int64_t m = mp < 10 ? mp + 3 : mp - 9;
+  year = static_cast<int>(yoe + era * 400 + (m <= 2 ? 1 : 0));
+  month = static_cast<int>(m);
+  day = static_cast<int>(doy - (153 * mp + 2) / 5 + 1);
+}
+
+void clock_init() {
+  DateTime dt{0, 0, 0, 0, 0, 0, false};
+  s_clock_base_ticks = timestamp();
+  if (!get_current_datetime(dt) || !dt.valid)
+    return;
+  const int64_t days = days_from_civil(dt.year, dt.month, dt.day);
+  if (days < 0)
+    return;
+  s_clock_base_seconds = static_cast<uint64_t>(days) * 86400u +
+                         static_cast<uint64_t>(dt.hour) * 3600u +
+                         static_cast<uint64_t>(dt.minute) * 60u +
+                         static_cast<uint64_t>(dt.second);
+  s_clock_valid = true;
+}
+
+uint64_t clock_seconds() {
+  if (!s_clock_valid)
+    return 0;
+  return s_clock_base_seconds +
+         (timestamp() - s_clock_base_ticks) / s_timestamp_hz;
+}
+
+bool now(DateTime &out) {
+  if (!s_clock_valid) {
+    out.valid = false;
+    return false;
+  }
+  const uint64_t secs = clock_seconds();
+  const uint64_t sod = secs % 86400u;
+  civil_from_days(static_cast<int64_t>(secs / 86400u), out.year, out.month,
+                  out.day);
+  out.hour = static_cast<int>(sod / 3600u);
+  out.minute = static_cast<int>((sod / 60u) % 60u);
+  out.second = static_cast<int>(sod % 60u);
+  out.valid = true;
+  return true;
+}
+
+uint64_t ticks_to_us(uint64_t ticks) {
+  // Split to avoid overflowing ticks * 1e6 for large tick counts
+  const uint64_t secs = ticks / s_timestamp_hz;
+  const uint64_t rem = ticks % s_timestamp_hz;
+  return secs * 1000000u + (rem * 1000000u) / s_timestamp_hz;
+}
+
+uint64_t us_to_ticks(uint64_t us) {
+  const uint64_t secs = us / 1000000u;
+  const uint64_t rem = us % 1000000u;
+  return secs * s_timestamp_hz + (rem * s_timestamp_hz) / 1000000u;
+}
+
 } // namespace platform
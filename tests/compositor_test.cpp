@@ -0,0 +1,65 @@
+// TileRenderer under the most damage a frame can carry: every output with
+// its full set of separate rects, each cut into one band per CPU. Every
+// damaged pixel has to be drawn, and nothing else.
+#include "compositor.hpp"
+#include "graphics.hpp"
+#include "host.hpp"
+
+using ui::compositor::DamageRegion;
+using ui::compositor::Output;
+using ui::compositor::TileRenderer;
+
+// As many CPUs as the renderer allows, run one after the other
+namespace platform {
+uint32_t cpu_count() { return kMaxCpus; }
+void parallel_for(uint32_t count, void (*fn)(uint32_t, void *), void *ctx) {
+  for (uint32_t i = 0; i < count; ++i)
+    fn(i, ctx);
+}
+void last_parallel_stats(ParallelStats &out) { out = ParallelStats{}; }
+} // namespace platform
+
+static constexpr uint32_t kOutputs = ui::compositor::kMaxOutputs;
+static constexpr uint32_t kSize = 256; // each output is kSize x kSize
+static constexpr uint32_t kStrip = kSize / DamageRegion::kMaxRects;
+static constexpr uint32_t kPainted = 0xFFFFFF;
+
+static uint32_t s_pixels[kOutputs][kSize * kSize];
+
+// The scene paints everything; clipping leaves only the band
+static void paint(Graphics &gfx, const void *) {
+  gfx.fill_rect(0, 0, kOutputs * kSize, kSize, kPainted);
+}
+
+int main() {
+  static Graphics gfx[kOutputs];
+  static Output outputs[kOutputs];
+  for (uint32_t o = 0; o < kOutputs; ++o) {
+    gfx[o] = Graphics(s_pixels[o], kSize, kSize, kSize);
+    gfx[o].set_origin(o * kSize, 0);
+    outputs[o].gfx = &gfx[o];
+    outputs[o].rect = ui::Rect{o * kSize, 0, kSize, kSize};
+    // Full-height strips with a gap, so none merge
+    for (uint32_t i = 0; i < DamageRegion::kMaxRects; ++i)
+      outputs[o].damage.add(
+          ui::Rect{o * kSize + i * kStrip, 0, kStrip - 2, kSize});
+    CHECK(outputs[o].damage.count() == DamageRegion::kMaxRects);
+  }
+
+  static TileRenderer renderer;
+  renderer.render(outputs, kOutputs, &paint, nullptr);
+  CHECK(renderer.last_tile_count() ==
+        kOutputs * DamageRegion::kMaxRects * platform::kMaxCpus);
+
+  for (uint32_t o = 0; o < kOutputs; ++o) {
+    for (uint32_t y = 0; y < kSize; ++y) {
+      for (uint32_t x = 0; x < kSize; ++x) {
+        const bool damaged = x % kStrip < kStrip - 2;
+        CHECK((s_pixels[o][y * kSize + x] == kPainted) == damaged);
+      }
+    }
+  }
+  std::printf("compositor: %u tiles cover all damage\n",
+              renderer.last_tile_count());
+  return 0;
+}
@@ -0,0 +1,125 @@
+// Benchmark for the slab heap over a fake memory map: cycles per alloc/free
+// pair on the per-CPU magazine fast path for each size class, then batches
+// large enough to go through the depot and the slabs. Aligned requests up to
+// a page must come from the slabs, aligned as asked. Allocations made while
+// an owner is current are charged for leak checking, and only their frees
+// look the record up again.
+#include "host.hpp"
+#include "mem_account.hpp"
+#include "mm/bootmem.hpp"
+#include "mm/heap.hpp"
+#include "mm/pmm.hpp"
+#include <sys/mman.h>
+
+// Leak-check hooks that count what the heap asks of them
+static uint32_t s_owner = 0;
+static uint64_t s_owned_bytes = 0;
+static uint32_t s_lookups = 0;
+
+namespace platform {
+uint32_t mem_current_owner() { return s_owner; }
+bool mem_charge_owned(uint64_t bytes, const void *) {
+  s_owned_bytes += bytes;
+  return true;
+}
+bool mem_uncharge_owned(const void *) {
+  ++s_lookups;
+  return true;
+}
+} // namespace platform
+
+static constexpr uint64_t kPhysBase = 16ull << 20;
+static constexpr uint64_t kArena = 128ull << 20;
+
+int main() {
+  void *arena = mmap(nullptr, kArena, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  CHECK(arena != MAP_FAILED);
+  const uint64_t hhdm = reinterpret_cast<uint64_t>(arena) - kPhysBase;
+  limine_memmap_entry usable{kPhysBase, kArena, LIMINE_MEMMAP_USABLE};
+  limine_memmap_entry *entries[] = {&usable};
+  limine_memmap_response memmap{0, 1, entries};
+  CHECK(mm::bootmem::init(&memmap, hhdm));
+  CHECK(mm::pmm::init(&memmap, hhdm));
+
+  // Fast path: each pair stays in the CPU's loaded magazine
+  std::printf("size  cycles/pair\n");
+  for (uint32_t i = 0; i < mm::heap::kClassCount; ++i) {
+    const uint32_t size = mm::heap::class_size(i);
+    constexpr uint32_t kRounds = 1000000;
+    mm::heap::free(mm::heap::alloc(size)); // warm the magazine
+    const uint64_t start = host::cycles();
+    for (uint32_t r = 0; r < kRounds; ++r) {
+      void *p = mm::heap::alloc(size);
+      host::keep(p);
+      mm::heap::free(p);
+    }
+    std::printf("%4u  %11lu\n", size,
+                (unsigned long)((host::cycles() - start) / kRounds));
+  }
+
+  // Batches: filling and emptying many magazines' worth at a time makes
+  // the caches trade with the depot and the slabs
+  constexpr uint32_t kBatch = 4096;
+  static void *batch[kBatch];
+  uint64_t alloc_cycles = 0, free_cycles = 0;
+  constexpr uint32_t kBatches = 200;
+  for (uint32_t b = 0; b < kBatches; ++b) {
+    const uint64_t t0 = host::cycles();
+    for (uint32_t i = 0; i < kBatch; ++i)
+      batch[i] = mm::heap::alloc(64);
+    const uint64_t t1 = host::cycles();
+    for (uint32_t i = 0; i < kBatch; ++i)
+      mm::heap::free(batch[i]);
+    alloc_cycles += t1 - t0;
+    free_cycles += host::cycles() - t1;
+    CHECK(batch[0] != nullptr && batch[kBatch - 1] != nullptr);
+  }
+  mm::heap::Stats st{};
+  mm::heap::stats(st);
+  std::printf("batches of %u: %lu cycles/alloc, %lu cycles/free, "
+              "%lu depot exchanges, %lu slab batches (64 B class)\n",
+              kBatch, (unsigned long)(alloc_cycles / (kBatch * kBatches)),
+              (unsigned long)(free_cycles / (kBatch * kBatches)),
+              (unsigned long)st.depot_exchanges[3],
+              (unsigned long)st.slab_batches[3]);
+
+  // Over-aligned objects up to a page stay in the slabs
+  for (uint64_t align = 32; align <= mm::heap::kMaxSmall; align <<= 1) {
+    void *p[3];
+    for (void *&q : p) {
+      q = mm::heap::alloc(align, align);
+      CHECK(q != nullptr);
+      CHECK(reinterpret_cast<uintptr_t>(q) % align == 0);
+    }
+    mm::heap::stats(st);
+    CHECK(st.large_live_count == 0);
+    for (void *q : p)
+      mm::heap::free(q);
+  }
+  void *big = mm::heap::alloc(16, 8192);
+  CHECK(big != nullptr && reinterpret_cast<uintptr_t>(big) % 8192 == 0);
+  mm::heap::stats(st);
+  CHECK(st.large_live_count == 1);
+  mm::heap::free(big);
+  std::printf("aligned allocations up to %u bytes served from slabs\n",
+              mm::heap::kMaxSmall);
+
+  // Owned objects are charged their class size or block, and freeing one
+  // looks it up; a slab with none owned frees without asking
+  void *plain = mm::heap::alloc(40);
+  s_owner = 7;
+  void *owned = mm::heap::alloc(40);
+  void *owned_large = mm::heap::alloc(100000);
+  s_owner = 0;
+  CHECK(s_owned_bytes == 48 + (128 << 10));
+  mm::heap::free(owned);
+  mm::heap::free(owned_large);
+  CHECK(s_lookups == 2);
+  mm::heap::free(plain);
+  void *other = mm::heap::alloc(16);
+  mm::heap::free(other);
+  CHECK(s_lookups == 2);
+  std::printf("owned allocations charged and uncharged\n");
+  return 0;
+}
@@ -0,0 +1,83 @@
+// HitMap against a brute-force scan of the stacking order, with hundreds of
+// overlapping windows, and a check that occlusion keeps cells from
+// overflowing into the slow path.
+#include "hit_test.hpp"
+#include "host.hpp"
+#include "taskbar.hpp"
+
+using ui::window_manager::kNoWindow;
+using ui::window_manager::WindowHandle;
+using ui::window_manager::WindowManager;
+
+// The pieces of ui.cpp and the taskbar the hit map and window layout use
+namespace ui {
+static Desktop s_desktop;
+void set_desktop(const Desktop &d) { s_desktop = d; }
+const Desktop &desktop() { return s_desktop; }
+void invalidate(const Rect &) {}
+const RenderShortcuts &render_shortcuts() {
+  static RenderShortcuts s{};
+  return s;
+}
+WindowHandle fullscreen_window(const WindowManager &) { return kNoWindow; }
+namespace taskbar {
+uint32_t height(uint32_t) { return 32; }
+} // namespace taskbar
+} // namespace ui
+
+static constexpr uint32_t kScreenW = 1920;
+static constexpr uint32_t kScreenH = 1080;
+
+// Topmost window whose frame holds the point. Every window here was focused
+// when opened or later, so the stacking order is the hit order.
+static WindowHandle brute_force(const WindowManager &wm, uint32_t x,
+                                uint32_t y) {
+  for (WindowHandle h = wm.top(); h != kNoWindow; h = wm.below(h)) {
+    const ui::window::Window &w = *wm.get(h);
+    const ui::Rect f =
+        ui::window::compute_layout(
+            w, ui::window::get_frame_rect(w, kScreenW, kScreenH))
+            .frame;
+    if (x >= f.x && x < f.x + f.w && y >= f.y && y < f.y + f.h)
+      return h;
+  }
+  return kNoWindow;
+}
+
+int main() {
+  ui::set_desktop(ui::Desktop{ui::Rect{0, 0, kScreenW, kScreenH},
+                              ui::Rect{0, 0, kScreenW, kScreenH}});
+  static WindowManager wm;
+  static ui::hit_test::HitMap map;
+  host::Rng rng(7);
+  WindowHandle handles[400];
+  for (WindowHandle &h : handles) {
+    ui::window::Window w{};
+    w.title = "w";
+    w.rect.w = 200 + rng.below(600);
+    w.rect.h = 150 + rng.below(450);
+    w.rect.x = rng.below(kScreenW - w.rect.w + 1);
+    w.rect.y = rng.below(kScreenH - w.rect.h + 1);
+    w.resizable = w.movable = w.draggable = true;
+    h = wm.open(w);
+    CHECK(h != kNoWindow);
+  }
+  for (uint32_t round = 0; round < 20; ++round) {
+    for (uint32_t i = 0; i < 20; ++i)
+      wm.focus(handles[rng.below(400)]);
+    map.rebuild(wm);
+    const uint32_t cells = ((kScreenW + 31) / 32) * ((kScreenH + 31) / 32);
+    // Only cells crossed by the edges of many windows overflow; without
+    // occlusion most of the screen would
+    CHECK(map.overflowed_cells() * 50 < cells);
+    for (uint32_t i = 0; i < 20000; ++i) {
+      const uint32_t x = rng.below(kScreenW);
+      const uint32_t y = rng.below(kScreenH);
+      CHECK(map.query(x, y).window == brute_force(wm, x, y));
+    }
+    if (round == 0)
+      std::printf("hit map: 400 windows, %u of %u cells overflow\n",
+                  map.overflowed_cells(), cells);
+  }
+  return 0;
+}
@@ -0,0 +1,54 @@
+// Helpers shared by the host-side tests and benchmarks
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+// Fail the test with the condition and where it was checked
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__,    \
+                   #cond);                                                     \
+      std::exit(1);                                                            \
+    }                                                                          \
+  } while (0)
+
+namespace host {
+
+// Cycle counter for benchmarks (the timestamp counter on x86_64)
+inline uint64_t cycles() {
+#if defined(__x86_64__)
+  uint32_t lo, hi;
+  asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+  return lo | (uint64_t(hi) << 32);
+#else
+  uint64_t t;
+  asm volatile("mrs %0, cntvct_el0" : "=r"(t));
+  return t;
+#endif
+}
+
+// Deterministic pseudo-random numbers (xorshift64)
+class Rng {
+public:
+  explicit Rng(uint64_t seed) : state_(seed ? seed : 1) {}
+  uint64_t next() {
+    state_ ^= state_ << 13;
+    state_ ^= state_ >> 7;
+    state_ ^= state_ << 17;
+    return state_;
+  }
+  uint32_t below(uint32_t n) { return static_cast<uint32_t>(next() % n); }
+
+private:
+  uint64_t state_;
+};
+
+// Keep the compiler from dropping a benchmark's result
+template <typename T> inline void keep(const T &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+} // namespace host
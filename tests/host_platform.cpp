@@ -0,0 +1,55 @@
+// Host versions of the platform functions the tested sources call. Each is
+// weak, so a test that links the real implementation gets that instead.
+#include "host.hpp"
+#include "log.hpp"
+#include "mem_account.hpp"
+#include "mm/vmm.hpp"
+#include "smp.hpp"
+#include "time.hpp"
+#include <chrono>
+#include <cstdarg>
+
+namespace platform {
+
+__attribute__((weak)) void log(const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  std::vfprintf(stdout, fmt, args);
+  va_end(args);
+}
+
+__attribute__((weak)) uint64_t timestamp() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+__attribute__((weak)) uint64_t timestamp_frequency() { return 1000000000; }
+
+__attribute__((weak)) uint64_t ticks_to_us(uint64_t ticks) {
+  return ticks / 1000;
+}
+
+// One CPU on the host
+__attribute__((weak)) uint32_t current_cpu() { return 0; }
+
+__attribute__((weak)) void mem_charge(MemTag, uint64_t, const void *) {}
+__attribute__((weak)) void mem_uncharge(MemTag, uint64_t, const void *) {}
+__attribute__((weak)) uint32_t mem_current_owner() { return 0; }
+__attribute__((weak)) uint32_t mem_swap_owner(uint32_t) { return 0; }
+__attribute__((weak)) bool mem_charge_owned(uint64_t, const void *) {
+  return false;
+}
+__attribute__((weak)) bool mem_uncharge_owned(const void *) { return false; }
+__attribute__((weak)) uint32_t mem_report_leaks(uint32_t) { return 0; }
+
+} // namespace platform
+
+namespace mm::vmm {
+
+// No page tables on the host: callers take their fallback path
+__attribute__((weak)) void *reserve(uint64_t, platform::MemTag, uint32_t) {
+  return nullptr;
+}
+
+} // namespace mm::vmm
@@ -0,0 +1,37 @@
+// Size sweep of the kernel's memcpy and memset from 1 byte to 8 MiB: cycles
+// per call and bytes per cycle at each power of two, the buffers reused so
+// small sizes run from cache and the largest from memory.
+#include "host.hpp"
+#include <cstddef>
+#include <vector>
+
+extern "C" void *memcpy(void *, const void *, std::size_t);
+extern "C" void *memset(void *, int, std::size_t);
+static void *(*volatile s_memcpy)(void *, const void *, std::size_t) = memcpy;
+static void *(*volatile s_memset)(void *, int, std::size_t) = memset;
+
+static constexpr std::size_t kMaxSize = 8u << 20;
+
+int main() {
+  std::vector<uint8_t> src(kMaxSize, 0x5A), dst(kMaxSize);
+  std::printf("    bytes  memcpy cyc/call  B/cyc  memset cyc/call  B/cyc\n");
+  for (std::size_t n = 1; n <= kMaxSize; n *= 2) {
+    // About 64 MiB moved per size, and never fewer than 8 calls
+    const std::size_t calls = n < (8u << 20) ? (64u << 20) / n : 8;
+    const std::size_t rounds = calls < 1000000 ? calls : 1000000;
+    s_memcpy(dst.data(), src.data(), n);
+    uint64_t start = host::cycles();
+    for (std::size_t r = 0; r < rounds; ++r)
+      s_memcpy(dst.data(), src.data(), n);
+    const uint64_t copy = (host::cycles() - start) / rounds;
+    start = host::cycles();
+    for (std::size_t r = 0; r < rounds; ++r)
+      s_memset(dst.data(), static_cast<int>(r), n);
+    const uint64_t fill = (host::cycles() - start) / rounds;
+    host::keep(dst[n - 1]);
+    std::printf("%9lu  %15lu  %5.1f  %15lu  %5.1f\n", (unsigned long)n,
+                (unsigned long)copy, copy ? double(n) / copy : 0.0,
+                (unsigned long)fill, fill ? double(n) / fill : 0.0);
+  }
+  return 0;
+}
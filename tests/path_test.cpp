@@ -0,0 +1,114 @@
+// Checks for fs::Path: parsing with "." and "..", appending and going up,
+// component offsets, copies, and the length and depth limits, including a
+// name rejected part way through being copied in.
+#include "fs/path.hpp"
+#include "host.hpp"
+#include <cstring>
+#include <string>
+
+using fs::Path;
+
+static bool is(const Path &p, const char *expected) {
+  return std::strcmp(p.c_str(), expected) == 0 &&
+         p.length() == std::strlen(expected);
+}
+
+static std::string component(const Path &p, uint32_t i) {
+  uint32_t len = 0;
+  const char *c = p.component(i, len);
+  return std::string(c, len);
+}
+
+int main() {
+  // The root, however it is spelled
+  Path root;
+  CHECK(root.is_root() && root.depth() == 0 && is(root, "/"));
+  CHECK(std::strcmp(root.name(), "") == 0);
+  CHECK(!root.parent());
+  const char *const spellings[] = {"",   "/",  "//",     ".",
+                                   "/./", "..", "/../..", nullptr};
+  for (const char *spelling : spellings) {
+    Path p(spelling);
+    CHECK(p.is_root() && is(p, "/"));
+  }
+
+  // Empty components and "." drop out, ".." goes up, never past the root
+  Path p("/docs//notes/./../img/../../docs/a.txt");
+  CHECK(is(p, "/docs/a.txt") && p.depth() == 2);
+  CHECK(is(Path("docs/sub"), "/docs/sub"));
+  CHECK(is(Path("/../../x/.."), "/"));
+  CHECK(is(Path("/a/../../b"), "/b"));
+
+  // Components and their offsets, the last one included
+  Path q("/usr/share/fonts");
+  CHECK(q.depth() == 3);
+  CHECK(component(q, 0) == "usr" && component(q, 1) == "share" &&
+        component(q, 2) == "fonts");
+  uint32_t len = 0;
+  CHECK(q.component(0, len) == q.c_str() + 1 && len == 3);
+  CHECK(q.component(1, len) == q.c_str() + 5 && len == 5);
+  CHECK(q.component(2, len) == q.c_str() + 11 && len == 5);
+  CHECK(std::strcmp(q.name(), "fonts") == 0);
+
+  // append() and parent()
+  CHECK(q.append("ttf", 3) && is(q, "/usr/share/fonts/ttf"));
+  CHECK(q.append(".", 1) && is(q, "/usr/share/fonts/ttf"));
+  CHECK(q.append("..", 2) && is(q, "/usr/share/fonts"));
+  CHECK(q.append("abc", 2) && is(q, "/usr/share/fonts/ab"));
+  CHECK(q.parent() && q.parent() && is(q, "/usr/share"));
+  CHECK(std::strcmp(q.name(), "share") == 0);
+  CHECK(q.parent() && q.parent() && q.is_root() && is(q, "/"));
+  CHECK(q.append("..", 2) && q.is_root());
+
+  // Bad names leave the path as it was, even once copying has started
+  Path r("/a/b");
+  CHECK(!r.append("", 0) && is(r, "/a/b"));
+  CHECK(!r.append("cd/e", 4) && is(r, "/a/b") && r.depth() == 2);
+  CHECK(!r.append("cd\0e", 4) && is(r, "/a/b"));
+  CHECK(r.append("c", 1) && is(r, "/a/b/c") && component(r, 2) == "c");
+
+  // Copies are independent and keep their offsets
+  Path copy(r);
+  Path assigned;
+  assigned = r;
+  r.parent();
+  CHECK(is(r, "/a/b") && is(copy, "/a/b/c") && is(assigned, "/a/b/c"));
+  CHECK(component(copy, 2) == "c" && component(assigned, 1) == "b");
+  assigned = root;
+  CHECK(assigned.is_root() && is(assigned, "/"));
+  assigned = assigned;
+  CHECK(assigned.is_root());
+
+  // Length limit: a full path takes no more, however short the name
+  const std::string longest(Path::kMaxLength - 1, 'x');
+  Path full;
+  CHECK(full.append(longest.c_str(), uint32_t(longest.size())));
+  CHECK(full.length() == Path::kMaxLength);
+  CHECK(!full.append("y", 1) && full.length() == Path::kMaxLength);
+  CHECK(full.parent() && full.is_root());
+  const std::string too_long(Path::kMaxLength, 'x');
+  CHECK(!full.append(too_long.c_str(), uint32_t(too_long.size())));
+  CHECK(full.is_root());
+
+  // Depth limit
+  Path deep;
+  for (uint32_t i = 0; i < Path::kMaxDepth; ++i)
+    CHECK(deep.append("d", 1));
+  CHECK(deep.depth() == Path::kMaxDepth);
+  CHECK(!deep.append("d", 1) && deep.depth() == Path::kMaxDepth);
+  CHECK(component(deep, Path::kMaxDepth - 1) == "d");
+  CHECK(deep.append("..", 2) && deep.depth() == Path::kMaxDepth - 1);
+
+  // assign() stops at what does not fit and keeps what did
+  std::string path;
+  for (uint32_t i = 0; i <= Path::kMaxDepth; ++i)
+    path += "/c" + std::to_string(i);
+  Path partial;
+  CHECK(!partial.assign(path.c_str()));
+  CHECK(partial.depth() == Path::kMaxDepth);
+  CHECK(component(partial, Path::kMaxDepth - 1) == "c31");
+  CHECK(partial.assign("/ok") && is(partial, "/ok"));
+
+  std::printf("path: all checks passed\n");
+  return 0;
+}
@@ -0,0 +1,158 @@
+// Stress benchmark for the buddy page allocator over a fake memory map: a
+// tight alloc/free loop per order, then a long random mix of block and
+// exact-length allocations checked against a frame ownership map. Freeing
+// everything must merge the free lists back to what init() built.
+#include "host.hpp"
+#include "mm/bootmem.hpp"
+#include "mm/pmm.hpp"
+#include <sys/mman.h>
+#include <vector>
+
+using mm::pmm::kMaxOrder;
+using mm::pmm::kPageSize;
+
+// Two usable ranges with a hole between them, the second not aligned to the
+// largest block, starting at 16 MiB physical
+static constexpr uint64_t kPhysBase = 16ull << 20;
+static constexpr uint64_t kArena = 256ull << 20;
+static constexpr uint64_t kHole0 = 120ull << 20;
+static constexpr uint64_t kHole1 = 123ull << 20;
+
+struct Live {
+  uint64_t pfn;
+  uint64_t pages;
+  uint32_t order; // block order, or UINT32_MAX for alloc_contiguous()
+};
+
+static uint8_t *s_arena;
+static std::vector<uint32_t> s_owner; // allocation id per frame, 0 = free
+
+static uint64_t pfn_of(const void *p) {
+  return mm::pmm::virt_to_phys(p) / kPageSize;
+}
+
+static void claim(const Live &a, uint32_t id) {
+  CHECK(a.pfn * kPageSize >= kPhysBase);
+  CHECK((a.pfn + a.pages) * kPageSize <= kPhysBase + kArena);
+  for (uint64_t i = 0; i < a.pages; ++i) {
+    const uint64_t f = a.pfn + i - kPhysBase / kPageSize;
+    CHECK(s_owner[f] == 0);
+    CHECK((a.pfn + i) * kPageSize < kPhysBase + kHole0 ||
+          (a.pfn + i) * kPageSize >= kPhysBase + kHole1);
+    s_owner[f] = id;
+  }
+}
+
+static void unclaim(const Live &a) {
+  for (uint64_t i = 0; i < a.pages; ++i)
+    s_owner[a.pfn + i - kPhysBase / kPageSize] = 0;
+}
+
+static void release(const Live &a) {
+  void *p = mm::pmm::phys_to_virt(a.pfn * kPageSize);
+  if (a.order == UINT32_MAX)
+    mm::pmm::free_contiguous(p, a.pages);
+  else
+    mm::pmm::free_pages(p, a.order);
+}
+
+int main() {
+  s_arena = static_cast<uint8_t *>(mmap(nullptr, kArena, PROT_READ | PROT_WRITE,
+                                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+  CHECK(s_arena != MAP_FAILED);
+  const uint64_t hhdm = reinterpret_cast<uint64_t>(s_arena) - kPhysBase;
+  limine_memmap_entry low{kPhysBase, kHole0, LIMINE_MEMMAP_USABLE};
+  limine_memmap_entry high{kPhysBase + kHole1, kArena - kHole1,
+                           LIMINE_MEMMAP_USABLE};
+  limine_memmap_entry *entries[] = {&low, &high};
+  limine_memmap_response memmap{0, 2, entries};
+  CHECK(mm::bootmem::init(&memmap, hhdm));
+  CHECK(mm::pmm::init(&memmap, hhdm));
+  s_owner.assign(kArena / kPageSize, 0);
+
+  mm::pmm::Stats initial;
+  mm::pmm::stats(initial);
+
+  // Tight loops: the cost of one alloc plus one free at each order
+  std::printf("order  cycles/pair\n");
+  for (uint32_t order = 0; order <= kMaxOrder; order += 3) {
+    constexpr uint32_t kRounds = 200000;
+    const uint64_t start = host::cycles();
+    for (uint32_t i = 0; i < kRounds; ++i) {
+      void *p = mm::pmm::alloc_pages(order);
+      host::keep(p);
+      mm::pmm::free_pages(p, order);
+    }
+    std::printf("%5u  %11lu\n", order,
+                (unsigned long)((host::cycles() - start) / kRounds));
+  }
+
+  // Random mix: mostly small blocks, some large ones and exact runs up to
+  // past the largest block, freed in random order
+  host::Rng rng(41);
+  std::vector<Live> live;
+  uint32_t next_id = 1;
+  uint64_t allocs = 0, failures = 0, alloc_cycles = 0, free_cycles = 0;
+  uint32_t worst_fragmentation = 0;
+  constexpr uint32_t kOps = 400000;
+  for (uint32_t op = 0; op < kOps; ++op) {
+    const bool grow = live.empty() || rng.below(100) < 52;
+    if (!grow) {
+      const uint32_t i = rng.below(static_cast<uint32_t>(live.size()));
+      unclaim(live[i]);
+      const uint64_t t = host::cycles();
+      release(live[i]);
+      free_cycles += host::cycles() - t;
+      live[i] = live.back();
+      live.pop_back();
+      continue;
+    }
+    Live a{};
+    void *p;
+    const uint32_t kind = rng.below(100);
+    const uint64_t t = host::cycles();
+    if (kind < 90) {
+      a.order = kind < 70 ? rng.below(3) : rng.below(kMaxOrder + 1);
+      a.pages = uint64_t(1) << a.order;
+      p = mm::pmm::alloc_pages(a.order);
+    } else {
+      a.order = UINT32_MAX;
+      a.pages = 1 + rng.below(3 << kMaxOrder);
+      p = mm::pmm::alloc_contiguous(a.pages);
+    }
+    alloc_cycles += host::cycles() - t;
+    ++allocs;
+    if (p == nullptr) {
+      ++failures;
+      continue;
+    }
+    a.pfn = pfn_of(p);
+    if (a.order != UINT32_MAX)
+      CHECK((a.pfn & (a.pages - 1)) == 0);
+    claim(a, next_id++);
+    // The pages are ours: scribbling over them must not upset the allocator
+    static_cast<uint64_t *>(p)[0] = ~0ull;
+    static_cast<uint64_t *>(p)[1] = ~0ull;
+    live.push_back(a);
+    const uint32_t f = mm::pmm::fragmentation(6);
+    worst_fragmentation = f > worst_fragmentation ? f : worst_fragmentation;
+  }
+  std::printf("random mix: %lu allocs (%lu failed), %lu cycles/alloc, "
+              "%lu cycles/free, worst fragmentation at order 6: %u%%\n",
+              (unsigned long)allocs, (unsigned long)failures,
+              (unsigned long)(alloc_cycles / allocs),
+              (unsigned long)(free_cycles / (allocs - failures - live.size())),
+              worst_fragmentation);
+
+  for (const Live &a : live)
+    release(a);
+  mm::pmm::Stats final;
+  mm::pmm::stats(final);
+  CHECK(final.free_pages == initial.free_pages);
+  CHECK(final.total_pages == initial.total_pages);
+  for (uint32_t order = 0; order <= kMaxOrder; ++order)
+    CHECK(final.free_blocks[order] == initial.free_blocks[order]);
+  std::printf("all %lu pages free and merged back\n",
+              (unsigned long)final.free_pages);
+  return 0;
+}
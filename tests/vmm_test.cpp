@@ -0,0 +1,167 @@
+// Page table walker of the kernel VMM on the host: large-page selection in
+// map(), splitting in protect() and unmap(), translate() through every
+// level, and commit()/release() of a reservation. The tables come from the
+// real page allocator over an mmap arena. vmm.cpp is included so the test
+// can set up the root table without init(), whose MSR and CR3 accesses need
+// ring 0; no CPU ever walks these tables, so nothing is flushed.
+#include "host.hpp"
+#include "mm/bootmem.hpp"
+#include "mm/pmm.hpp"
+#include "mm/vmm.cpp"
+#include <sys/mman.h>
+
+// Referenced by init(), which the test does not call; the C runtime
+// already defines __data_start
+extern "C" {
+char __kernel_start[1], __text_start[1], __rodata_start[1], __kernel_end[1];
+}
+
+// Bytes charged to the tag of the reservation under test
+static int64_t s_charged = 0;
+
+namespace platform {
+void call_others(void (*)(void *), void *) {}
+uint32_t online_cpu_count() { return 1; }
+void set_page_fault_handler(PageFaultHandler) {}
+void mem_charge(MemTag tag, uint64_t bytes, const void *) {
+  if (tag == MemTag::FsCache)
+    s_charged += bytes;
+}
+void mem_uncharge(MemTag tag, uint64_t bytes, const void *) {
+  if (tag == MemTag::FsCache)
+    s_charged -= bytes;
+}
+} // namespace platform
+
+using namespace mm::vmm;
+
+static constexpr uint64_t kPhysBase = 16ull << 20;
+static constexpr uint64_t kArena = 64ull << 20;
+static constexpr uint64_t kGiB = 1ull << 30;
+static constexpr uint64_t kMiB = 1ull << 20;
+static constexpr uint64_t kVirt = 0xFFFF900000000000ull;
+
+static uint64_t phys_at(uint64_t virt) {
+  uint64_t phys = ~0ull;
+  CHECK(translate(virt, phys));
+  return phys;
+}
+
+static uint64_t leaf_at(uint64_t virt, uint32_t &level) {
+  const uint64_t *e = find_leaf(virt, level);
+  CHECK(e != nullptr);
+  return *e;
+}
+
+int main() {
+  void *arena = mmap(nullptr, kArena, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  CHECK(arena != MAP_FAILED);
+  const uint64_t hhdm = reinterpret_cast<uint64_t>(arena) - kPhysBase;
+  limine_memmap_entry usable{kPhysBase, kArena, LIMINE_MEMMAP_USABLE};
+  limine_memmap_entry *entries[] = {&usable};
+  limine_memmap_response memmap{0, 1, entries};
+  CHECK(mm::bootmem::init(&memmap, hhdm));
+  CHECK(mm::pmm::init(&memmap, hhdm));
+
+  // What init() does before building the direct map
+  s_pages_1g = true;
+  s_no_exec = kNoExec;
+  s_pml4 = new_table();
+  CHECK(s_pml4 != nullptr);
+  Stats st;
+
+  // 2 GiB plus 2 MiB plus 4 KiB at aligned addresses takes the largest
+  // page that fits each part
+  const uint64_t length = 2 * kGiB + 2 * kMiB + 4096;
+  CHECK(map(kVirt, 8 * kGiB, length, kWritable));
+  stats(st);
+  CHECK(st.pages_1g == 2 && st.pages_2m == 1 && st.pages_4k == 1);
+  const uint64_t offsets[] = {0, 4096, kGiB + 12345, 2 * kGiB + kMiB,
+                              2 * kGiB + 2 * kMiB + 4095};
+  for (uint64_t off : offsets)
+    CHECK(phys_at(kVirt + off) == 8 * kGiB + off);
+  uint64_t phys;
+  CHECK(!translate(kVirt + length, phys));
+
+  // Misaligned physical memory falls back to 4 KiB pages
+  CHECK(map(kVirt + 4 * kGiB, 4096, 4 * kMiB, kWritable));
+  stats(st);
+  CHECK(st.pages_4k == 1 + 1024);
+
+  // Protecting one page inside a 1 GiB page splits it down to 4 KiB: the
+  // page loses write access, everything around it keeps its mapping
+  const uint64_t page = kVirt + 3 * kMiB + 8192;
+  CHECK(protect(page, 4096, 0));
+  stats(st);
+  CHECK(st.pages_1g == 1 && st.pages_2m == 1 + 511);
+  CHECK(st.pages_4k == 1 + 1024 + 512);
+  uint32_t level;
+  uint64_t e = leaf_at(page, level);
+  CHECK(level == 0 && !(e & kWrite) && (e & kNoExec));
+  e = leaf_at(page + 4096, level);
+  CHECK(level == 0 && (e & kWrite));
+  e = leaf_at(kVirt, level);
+  CHECK(level == 1 && (e & kHuge) && (e & kWrite));
+  for (uint64_t off = 0; off < 8 * kMiB; off += 4096)
+    CHECK(phys_at(kVirt + off) == 8 * kGiB + off);
+
+  // Unmapping a 2 MiB-aligned hole removes exactly it
+  unmap(kVirt + 4 * kMiB, 2 * kMiB);
+  CHECK(!translate(kVirt + 4 * kMiB, phys));
+  CHECK(!translate(kVirt + 6 * kMiB - 1, phys));
+  CHECK(phys_at(kVirt + 4 * kMiB - 1) == 8 * kGiB + 4 * kMiB - 1);
+  CHECK(phys_at(kVirt + 6 * kMiB) == 8 * kGiB + 6 * kMiB);
+  // protect() over the hole reports it but still changes the rest
+  CHECK(!protect(kVirt + 2 * kMiB, 6 * kMiB, kWritable));
+  CHECK(leaf_at(page, level) & kWrite);
+
+  // A write-combining large page keeps its PAT selection when split
+  const uint64_t wc = kVirt + 8 * kGiB;
+  CHECK(map(wc, 0x40000000, 2 * kMiB, kWritable | kWriteCombining));
+  e = leaf_at(wc, level);
+  CHECK(level == 1 && (e & kPatHuge) && (e & kPwt));
+  unmap(wc + 4096, 4096);
+  e = leaf_at(wc, level);
+  CHECK(level == 0 && (e & kPat4k) && (e & kPwt));
+  CHECK(phys_at(wc + 2 * kMiB - 1) == 0x40000000 + 2 * kMiB - 1);
+
+  // Mapping a large page where a table already sits fills in the table
+  stats(st);
+  const uint64_t tables = st.table_pages;
+  CHECK(map(wc, 0x80000000, 2 * kMiB, kWritable));
+  stats(st);
+  CHECK(st.table_pages == tables);
+  CHECK(phys_at(wc + 4096) == 0x80000000 + 4096);
+
+  // commit() backs a reservation with a large page where a whole aligned
+  // block fits and 4 KiB pages elsewhere, charging its tag for each;
+  // release() gives it all back
+  mm::pmm::Stats before, after;
+  mm::pmm::stats(before);
+  s_reservations[0] =
+      Reservation{kReserveBase, 3 * kMiB, kWritable, platform::MemTag::FsCache};
+  s_reserved_bytes = 3 * kMiB;
+  auto *buffer = reinterpret_cast<uint8_t *>(kReserveBase);
+  CHECK(commit(buffer, kMiB));
+  CHECK(commit(buffer + 2 * kMiB + 100, 8192));
+  CHECK(!commit(buffer + 2 * kMiB, 2 * kMiB));
+  stats(st);
+  CHECK(st.committed_bytes == 2 * kMiB + 3 * 4096);
+  CHECK(s_charged == int64_t(st.committed_bytes));
+  const uint64_t backing = phys_at(kReserveBase);
+  CHECK(phys_at(kReserveBase + 2 * kMiB - 1) == backing + 2 * kMiB - 1);
+  CHECK(*static_cast<uint64_t *>(mm::pmm::phys_to_virt(backing)) == 0);
+  release(buffer);
+  stats(st);
+  CHECK(st.committed_bytes == 0 && st.reserved_bytes == 0);
+  CHECK(s_charged == 0);
+  CHECK(!translate(kReserveBase, phys));
+  mm::pmm::stats(after);
+  CHECK(after.free_pages == before.free_pages - (st.table_pages - tables));
+
+  std::printf("vmm: %lu 1G, %lu 2M, %lu 4K pages in %lu table pages\n",
+              (unsigned long)st.pages_1g, (unsigned long)st.pages_2m,
+              (unsigned long)st.pages_4k, (unsigned long)st.table_pages);
+  return 0;
+}
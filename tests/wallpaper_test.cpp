@@ -0,0 +1,63 @@
+// Wallpaper scaling: shrinking a pattern finer than the target's pixels
+// averages it instead of aliasing, and scaling keeps flat colors and 1:1
+// copies exact.
+#include "graphics.hpp"
+#include "host.hpp"
+#include "wallpaper.hpp"
+#include <vector>
+
+namespace ui::layer_cache {
+void invalidate_background() {}
+} // namespace ui::layer_cache
+
+static std::vector<uint32_t> render(uint32_t w, uint32_t h) {
+  std::vector<uint32_t> out(w * h, 0xDEAD);
+  Graphics gfx(out.data(), w, h, w);
+  CHECK(ui::wallpaper::draw(gfx));
+  return out;
+}
+
+static uint32_t channel_spread(const std::vector<uint32_t> &px,
+                               uint32_t expect) {
+  uint32_t worst = 0;
+  for (uint32_t p : px) {
+    for (uint32_t shift = 0; shift < 24; shift += 8) {
+      const int32_t c = (p >> shift) & 0xFF;
+      const uint32_t d = c > int32_t(expect) ? c - expect : expect - c;
+      worst = d > worst ? d : worst;
+    }
+  }
+  return worst;
+}
+
+int main() {
+  // One-pixel checkerboard shrunk by 10/3: every target pixel covers about
+  // as much black as white
+  const uint32_t sw = 1000, sh = 1000;
+  std::vector<uint32_t> checker(sw * sh);
+  for (uint32_t y = 0; y < sh; ++y)
+    for (uint32_t x = 0; x < sw; ++x)
+      checker[y * sw + x] = (x + y) % 2 ? 0xFFFFFF : 0;
+  ui::wallpaper::set(checker.data(), sw, sh);
+  const uint32_t spread = channel_spread(render(300, 300), 128);
+  CHECK(spread <= 16);
+
+  // A flat color stays exact at any scale
+  std::vector<uint32_t> flat(640 * 480, 0x336699);
+  ui::wallpaper::set(flat.data(), 640, 480);
+  for (uint32_t w : {100u, 333u, 640u, 1920u})
+    for (uint32_t p : render(w, w * 3 / 4))
+      CHECK(p == 0x336699);
+
+  // Same size is a straight copy
+  std::vector<uint32_t> noise(256 * 256);
+  host::Rng rng(5);
+  for (uint32_t &p : noise)
+    p = static_cast<uint32_t>(rng.next()) & 0xFFFFFF;
+  ui::wallpaper::set(noise.data(), 256, 256);
+  CHECK(render(256, 256) == noise);
+
+  std::printf("wallpaper: checkerboard shrunk 10:3 within %u of mid grey\n",
+              spread);
+  return 0;
+}
@@ -0,0 +1,149 @@
+// Stress test for WindowManager: hundreds of windows opened, raised, focused
+// and closed at random against a simple model of the stacking and creation
+// orders, with stale handles checked after every close.
+#include "host.hpp"
+#include "window_manager.hpp"
+#include <algorithm>
+#include <vector>
+
+using ui::window_manager::kNoWindow;
+using ui::window_manager::WindowHandle;
+using ui::window_manager::WindowManager;
+
+static uint32_t s_closed = 0;
+
+static void on_close(void *) { ++s_closed; }
+
+static WindowHandle open_window(WindowManager &wm, uint32_t id) {
+  ui::window::Window w{};
+  w.title = "test";
+  w.rect = ui::Rect{id % 800, id % 600, 100, 80};
+  w.user_data = reinterpret_cast<void *>(uintptr_t(id));
+  w.on_close = &on_close;
+  return wm.open(w);
+}
+
+static uint32_t id_of(const WindowManager &wm, WindowHandle h) {
+  return static_cast<uint32_t>(
+      reinterpret_cast<uintptr_t>(wm.get(h)->user_data));
+}
+
+struct Model {
+  std::vector<uint32_t> z;     // bottom to top
+  std::vector<uint32_t> order; // creation order
+  std::vector<WindowHandle> handles;
+  uint32_t focused = UINT32_MAX;
+};
+
+static void raise(Model &m, uint32_t id) {
+  m.z.erase(std::find(m.z.begin(), m.z.end(), id));
+  m.z.push_back(id);
+}
+
+static void verify(const WindowManager &wm, const Model &m) {
+  CHECK(wm.count() == m.z.size());
+  size_t i = 0;
+  for (WindowHandle h = wm.bottom(); h != kNoWindow; h = wm.above(h), ++i)
+    CHECK(i < m.z.size() && id_of(wm, h) == m.z[i]);
+  CHECK(i == m.z.size());
+  i = m.z.size();
+  for (WindowHandle h = wm.top(); h != kNoWindow; h = wm.below(h))
+    CHECK(i > 0 && id_of(wm, h) == m.z[--i]);
+  CHECK(i == 0);
+  i = 0;
+  for (WindowHandle h = wm.first(); h != kNoWindow; h = wm.next(h), ++i)
+    CHECK(i < m.order.size() && id_of(wm, h) == m.order[i]);
+  CHECK(i == m.order.size());
+  if (m.focused == UINT32_MAX) {
+    CHECK(wm.focused() == kNoWindow);
+  } else {
+    CHECK(id_of(wm, wm.focused()) == m.focused);
+    CHECK(wm.get(wm.focused())->focused);
+  }
+}
+
+int main() {
+  static constexpr uint32_t kWindows = 1500; // past the old 1024 cap
+  static constexpr uint32_t kOps = 20000;
+  WindowManager wm;
+  Model m;
+  host::Rng rng(42);
+  std::vector<WindowHandle> stale;
+  uint32_t next_id = 0;
+
+  for (; next_id < kWindows; ++next_id) {
+    const WindowHandle h = open_window(wm, next_id);
+    CHECK(h != kNoWindow);
+    m.handles.push_back(h);
+    m.z.push_back(next_id);
+    m.order.push_back(next_id);
+    m.focused = next_id;
+  }
+  CHECK(wm.capacity() >= kWindows);
+  verify(wm, m);
+
+  for (uint32_t op = 0; op < kOps; ++op) {
+    // Opens and closes are equally likely, so the count wanders around
+    // kWindows
+    const uint32_t kind = rng.below(10);
+    if (m.order.empty() || kind <= 1) {
+      const WindowHandle h = open_window(wm, next_id);
+      CHECK(h != kNoWindow);
+      if (m.handles.size() <= next_id)
+        m.handles.resize(next_id + 1);
+      m.handles[next_id] = h;
+      m.z.push_back(next_id);
+      m.order.push_back(next_id);
+      m.focused = next_id++;
+      continue;
+    }
+    const uint32_t id = m.order[rng.below(uint32_t(m.order.size()))];
+    const WindowHandle h = m.handles[id];
+    CHECK(wm.valid(h));
+    if (kind <= 4) {
+      wm.raise(h);
+      raise(m, id);
+    } else if (kind <= 7) {
+      wm.focus(h);
+      raise(m, id);
+      m.focused = id;
+    } else {
+      const uint32_t closed = s_closed;
+      wm.close(h);
+      CHECK(s_closed == closed + 1);
+      m.z.erase(std::find(m.z.begin(), m.z.end(), id));
+      m.order.erase(std::find(m.order.begin(), m.order.end(), id));
+      if (m.focused == id)
+        m.focused = UINT32_MAX;
+      stale.push_back(h);
+    }
+    if (op % 500 == 0)
+      verify(wm, m);
+  }
+  verify(wm, m);
+
+  // Closed windows stay closed even after their slots are reused
+  for (const WindowHandle &h : stale) {
+    CHECK(!wm.valid(h));
+    CHECK(wm.get(h) == nullptr);
+    CHECK(wm.above(h) == kNoWindow && wm.below(h) == kNoWindow);
+    CHECK(wm.next(h) == kNoWindow);
+    const uint32_t closed = s_closed;
+    wm.close(h); // a no-op
+    wm.raise(h);
+    wm.focus(h);
+    CHECK(s_closed == closed);
+  }
+  verify(wm, m);
+
+  const uint32_t open = wm.count();
+  const uint32_t closed = s_closed;
+  while (wm.top() != kNoWindow)
+    wm.close(wm.top());
+  CHECK(s_closed == closed + open);
+  CHECK(wm.count() == 0 && wm.first() == kNoWindow);
+  std::printf("window manager: %u opened, %u still open at the end, "
+              "capacity %u, %zu stale handles checked\n",
+              next_id, open, wm.capacity(), stale.size());
+  return 0;
+}
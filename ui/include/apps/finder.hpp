@@ -9,10 +9,9 @@ namespace ui::apps::finder {
 
 struct FinderState {
   fs::Ext4 *fs;
-  const char *cwd; // points into cwd_buf
-  char cwd_buf[256];
-  char history[16][256];
-  uint32_t history_len;
+  // Directories are only entered from their parent, so going back is
+  // going up and the path itself is the history
+  fs::Path cwd;
   int32_t selected_index;
   int32_t hover_index;
   bool dragging;
@@ -21,17 +20,25 @@ struct FinderState {
   uint32_t last_mouse_y;
   uint32_t press_x;
   uint32_t press_y;
-  // File opening support
-  char file_to_open[256];
+  // File opening support: the main loop opens a viewer on file_to_open
+  fs::Path file_to_open;
   bool should_open_file;
   // Scrolling
   uint32_t scroll_offset;
-  uint32_t last_view_rows;
+  // Worked out on the main CPU before each frame for draw() to read: the
+  // listing without "." and ".." (frame scratch, gone after the frame) and
+  // how many rows fit the content area
+  const fs::Dirent *listing;
+  uint32_t listing_count;
+  uint32_t view_rows;
 };
 
 // Populate a Finder window configured to list the root directory of the given
-// fs. Returns the created window.
+// fs. Returns the created window, which owns its state until it is closed.
 ui::window::Window create_window(uint32_t screen_w, uint32_t screen_h,
                                  fs::Ext4 &filesystem);
 
+// State of a Finder window, or nullptr for any other window
+FinderState *state_of(const ui::window::Window &w);
+
 } // namespace ui::apps::finder
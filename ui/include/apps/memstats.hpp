@@ -0,0 +1,19 @@
+#pragma once
+
+#include "ui.hpp"
+#include "window.hpp"
+#include "window_manager.hpp"
+#include <cstdint>
+
+namespace ui::apps::memstats {
+
+// Memory use per accounting tag; a click in the window also dumps the full
+// report, page and heap totals included, to the serial log
+ui::window::Window create_window(uint32_t screen_w, uint32_t screen_h);
+
+// Take a snapshot of the numbers once a second and repaint open memory
+// windows with it. Main CPU only, before rendering.
+void update(const ui::window_manager::WindowManager &wm, uint32_t screen_w,
+            uint32_t screen_h);
+
+} // namespace ui::apps::memstats
@@ -9,8 +9,7 @@ namespace ui::apps::textviewer {
 
 struct TextViewerState {
   fs::Ext4 *fs;
-  const char *file_path;
-  char file_path_buf[256];
+  fs::Path file_path;
   char content[8192]; // Static buffer for file content
   uint32_t content_size;
   uint32_t scroll_y;
@@ -19,6 +18,8 @@ struct TextViewerState {
   const char *load_error; // Error message if loading failed
   bool dragging_thumb;
   int32_t drag_offset_y; // distance from thumb top where drag started
+  // Layout worked out by prepare_content on the main CPU, in content
+  // coordinates; drawing and the mouse handler only read it
   bool scrollbar_visible;
   uint32_t scrollbar_x;
   uint32_t scrollbar_y;
@@ -28,11 +29,13 @@ struct TextViewerState {
   uint32_t content_w;
   uint32_t content_h;
   uint32_t visible_lines_cache;
-  uint32_t line_count_cache;
+  uint32_t line_count_cache; // wrapped lines at wrap_cols columns
+  uint32_t wrap_cols;        // 0 until the first prepare
 };
 
 // Create a text viewer window for the specified file
 ui::window::Window create_window(uint32_t screen_w, uint32_t screen_h,
-                                 fs::Ext4 &filesystem, const char *file_path);
+                                 fs::Ext4 &filesystem,
+                                 const fs::Path &file_path);
 
 } // namespace ui::apps::textviewer
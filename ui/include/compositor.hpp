@@ -0,0 +1,192 @@
+#pragma once
+#include "smp.hpp"
+#include "ui.hpp"
+#include <cstdint>
+
+class Graphics;
+
+namespace ui::compositor {
+
+// Counters describing the render loop, updated once per presented frame
+struct FrameStats {
+  uint64_t frames_presented;
+  uint64_t packets_applied;   // input packets folded into presented frames
+  uint32_t frames_per_second; // frames presented during the last full second
+  uint32_t last_latency_us;   // oldest input of the last frame -> present
+  uint32_t max_latency_us;
+  uint32_t avg_latency_us; // running average over frames carrying input
+};
+
+// Paces rendering to at most one frame per refresh interval and measures
+// input-to-photon latency for the input folded into each frame.
+class FramePacer {
+public:
+  explicit FramePacer(uint32_t target_fps = 60);
+
+  // Record an applied input packet; the oldest one since the last present
+  // is used for the latency measurement of the next frame.
+  void note_input(uint64_t timestamp);
+
+  // True once the frame deadline has passed and a new frame may be rendered
+  bool frame_due(uint64_t now) const;
+
+  // Call right after present(); advances the deadline and updates stats
+  void frame_presented(uint64_t now);
+
+  inline const FrameStats &stats() const { return stats_; }
+
+private:
+  uint64_t interval_ticks_;
+  uint64_t next_deadline_;
+  uint64_t oldest_input_;
+  uint32_t pending_packets_;
+  uint64_t second_start_;
+  uint32_t frames_this_second_;
+  uint64_t latency_sum_us_;
+  uint64_t latency_frames_;
+  FrameStats stats_;
+};
+
+// Rendering quality steps, from full quality down. Each step keeps the
+// shortcuts of the ones above it.
+enum class Quality : uint32_t {
+  Full = 0,
+  OutlineDrag = 1,    // a dragged or resized window is drawn as an outline
+  FocusedContent = 2, // only the focused window redraws its content
+  DeferChrome = 3,    // taskbar and clock updates wait until quality returns
+};
+
+const char *quality_name(Quality q);
+
+// Measures each frame's render time against a budget and steps rendering
+// quality down while frames run over, and back up once they fit again.
+// Every step is logged to the serial console.
+class FrameBudget {
+public:
+  explicit FrameBudget(uint32_t budget_us = 16666);
+
+  inline void set_budget_us(uint32_t us) { budget_us_ = us ? us : 1; }
+  inline uint32_t budget_us() const { return budget_us_; }
+
+  // Bracket the drawing work of one frame (not the vblank wait)
+  void frame_begin(uint64_t now);
+  void frame_end(uint64_t now);
+
+  inline Quality quality() const { return quality_; }
+  inline bool at_least(Quality q) const {
+    return static_cast<uint32_t>(quality_) >= static_cast<uint32_t>(q);
+  }
+  inline uint32_t last_frame_us() const { return last_frame_us_; }
+
+  // Over-budget frames in a row before degrading one step; a frame over
+  // twice the budget degrades at once
+  static constexpr uint32_t kDegradeAfter = 3;
+  // Frames in a row under 3/4 of the budget before restoring one step
+  static constexpr uint32_t kRestoreAfter = 60;
+
+private:
+  void step(Quality to, uint32_t frame_us);
+
+  uint32_t budget_us_;
+  Quality quality_;
+  uint64_t frame_start_;
+  uint32_t last_frame_us_;
+  uint32_t over_streak_;
+  uint32_t under_streak_;
+};
+
+// Screen areas waiting to be repainted, fed by ui::invalidate(). A few
+// separate rects are kept so distant updates (a hover row and the taskbar) do
+// not merge into one large repaint; past that, rects are merged with the
+// closest existing one.
+class DamageRegion {
+public:
+  DamageRegion();
+
+  void add(const Rect &r);
+  void add_all();
+  void clear();
+
+  inline bool empty() const { return !full_ && count_ == 0; }
+  // Whole screen damaged
+  inline bool full() const { return full_; }
+  inline uint32_t count() const { return count_; }
+  inline const Rect &rect(uint32_t i) const { return rects_[i]; }
+
+  static constexpr uint32_t kMaxRects = 8;
+
+private:
+  Rect rects_[kMaxRects];
+  uint32_t count_;
+  bool full_;
+};
+
+// Damage accumulated for the next frame, in desktop coordinates
+DamageRegion &damage();
+
+// One display. Outputs tile the desktop; each has its own target (with its
+// own backbuffer) and repaints and presents only the damage that falls on it.
+struct Output {
+  Graphics *gfx;
+  Rect rect; // desktop coordinates
+  DamageRegion damage;
+};
+
+static constexpr uint32_t kMaxOutputs = 4;
+
+// Split desktop damage between the outputs it touches, clipped to each.
+// Whole-desktop damage marks every output fully damaged.
+void route_damage(const DamageRegion &damage, Output *outputs,
+                  uint32_t count);
+
+// Draws everything a repainted area shows from a read-only scene
+// description; gfx is clipped to the area
+using SceneFn = void (*)(Graphics &gfx, const void *scene);
+
+// Repaints the damage routed to each output on all CPUs. Damage is made
+// disjoint and each area is cut into horizontal bands, one per CPU, so every
+// CPU walks contiguous rows and draws a large window once rather than per
+// tile. Each band is drawn through its own clipped copy of the output's
+// target; render() returns after a barrier, once every band is done, so
+// presenting can follow. Bands touch disjoint pixels, but the scene callback
+// must only read shared state: whatever the renderer would update lazily
+// (layer caches, start menu surface, taskbar layout, window content state)
+// has to be prepared before render().
+class TileRenderer {
+public:
+  TileRenderer();
+
+  void render(Output *outputs, uint32_t count, SceneFn scene,
+              const void *scene_ctx);
+
+  inline uint32_t last_tile_count() const { return tile_count_; }
+
+  // Bands thinner than this are not worth a CPU of their own
+  static constexpr uint32_t kMinBandRows = 16;
+  // Disjoint damage areas of all outputs, and one band per CPU in each: no
+  // frame can need more tiles than this
+  static constexpr uint32_t kMaxAreas = kMaxOutputs * DamageRegion::kMaxRects;
+  static constexpr uint32_t kMaxTiles = kMaxAreas * platform::kMaxCpus;
+
+private:
+  struct Tile {
+    Output *output;
+    Rect rect;
+  };
+
+  void add_bands(Output &out, const Rect &r, uint32_t bands);
+  void account(uint64_t now);
+  static void run_tile(uint32_t index, void *self);
+
+  Tile tiles_[kMaxTiles];
+  uint32_t tile_count_;
+  SceneFn scene_;
+  const void *scene_ctx_;
+
+  // Per-CPU busy time since the last imbalance report (once a second)
+  uint64_t busy_ticks_[platform::kMaxCpus];
+  uint32_t frames_;
+  uint64_t window_start_;
+};
+
+} // namespace ui::compositor
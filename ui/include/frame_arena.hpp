@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+
+namespace platform {
+
+// Scratch memory that lives until the end of the current pass of the event
+// loop. Each CPU bumps through its own chunks, so drawing on several CPUs
+// at once needs no locking; frame_reset() rewinds every CPU at once and
+// keeps the chunks for the next pass. Nothing is freed individually.
+
+// bytes aligned to align (a power of two), not zeroed; nullptr when out of
+// memory
+void *frame_alloc(uint64_t bytes, uint64_t align = 16);
+
+template <typename T> inline T *frame_alloc_array(uint64_t count) {
+  return static_cast<T *>(frame_alloc(count * sizeof(T), alignof(T)));
+}
+
+// Release everything handed out since the last reset. Only the event loop
+// calls this, while no other CPU is drawing.
+void frame_reset();
+
+// Most scratch bytes any one CPU has used within a pass since boot
+uint64_t frame_peak_bytes();
+
+} // namespace platform
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "ui.hpp"
+#include "window.hpp"
+#include "window_manager.hpp"
+#include <cstdint>
+
+namespace ui::hit_test {
+
+// Part of a window under a point
+enum class Zone : uint32_t {
+  None = 0,
+  Resize = 1,   // detail: window::ResizeHit mask
+  Button = 2,   // detail: button index (0 close, 1 min, 2 max, 3 pin)
+  Titlebar = 3, // drag area
+  Content = 4,
+  Frame = 5, // inside the window but on no interactive part
+};
+
+struct Hit {
+  window_manager::WindowHandle window;
+  Zone zone;
+  uint32_t detail;
+};
+
+// Per-frame lookup of the topmost window and zone under a point. Rebuilt from
+// the same stacking and layout the renderer used, so hit-testing agrees with
+// what is on screen. The desktop is split into coarse cells that each list the
+// topmost windows overlapping them, making a query independent of how many
+// windows are open. A cell stops taking windows once one covers it whole, as
+// nothing below can be hit there; only a cell crossed by the edges of more
+// than kPerCell windows falls back to a scan.
+class HitMap {
+public:
+  HitMap();
+  ~HitMap();
+  HitMap(const HitMap &) = delete;
+  HitMap &operator=(const HitMap &) = delete;
+
+  // Covers ui::desktop().bounds; frames are laid out on the primary output
+  void rebuild(const window_manager::WindowManager &wm);
+  Hit query(uint32_t x, uint32_t y) const;
+  // Cells whose queries fall back to a scan, for tuning
+  uint32_t overflowed_cells() const;
+
+private:
+  static constexpr uint32_t kCellShift = 5; // 32x32 px cells
+  static constexpr uint32_t kMaxCols = 160; // 5120 px
+  static constexpr uint32_t kMaxRows = 90;  // 2880 px
+  static constexpr uint32_t kPerCell = 8;
+  // Windows past this many are not hit-testable; cells index entries in
+  // 16 bits to keep the grid small
+  static constexpr uint32_t kMaxEntries = 0xFFFF;
+  static constexpr uint8_t kOverflow = 0xFF;
+
+  struct Entry {
+    window_manager::WindowHandle window;
+    window::Layout layout;
+    bool resizable; // resize edges are live
+    bool draggable; // titlebar starts a drag
+  };
+
+  struct Cell {
+    uint16_t entries[kPerCell]; // topmost first
+    uint8_t count;              // kOverflow if more than kPerCell overlap
+    bool covered;               // the last entry covers the whole cell
+  };
+
+  void add(const window_manager::WindowManager &wm,
+           window_manager::WindowHandle h);
+  bool classify(const Entry &e, uint32_t x, uint32_t y, Hit &out) const;
+
+  // Topmost first; grown on the heap to the window count at rebuild
+  Entry *entries_;
+  uint32_t entry_count_;
+  uint32_t entry_capacity_;
+  Cell cells_[kMaxRows][kMaxCols];
+  uint32_t cols_;
+  uint32_t rows_;
+  uint32_t width_; // desktop extent the cells cover
+  uint32_t height_;
+  uint32_t screen_w_;
+  uint32_t screen_h_;
+};
+
+} // namespace ui::hit_test
@@ -0,0 +1,43 @@
+#pragma once
+#include "ui.hpp"
+#include <cstdint>
+
+class Graphics;
+
+namespace ui {
+
+namespace window_manager {
+class WindowManager;
+} // namespace window_manager
+
+namespace layer_cache {
+
+// Pre-rendered pixels of the layers that rarely change: the background of
+// each output and the taskbar band. Repainting a damaged area restores these
+// layers with a blit; they are rendered again only after they change.
+
+// Back the background layer of gfx's output with pixels (at least
+// gfx.get_width() * gfx.get_height()). Returns false if there is no room.
+bool attach_background(const Graphics &gfx, uint32_t *pixels,
+                       uint32_t capacity_pixels);
+
+// Back the taskbar layer with pixels, enough for the band of the primary
+// screen (screen_w * taskbar::height(screen_h))
+void attach_taskbar(uint32_t *pixels, uint32_t capacity_pixels);
+
+// Re-render the background from scratch on next use (e.g. a new wallpaper).
+// The taskbar tracks taskbar::revision() by itself and repaints only the
+// rects taskbar::damage() reports.
+void invalidate_background();
+
+// Re-render every stale surface now, so that draw() only reads them and can
+// run on several CPUs at once
+void prepare(const window_manager::WindowManager &wm);
+
+// Draw a cached layer into gfx, rendering the cache first if stale. Returns
+// false if the layer has no cache for gfx, so the caller draws it directly.
+bool draw(Graphics &gfx, RenderLayer layer,
+          const window_manager::WindowManager &wm);
+
+} // namespace layer_cache
+} // namespace ui
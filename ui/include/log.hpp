@@ -0,0 +1,14 @@
+#pragma once
+#include <cstdint>
+
+namespace platform {
+
+// Debug log on the first serial port (COM1, 115200 8N1). Call log_init() once
+// at boot; before that, or when no port answers, log() does nothing.
+void log_init();
+
+// printf-style logging. Supports %s %c %d %u %x (with l/ll length) and %%.
+// Lines are not terminated implicitly.
+void log(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+} // namespace platform
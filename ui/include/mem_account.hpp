@@ -0,0 +1,72 @@
+#pragma once
+#include <cstdint>
+
+namespace platform {
+
+// Memory accounting. Whoever takes memory from an allocator charges it to a
+// tag and uncharges it when giving it back, so each part of the system shows
+// how much it holds, its peak and how fast it allocates. Charges that pass
+// the memory's address are also recorded for leak checking while that is on,
+// and so is every heap allocation made while an owner is current.
+
+enum class MemTag : uint32_t {
+  Gfx,     // backbuffers, cached layers, wallpaper
+  FsCache, // file data read through the filesystem
+  Ui,      // window slots, per-pass scratch
+  Apps,    // per-window app state
+  Heap,    // heap objects allocated while an owner was current
+  Count
+};
+
+const char *mem_tag_name(MemTag tag);
+
+void mem_charge(MemTag tag, uint64_t bytes, const void *ptr = nullptr);
+void mem_uncharge(MemTag tag, uint64_t bytes, const void *ptr = nullptr);
+
+struct MemTagStats {
+  uint64_t live_bytes;
+  uint64_t peak_bytes;
+  uint64_t charges; // since boot
+  uint64_t uncharges;
+  uint64_t charges_per_sec; // over the last full second
+};
+
+void mem_stats(MemTag tag, MemTagStats &out);
+
+// Log every tag, plus page and heap totals, on the serial port
+void mem_dump();
+
+// Leak checking. A recorded charge belongs to the owner current on the CPU
+// that made it; owners are usually windows. Off by default.
+void mem_set_leak_check(bool enabled);
+
+// A new owner id; 0 means no owner
+uint32_t mem_new_owner();
+uint32_t mem_current_owner();
+// Make owner current on this CPU and return the previous one
+uint32_t mem_swap_owner(uint32_t owner);
+
+// Makes an owner current for the rest of the scope
+class MemOwnerScope {
+public:
+  explicit MemOwnerScope(uint32_t owner) : prev_(mem_swap_owner(owner)) {}
+  ~MemOwnerScope() { mem_swap_owner(prev_); }
+  MemOwnerScope(const MemOwnerScope &) = delete;
+  MemOwnerScope &operator=(const MemOwnerScope &) = delete;
+
+private:
+  uint32_t prev_;
+};
+
+// For the heap: if leak checking is on and an owner is current on this CPU,
+// charge bytes at ptr to MemTag::Heap and record it for that owner. Returns
+// whether it did, so the heap only looks the pointer up again if so.
+bool mem_charge_owned(uint64_t bytes, const void *ptr);
+// Undo mem_charge_owned() for ptr; false if ptr has no such record
+bool mem_uncharge_owned(const void *ptr);
+
+// Log the recorded charges owner still holds, for when it should hold none
+// (its window has closed). Returns how many there were.
+uint32_t mem_report_leaks(uint32_t owner);
+
+} // namespace platform
@@ -0,0 +1,134 @@
+#pragma once
+#include "mem_account.hpp"
+#include <cstdint>
+#include <new>
+
+namespace ui {
+
+// Reference to an object in an ObjectPool. Destroying the object changes its
+// slot's generation, so a handle kept past that resolves to nullptr.
+struct PoolHandle {
+  uint32_t slot;
+  uint32_t generation;
+
+  inline bool operator==(const PoolHandle &o) const {
+    return slot == o.slot && generation == o.generation;
+  }
+  inline bool operator!=(const PoolHandle &o) const { return !(*this == o); }
+};
+
+static constexpr PoolHandle kNoObject{UINT32_MAX, 0};
+
+// Typed pool for per-window app state. Slots live in heap chunks that never
+// move, so pointers stay valid until their object is destroyed; a free list
+// through the slots makes create and destroy O(1). Live objects are charged
+// to the Apps memory tag under their own address, so one a window fails to
+// destroy shows up as a leak when the window closes.
+template <typename T, uint32_t ChunkSize = 8, uint32_t MaxChunks = 32>
+class ObjectPool {
+public:
+  ObjectPool() = default;
+  ~ObjectPool() {
+    for (uint32_t i = 0; i < chunk_count_; ++i) {
+      for (uint32_t j = 0; j < ChunkSize; ++j) {
+        if (chunks_[i][j].live)
+          object(chunks_[i][j])->~T();
+      }
+      delete[] chunks_[i];
+    }
+  }
+  ObjectPool(const ObjectPool &) = delete;
+  ObjectPool &operator=(const ObjectPool &) = delete;
+
+  // A value-initialized object, or kNoObject if the pool cannot grow
+  PoolHandle create() {
+    if (free_head_ == kNil && !grow())
+      return kNoObject;
+    const uint32_t index = free_head_;
+    Slot &s = slot(index);
+    free_head_ = s.next_free;
+    s.live = true;
+    new (s.storage) T();
+    ++live_;
+    platform::mem_charge(platform::MemTag::Apps, sizeof(T), s.storage);
+    return PoolHandle{index, s.generation};
+  }
+
+  void destroy(PoolHandle h) {
+    T *p = get(h);
+    if (p == nullptr)
+      return;
+    Slot &s = slot(h.slot);
+    p->~T();
+    platform::mem_uncharge(platform::MemTag::Apps, sizeof(T), s.storage);
+    s.live = false;
+    ++s.generation;
+    s.next_free = free_head_;
+    free_head_ = h.slot;
+    --live_;
+  }
+
+  T *get(PoolHandle h) {
+    if (h.slot >= chunk_count_ * ChunkSize)
+      return nullptr;
+    Slot &s = slot(h.slot);
+    return s.live && s.generation == h.generation ? object(s) : nullptr;
+  }
+
+  // Handle of a live object from this pool, found from its address
+  PoolHandle handle_of(const T *p) const {
+    if (p == nullptr)
+      return kNoObject;
+    const Slot *s = reinterpret_cast<const Slot *>(p);
+    return s->live ? PoolHandle{s->index, s->generation} : kNoObject;
+  }
+
+  inline uint32_t live() const { return live_; }
+
+private:
+  static constexpr uint32_t kNil = UINT32_MAX;
+
+  // The object's storage comes first, so its address is the slot's
+  struct Slot {
+    alignas(T) unsigned char storage[sizeof(T)];
+    uint32_t index;
+    uint32_t generation;
+    uint32_t next_free;
+    bool live;
+  };
+
+  static inline T *object(Slot &s) {
+    return std::launder(reinterpret_cast<T *>(s.storage));
+  }
+  inline Slot &slot(uint32_t index) {
+    return chunks_[index / ChunkSize][index % ChunkSize];
+  }
+
+  bool grow() {
+    if (chunk_count_ >= MaxChunks)
+      return false;
+    // Chunks outlive the window that made the pool grow
+    platform::MemOwnerScope shared(0);
+    Slot *chunk = new (std::nothrow) Slot[ChunkSize];
+    if (chunk == nullptr)
+      return false;
+    const uint32_t base = chunk_count_ * ChunkSize;
+    chunks_[chunk_count_++] = chunk;
+    for (uint32_t i = ChunkSize; i > 0; --i) {
+      Slot &s = chunk[i - 1];
+      s.index = base + i - 1;
+      s.generation = 1;
+      s.live = false;
+      s.next_free = free_head_;
+      free_head_ = base + i - 1;
+    }
+    return true;
+  }
+
+  Slot *chunks_[MaxChunks] = {};
+  uint32_t chunk_count_ = 0;
+  uint32_t free_head_ = kNil;
+  uint32_t live_ = 0;
+};
+
+} // namespace ui
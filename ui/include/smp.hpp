@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+
+namespace platform {
+
+// Upper bound on CPUs taking part in parallel work
+static constexpr uint32_t kMaxCpus = 16;
+
+// CPUs taking part in parallel_for(); 1 until the application processors have
+// been started
+uint32_t cpu_count();
+
+// Index of the calling CPU in [0, cpu_count()); the boot CPU is 0
+uint32_t current_cpu();
+
+// Run fn(i, ctx) for every i in [0, count), spread over all CPUs. Items are
+// handed out one at a time, so uneven items balance out. The calling CPU
+// takes part and returns once every item has finished. Items must not call
+// parallel_for() themselves.
+void parallel_for(uint32_t count, void (*fn)(uint32_t index, void *ctx),
+                  void *ctx);
+
+// Per-CPU work done by the last parallel_for(), to make load imbalance
+// between CPUs visible
+struct ParallelStats {
+  uint32_t cpus;
+  uint32_t items[kMaxCpus];
+  uint64_t busy_ticks[kMaxCpus]; // timestamp() ticks spent running items
+};
+
+void last_parallel_stats(ParallelStats &out);
+
+// Busy-waiting lock for short critical sections shared between CPUs
+class SpinLock {
+public:
+  inline void lock() {
+    while (__atomic_test_and_set(&locked_, __ATOMIC_ACQUIRE)) {
+      while (__atomic_load_n(&locked_, __ATOMIC_RELAXED)) {
+#if defined(__x86_64__)
+        asm volatile("pause");
+#endif
+      }
+    }
+  }
+  inline bool try_lock() {
+    return !__atomic_test_and_set(&locked_, __ATOMIC_ACQUIRE);
+  }
+  inline void unlock() { __atomic_clear(&locked_, __ATOMIC_RELEASE); }
+
+private:
+  bool locked_ = false;
+};
+
+// Holds a SpinLock for the rest of the scope
+class SpinGuard {
+public:
+  explicit SpinGuard(SpinLock &lock) : lock_(lock) { lock_.lock(); }
+  ~SpinGuard() { lock_.unlock(); }
+  SpinGuard(const SpinGuard &) = delete;
+  SpinGuard &operator=(const SpinGuard &) = delete;
+
+private:
+  SpinLock &lock_;
+};
+
+} // namespace platform
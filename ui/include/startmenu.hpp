@@ -24,21 +24,35 @@ struct State {
   const Item *items;
   uint32_t item_count;
   int32_t hover_index;
+  // Retained rendering: the menu is painted once into an offscreen surface
+  // and only rows whose hover state changed are repainted afterwards
+  bool surface_valid;
+  int32_t painted_hover;
 };
 
 // Initialize default start menu state (position near bottom-left)
 void init(State &st, uint32_t screen_w, uint32_t screen_h, const Item *items,
           uint32_t item_count);
 
-// Draw menu if open
-void draw(Graphics &gfx, const State &st);
+// Draw menu if open by copying its retained surface, first repainting any
+// rows whose hover state changed since the last draw
+void draw(Graphics &gfx, State &st);
+
+// draw() split in two for parallel rendering: prepare() repaints the surface
+// once, then draw_surface() copies it and may run on several CPUs at once
+void prepare(State &st);
+void draw_surface(Graphics &gfx, const State &st);
+
+// Screen rect of item `index`; empty if there is no such visible row
+ui::Rect item_rect(const State &st, int32_t index);
 
 // Returns clicked item id if a menu item is clicked, UINT32_MAX otherwise.
 // Returns 0xFFFFFFFE if click outside should close when open.
 uint32_t hit_test_click(const State &st, uint32_t x, uint32_t y);
 
-// Update hover index based on mouse move
-void update_hover(State &st, uint32_t x, uint32_t y);
+// Update hover index based on mouse move. Returns true if it changed; the
+// caller invalidates item_rect() of the old and new index.
+bool update_hover(State &st, uint32_t x, uint32_t y);
 
 } // namespace startmenu
 } // namespace ui
@@ -6,27 +6,56 @@ class Graphics;
 
 namespace ui {
 
-namespace window {
-struct Window;
-}
+namespace window_manager {
+class WindowManager;
+struct WindowHandle;
+} // namespace window_manager
 
 namespace taskbar {
 
-// Special hit-test code for Start button
-static constexpr uint32_t kHitStart = 0xFFFFFFFEu; // UINT32_MAX - 1 sentinel
-
-struct ButtonInfo {
-  Rect rect;
-  uint32_t window_index;
-};
+// Special hit-test codes for the Start button and window buttons
+static constexpr uint32_t kHitStart = 0xFFFFFFFEu;  // UINT32_MAX - 1 sentinel
+static constexpr uint32_t kHitWindow = 0xFFFFFFFDu; // out_window is filled
 
 uint32_t height(uint32_t screen_h);
+
+// Bring the cached layout up to date with the window manager and invalidate
+// what changed: the whole band after windows were opened, closed or renamed,
+// otherwise just the buttons whose focus or minimize state changed. Call once
+// per event loop iteration.
+void update(const window_manager::WindowManager &wm, uint32_t screen_w,
+            uint32_t screen_h);
+
 void draw(Graphics &gfx, uint32_t screen_w, uint32_t screen_h,
-          const window::Window *windows, uint32_t count);
+          const window_manager::WindowManager &wm);
+
+// Bring the cached layout up to date without invalidating anything, so that
+// draw() only reads shared state and can run on several CPUs at once. A
+// rebuild done here is still announced by the next update().
+void prepare(const window_manager::WindowManager &wm, uint32_t screen_w,
+             uint32_t screen_h);
+
+// Bumped whenever update() or update_clock() finds the taskbar's look
+// changed; a cached rendering of the band is stale once this moves on
+uint32_t revision();
+
+// The rect revision rev invalidated, in the coordinates draw() uses. False
+// if rev is not one of the last few revisions; a cache that far behind
+// renders the whole band again.
+bool damage(uint32_t rev, Rect &out);
+
+// Screen rect of the right-aligned date/time box; empty if it does not fit
+Rect clock_rect(uint32_t screen_w, uint32_t screen_h);
+
+// Invalidate the date/time box when the displayed minute changes. Reads only
+// the software clock, so it is cheap to call every event loop iteration.
+void update_clock(uint32_t screen_w, uint32_t screen_h);
 
-// Returns index of clicked window if a button is clicked, otherwise UINT32_MAX
+// Returns kHitStart, kHitWindow (and the clicked window in out_window) or
+// UINT32_MAX when nothing was hit. Buttons follow window creation order.
 uint32_t hit_test(uint32_t x, uint32_t y, uint32_t screen_w, uint32_t screen_h,
-                  const window::Window *windows, uint32_t count);
+                  const window_manager::WindowManager &wm,
+                  window_manager::WindowHandle &out_window);
 
 } // namespace taskbar
 } // namespace ui
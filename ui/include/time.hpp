@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 
 namespace platform {
 
@@ -16,4 +17,32 @@ struct DateTime {
 // On unsupported platforms, returns false and leaves out.valid = false.
 bool get_current_datetime(DateTime &out);
 
+// Monotonic timestamp counter (TSC on x86_64, generic timer on aarch64).
+// Cheap to read; the tick rate is established by calibrate_timestamp().
+uint64_t timestamp();
+
+// Measure the timestamp tick rate against a fixed reference (PIT on x86_64).
+// Call once at boot before relying on the conversions below.
+void calibrate_timestamp();
+
+// Ticks per second of timestamp(); a conservative default before calibration.
+uint64_t timestamp_frequency();
+
+// Conversions between timestamp ticks and microseconds
+uint64_t ticks_to_us(uint64_t ticks);
+uint64_t us_to_ticks(uint64_t us);
+
+// Wall clock kept in software: clock_init() reads the RTC once and later
+// queries advance that reading by timestamp(), so no CMOS access happens
+// after boot. Call clock_init() after calibrate_timestamp().
+void clock_init();
+
+// Current date/time from the software clock. Returns false (out.valid =
+// false) if the RTC could not be read at boot.
+bool now(DateTime &out);
+
+// Seconds since 1970-01-01 according to the software clock; 0 if unknown.
+// Cheap enough to poll every loop iteration.
+uint64_t clock_seconds();
+
 } // namespace platform
@@ -12,6 +12,30 @@ struct Rect {
   uint32_t h;
 };
 
+// Desktop geometry. Outputs sit side by side on one desktop; the primary one
+// at the origin hosts the taskbar and start menu and is where maximized and
+// fullscreen windows go.
+struct Desktop {
+  Rect primary;
+  Rect bounds; // union of all outputs
+};
+
+void set_desktop(const Desktop &desktop);
+const Desktop &desktop();
+
+namespace window {
+struct Window;
+} // namespace window
+
+// Shortcuts the renderer takes while the compositor is over its frame budget
+struct RenderShortcuts {
+  const window::Window *outline; // drawn as a bare frame outline, or nullptr
+  bool focused_content_only;     // unfocused windows leave content blank
+};
+
+void set_render_shortcuts(const RenderShortcuts &shortcuts);
+const RenderShortcuts &render_shortcuts();
+
 // High-level render layers to control draw order
 enum class RenderLayer : uint32_t {
   Background = 0,        // desktop background
@@ -30,23 +54,39 @@ void draw_desktop(Graphics &gfx);
 // Draw the desktop UI (taskbar + window) at provided window rect.
 void draw_desktop(Graphics &gfx, const Rect &window_rect);
 
+// Request a repaint of a screen-space rect, or of the whole screen. Event
+// handlers call these for what they changed; the event loop repaints only the
+// accumulated damage on its next frame.
+void invalidate(const Rect &r);
+void invalidate_all();
+
 // Query UI metrics and helpers
 uint32_t get_taskbar_height(uint32_t screen_h);
 uint32_t get_titlebar_height();
 bool point_in_titlebar(const Rect &window_rect, uint32_t x, uint32_t y);
 
-namespace window {
-struct Window;
-}
+namespace window_manager {
+class WindowManager;
+struct WindowHandle;
+} // namespace window_manager
+
+// The fullscreen window (the focused one if there are several), or kNoWindow.
+// draw_desktop() shows it alone on the primary output.
+window_manager::WindowHandle
+fullscreen_window(const window_manager::WindowManager &wm);
 
 // Draw desktop with multiple windows; draws taskbar and all non-minimized
-// windows in order
-void draw_desktop(Graphics &gfx, const window::Window *windows, uint32_t count);
+// windows in stacking order
+void draw_desktop(Graphics &gfx, const window_manager::WindowManager &wm);
 
 // Layered renderer: draw a specific layer only. Callers can iterate layers
 // from Background to Overlay to produce the full scene, or render selectively.
 void draw_desktop_layer(Graphics &gfx, RenderLayer layer,
-                        const window::Window *windows, uint32_t count);
+                        const window_manager::WindowManager &wm);
+
+// Run prepare_content of every window that is shown, on the main CPU before
+// the scene is rendered
+void prepare_windows(const window_manager::WindowManager &wm);
 
 // Region rendering removed due to border artifacts.
 
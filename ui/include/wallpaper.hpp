@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+
+class Graphics;
+
+namespace ui::wallpaper {
+
+// Desktop background image. The image is kept at its own size and scaled to
+// each output when the background layer cache renders, so it is resampled
+// once per load or mode change and damaged areas are restored by blitting the
+// cached surface.
+
+// Image loaded from the root filesystem at boot, if present
+inline constexpr const char *kDefaultPath = "/wallpaper.bmp";
+
+// Use w*h 0x00RRGGBB pixels as the wallpaper (the caller keeps them alive),
+// or nullptr for the plain background color. Images over 32767 pixels on
+// a side are refused. Invalidates the background.
+void set(const uint32_t *pixels, uint32_t w, uint32_t h);
+
+// Fill gfx's whole target with the wallpaper, scaled to cover it (keeping the
+// aspect ratio, centered and cropped): averaged over each pixel's footprint
+// when shrinking, bilinear otherwise. Only the part inside the clip rect is
+// resampled. Returns false if there is no wallpaper.
+bool draw(Graphics &gfx);
+
+} // namespace ui::wallpaper
@@ -16,8 +16,16 @@ struct MouseEvent {
   bool right;
   bool middle;
   int8_t wheel_y; // positive for wheel up, negative for wheel down
+  // Content rect in screen coordinates, for invalidating what changed
+  Rect content;
 };
 
+// Request a repaint of `local` (content coordinates of `ev`), clipped to the
+// content rect. Handlers call this instead of relying on a full redraw.
+void invalidate_content(const MouseEvent &ev, const Rect &local);
+// Request a repaint of the whole content area of the window under `ev`
+void invalidate_content(const MouseEvent &ev);
+
 struct Window {
   Rect rect;
   const char *title;
@@ -34,13 +42,41 @@ struct Window {
   // drawn.
   void (*draw_content)(Graphics &gfx, const Rect &content_rect,
                        void *user_data);
+  // Optional, called on the main CPU before each frame is rendered with the
+  // content rect draw_content will get. Whatever drawing derives from the
+  // app state (layout, scroll limits, listings) is worked out here, so
+  // draw_content only reads user_data and can run on several CPUs at once.
+  void (*prepare_content)(const Rect &content_rect, void *user_data);
   // Optional mouse event handler for content area. Coordinates are relative to
   // content_rect origin (passed above to draw_content).
   void (*on_mouse)(const MouseEvent &ev, void *user_data);
+  // Optional, called once the window has been closed so the app can release
+  // the state behind user_data
+  void (*on_close)(void *user_data);
   void *user_data;
+  // Memory accounting owner of what the app holds for this window (see
+  // platform::MemOwnerScope); set by WindowManager::open(), 0 for none
+  uint32_t mem_owner;
+};
+
+// Geometry of a window as laid out by draw(). Drawing and hit-testing both
+// derive their rectangles from this so they cannot drift apart.
+struct Layout {
+  Rect frame;      // effective outer rect (fullscreen/maximized applied)
+  Rect titlebar;   // drag area: titlebar minus the left button cluster
+  Rect buttons[4]; // close, minimize, maximize, pin; w == 0 when absent
+  Rect content;    // content area passed to draw_content
+  uint32_t title_x;
 };
 
 uint32_t get_titlebar_height();
+
+// Effective outer rect of a window on a screen of the given size.
+Rect get_frame_rect(const Window &w, uint32_t screen_w, uint32_t screen_h);
+
+// Lay out a window whose outer rect is `frame`.
+Layout compute_layout(const Window &w, const Rect &frame);
+
 bool point_in_titlebar(const Window &w, uint32_t x, uint32_t y);
 void draw(Graphics &gfx, const Window &w);
 void draw_frame_only(Graphics &gfx, const Window &w);
@@ -63,6 +99,9 @@ enum ResizeHit : uint32_t {
 // flags)
 uint32_t hit_test_resize(const Window &w, uint32_t x, uint32_t y);
 
+// Resize edges of `frame` under (x, y), ignoring window state.
+uint32_t resize_edges(const Rect &frame, uint32_t x, uint32_t y);
+
 // Compute the content rect for a window as drawn by draw(), taking into
 // account fullscreen/maximized states and taskbar height. screen_w/h are the
 // framebuffer dimensions used for layout.
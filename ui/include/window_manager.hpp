@@ -25,7 +25,10 @@ struct WindowOptions {
   void *user_data = nullptr;
   void (*draw_content)(Graphics &gfx, const Rect &content_rect,
                        void *user_data) = nullptr;
+  void (*prepare_content)(const Rect &content_rect,
+                          void *user_data) = nullptr;
   void (*on_mouse)(const window::MouseEvent &ev, void *user_data) = nullptr;
+  void (*on_close)(void *user_data) = nullptr;
 };
 
 // Create a window with default positioning (centered)
@@ -59,4 +62,109 @@ uint32_t center_y(uint32_t screen_h, uint32_t window_h);
 bool ensure_window_fits(uint32_t &x, uint32_t &y, uint32_t w, uint32_t h,
                         uint32_t screen_w, uint32_t screen_h);
 
+// Stable reference to a window owned by a WindowManager. A handle stays valid
+// while other windows are opened, raised or closed; once its own window is
+// closed the slot generation changes and the handle goes stale.
+struct WindowHandle {
+  uint32_t slot;
+  uint32_t generation;
+
+  inline bool operator==(const WindowHandle &o) const {
+    return slot == o.slot && generation == o.generation;
+  }
+  inline bool operator!=(const WindowHandle &o) const { return !(*this == o); }
+};
+
+static constexpr WindowHandle kNoWindow{UINT32_MAX, 0};
+
+// Owns all open windows. Windows live in a chunked slot pool so their
+// addresses and handles never move; stacking order is an intrusive doubly
+// linked list through the slots, so raise, focus and close are O(1).
+// A second list keeps creation order for the taskbar.
+class WindowManager {
+public:
+  WindowManager();
+  ~WindowManager();
+  WindowManager(const WindowManager &) = delete;
+  WindowManager &operator=(const WindowManager &) = delete;
+
+  // Open a window on top of the stack and give it focus. Returns kNoWindow
+  // only if the heap has no room for more slots, after calling the window's
+  // on_close so its state is not leaked.
+  WindowHandle open(const window::Window &w);
+  // Release the slot, then call the window's on_close
+  void close(WindowHandle h);
+
+  // Move to the top of the stacking order
+  void raise(WindowHandle h);
+  // Raise and make it the only focused window
+  void focus(WindowHandle h);
+  void clear_focus();
+  // Rename a window; counts as a change for version()
+  void set_title(WindowHandle h, const char *title);
+
+  bool valid(WindowHandle h) const;
+  window::Window *get(WindowHandle h);
+  const window::Window *get(WindowHandle h) const;
+
+  // Geometry to restore when leaving the maximized state
+  void save_restore_rect(WindowHandle h, const Rect &r);
+  bool take_restore_rect(WindowHandle h, Rect &out);
+
+  // Stacking order traversal (bottom is drawn first)
+  WindowHandle bottom() const;
+  WindowHandle top() const;
+  WindowHandle above(WindowHandle h) const;
+  WindowHandle below(WindowHandle h) const;
+
+  // Creation order traversal (stable across raise/focus)
+  WindowHandle first() const;
+  WindowHandle next(WindowHandle h) const;
+
+  inline WindowHandle focused() const { return handle_of(focused_); }
+  inline uint32_t count() const { return count_; }
+  inline uint32_t capacity() const { return chunk_count_ * kChunkSize; }
+  // Bumped whenever a window is opened, closed or renamed, so views that
+  // depend on the window set (the taskbar) know when to rebuild
+  inline uint32_t version() const { return version_; }
+
+  static constexpr uint32_t kChunkSize = 32;
+
+private:
+  static constexpr uint32_t kNil = UINT32_MAX;
+
+  struct Slot {
+    window::Window window;
+    Rect restore_rect;
+    bool restore_valid;
+    bool in_use;
+    uint32_t generation;
+    // Stacking list, bottom -> top; z_next doubles as the free-list link
+    uint32_t z_prev;
+    uint32_t z_next;
+    // Creation order list
+    uint32_t order_prev;
+    uint32_t order_next;
+  };
+
+  Slot *slot(uint32_t index) const;
+  WindowHandle handle_of(uint32_t index) const;
+  uint32_t index_of(WindowHandle h) const;
+  bool grow();
+  void unlink_z(uint32_t index);
+  void link_z_top(uint32_t index);
+
+  Slot **chunks_; // table of chunk pointers, doubled when full
+  uint32_t chunk_count_;
+  uint32_t chunk_capacity_;
+  uint32_t free_head_;
+  uint32_t z_bottom_;
+  uint32_t z_top_;
+  uint32_t order_first_;
+  uint32_t order_last_;
+  uint32_t focused_;
+  uint32_t count_;
+  uint32_t version_;
+};
+
 } // namespace ui::window_manager
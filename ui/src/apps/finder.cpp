@@ -1,11 +1,41 @@
 #include "apps/finder.hpp"
 #include "../../include/window.hpp"
 #include "font.hpp"
+#include "frame_arena.hpp"
 #include "graphics.hpp"
+#include "object_pool.hpp"
 #include "window_manager.hpp"
 
 namespace ui::apps::finder {
 
+// Layout shared by draw() and on_mouse(): a header, then fixed-height rows
+static constexpr uint32_t kHeaderH = 24;
+static constexpr uint32_t kRowH = 20;
+static constexpr uint32_t kGhostW = 80;
+static constexpr uint32_t kGhostH = 16;
+
+// Drag ghost in content coordinates. It is kept inside the content area so a
+// repaint of the content always covers it.
+static ui::Rect ghost_rect(uint32_t mx, uint32_t my, uint32_t cw, uint32_t ch) {
+  uint32_t gx = mx + 6;
+  uint32_t gy = my + 6;
+  if (cw >= kGhostW && gx > cw - kGhostW)
+    gx = cw - kGhostW;
+  if (ch >= kGhostH && gy > ch - kGhostH)
+    gy = ch - kGhostH;
+  return ui::Rect{gx, gy, kGhostW, kGhostH};
+}
+
+// Repaint the row showing entry `index`, if it is scrolled into view
+static void invalidate_row(const FinderState *st,
+                           const ui::window::MouseEvent &ev, int32_t index) {
+  if (index < 0 || static_cast<uint32_t>(index) < st->scroll_offset)
+    return;
+  const uint32_t row = static_cast<uint32_t>(index) - st->scroll_offset;
+  ui::window::invalidate_content(
+      ev, ui::Rect{0, kHeaderH + row * kRowH, ev.content.w, kRowH});
+}
+
 static inline bool is_dot_or_dotdot(const char *name) {
   if (!name)
     return false;
@@ -18,31 +48,49 @@ static inline bool is_dot_or_dotdot(const char *name) {
   return false;
 }
 
-static void draw(Graphics &gfx, const ui::Rect &r, void *ud) {
+// Entries of the current directory without "." and "..", in frame scratch.
+// A listing that fills its array is retried with twice the room.
+static fs::Dirent *list_visible(const FinderState *st, uint32_t &count) {
+  static constexpr uint32_t kMaxEntries = 65536;
+  count = 0;
+  for (uint32_t cap = 256;; cap *= 2) {
+    fs::Dirent *ents = platform::frame_alloc_array<fs::Dirent>(cap);
+    uint32_t cnt = 0;
+    if (ents == nullptr || !st->fs->list_dir_by_path(st->cwd, ents, cap, cnt))
+      return nullptr;
+    if (cnt == cap && cap < kMaxEntries)
+      continue;
+    for (uint32_t i = 0; i < cnt; ++i) {
+      if (!is_dot_or_dotdot(ents[i].name))
+        ents[count++] = ents[i];
+    }
+    return ents;
+  }
+}
+
+// List the directory once per frame rather than once per band drawing it
+static void prepare(const ui::Rect &r, void *ud) {
   FinderState *st = static_cast<FinderState *>(ud);
   if (!st || !st->fs)
     return;
-  fs::Dirent ents[256];
-  uint32_t cnt = 0;
-  const char *path = st->cwd ? st->cwd : "/";
-  if (!st->fs->list_dir_by_path(path, ents, 256, cnt))
+  st->listing = list_visible(st, st->listing_count);
+  st->view_rows = r.h > kHeaderH ? (r.h - kHeaderH) / kRowH : 0;
+}
+
+static void draw(Graphics &gfx, const ui::Rect &r, void *ud) {
+  const FinderState *st = static_cast<const FinderState *>(ud);
+  if (!st || st->listing == nullptr)
     return;
-  // Build filtered list excluding "." and ".."
-  fs::Dirent vis[256];
-  uint32_t vcnt = 0;
-  for (uint32_t i = 0; i < cnt && vcnt < 256; ++i) {
-    if (is_dot_or_dotdot(ents[i].name))
-      continue;
-    vis[vcnt++] = ents[i];
-  }
-  const uint32_t row_h = 20;
+  const fs::Dirent *vis = st->listing;
+  const uint32_t vcnt = st->listing_count;
+  const uint32_t row_h = kRowH;
   const uint32_t icon_w = 10;
   uint32_t y = r.y;
   // Header with current path and a simple back button on the left
   gfx.fill_rect(r.x, y, 18, 18, 0x444444);
   gfx.draw_string("<", r.x + 4, y, 0xFFFFFF, default_font);
-  gfx.draw_string(st->cwd ? st->cwd : "/", r.x + 24, y, 0xAAAAFF, default_font);
-  y += 24;
+  gfx.draw_string(st->cwd.c_str(), r.x + 24, y, 0xAAAAFF, default_font);
+  y += kHeaderH;
   for (uint32_t i = 0; i < vcnt; ++i) {
     // apply scroll offset
     if (i < st->scroll_offset)
@@ -67,71 +115,29 @@ static void draw(Graphics &gfx, const ui::Rect &r, void *ud) {
     y += row_h;
   }
 
-  // cache how many rows fit for scroll handling
-  st->last_view_rows = (r.h - 24) / row_h;
-
   // Drag ghost
   if (st->dragging && st->drag_index >= 0) {
-    uint32_t gx = r.x + st->last_mouse_x + 6;
-    uint32_t gy = r.y + st->last_mouse_y + 6;
-    gfx.draw_rect(gx, gy, 80, 16, 0xAAAAAA);
+    const ui::Rect g = ghost_rect(st->last_mouse_x, st->last_mouse_y, r.w, r.h);
+    gfx.draw_rect(r.x + g.x, r.y + g.y, g.w, g.h, 0xAAAAAA);
   }
 }
 
-static void open_selected(FinderState *st) {
+// Returns true if the listing changed (entered a directory)
+static bool open_selected(FinderState *st) {
   if (!st || !st->fs)
-    return;
-  fs::Dirent ents[256];
-  uint32_t cnt = 0;
-  if (!st->fs->list_dir_by_path(st->cwd ? st->cwd : "/", ents, 256, cnt))
-    return;
-  // Build filtered list excluding "." and ".."
-  fs::Dirent vis[256];
+    return false;
   uint32_t vcnt = 0;
-  for (uint32_t i = 0; i < cnt && vcnt < 256; ++i) {
-    if (is_dot_or_dotdot(ents[i].name))
-      continue;
-    vis[vcnt++] = ents[i];
-  }
-  if (st->selected_index < 0 ||
+  const fs::Dirent *vis = list_visible(st, vcnt);
+  if (vis == nullptr || st->selected_index < 0 ||
       static_cast<uint32_t>(st->selected_index) >= vcnt)
-    return;
+    return false;
   const fs::Dirent &e = vis[st->selected_index];
   if (e.type == fs::NodeType::Directory) {
-    // Append name to cwd
-    char new_path[256];
-    uint32_t n = 0;
-    const char *cwd = st->cwd ? st->cwd : "/";
-    if (cwd[0] != '/' || cwd[1] != '\0') {
-      // non-root
-      for (; cwd[n] && n < sizeof(new_path) - 1; ++n)
-        new_path[n] = cwd[n];
-      if (n < sizeof(new_path) - 1 && new_path[n - 1] != '/')
-        new_path[n++] = '/';
-    } else {
-      new_path[n++] = '/';
-    }
-    // copy entry name
-    for (uint32_t i = 0; e.name[i] && n < sizeof(new_path) - 1; ++i)
-      new_path[n++] = e.name[i];
-    new_path[n] = '\0';
-    // save history
-    if (st->history_len < 16) {
-      uint32_t idx = st->history_len++;
-      // copy old cwd
-      uint32_t j = 0;
-      const char *oc = st->cwd ? st->cwd : "/";
-      for (; oc[j] && j < sizeof(st->history[0]) - 1; ++j)
-        st->history[idx][j] = oc[j];
-      st->history[idx][j] = '\0';
-    }
-    // update cwd
-    uint32_t m = 0;
-    for (; new_path[m] && m < sizeof(st->cwd_buf) - 1; ++m)
-      st->cwd_buf[m] = new_path[m];
-    st->cwd_buf[m] = '\0';
-    st->cwd = st->cwd_buf;
+    // Enter it; a name that does not fit leaves the listing as it is
+    if (!st->cwd.append(e.name, e.name_len))
+      return false;
     st->selected_index = -1;
+    return true;
   } else if (e.type == fs::NodeType::File) {
     // Handle file opening - check file extension
     bool is_text_file = false;
@@ -159,79 +165,57 @@ static void open_selected(FinderState *st) {
     }
 
     if (is_text_file) {
-      // Build full file path
-      char file_path[256];
-      uint32_t n = 0;
-      const char *cwd = st->cwd ? st->cwd : "/";
-      if (cwd[0] != '/' || cwd[1] != '\0') {
-        // non-root
-        for (; cwd[n] && n < sizeof(file_path) - 1; ++n)
-          file_path[n] = cwd[n];
-        if (n < sizeof(file_path) - 1 && file_path[n - 1] != '/')
-          file_path[n++] = '/';
-      } else {
-        file_path[n++] = '/';
-      }
-      // copy entry name
-      for (uint32_t i = 0; e.name[i] && n < sizeof(file_path) - 1; ++i)
-        file_path[n++] = e.name[i];
-      file_path[n] = '\0';
-
-      // Store the file path for the text viewer to use
-      // This will be handled by the main loop when it detects a text file open
-      // request
-      uint32_t path_len = 0;
-      for (; file_path[path_len] && path_len < sizeof(st->file_to_open) - 1;
-           ++path_len) {
-        st->file_to_open[path_len] = file_path[path_len];
-      }
-      st->file_to_open[path_len] = '\0';
+      // Hand the full path to the main loop, which opens a text viewer
+      st->file_to_open = st->cwd;
+      if (!st->file_to_open.append(e.name, e.name_len))
+        return false;
       st->should_open_file = true;
     }
   }
+  return false;
 }
 
-static void go_back(FinderState *st) {
-  if (!st)
-    return;
-  if (st->history_len == 0)
-    return;
-  // pop
-  uint32_t idx = st->history_len - 1;
-  // copy back into cwd_buf
-  uint32_t i = 0;
-  for (; st->history[idx][i] && i < sizeof(st->cwd_buf) - 1; ++i)
-    st->cwd_buf[i] = st->history[idx][i];
-  st->cwd_buf[i] = '\0';
-  st->cwd = st->cwd_buf;
-  st->history_len--;
+// Returns true if there was a parent directory to return to
+static bool go_back(FinderState *st) {
+  if (!st || !st->cwd.parent())
+    return false;
   st->selected_index = -1;
+  return true;
 }
 
 static void on_mouse(const ui::window::MouseEvent &ev, void *ud) {
   FinderState *st = static_cast<FinderState *>(ud);
   if (!st || !st->fs)
     return;
+  const uint32_t prev_mouse_x = st->last_mouse_x;
+  const uint32_t prev_mouse_y = st->last_mouse_y;
   st->last_mouse_x = ev.x;
   st->last_mouse_y = ev.y;
-  // Layout must match draw(): header 24px, then rows of 20px
+  // Only what changed is invalidated: hover and selection rows, the drag
+  // ghost, or the whole listing when the directory or scroll changes.
   if (ev.type == ui::window::MouseEvent::Type::Down && ev.left) {
     // Back button hit test: right-top corner 18x18 square
     // Assume content rect width is unknown here; approximate by x > width-22 is
     // not available. Instead, use fixed area near left for simplicity: '<'
     // button at x in [0,18], y in [0,18]
     if (ev.x <= 18 && ev.y <= 18) {
-      go_back(st);
+      if (go_back(st))
+        ui::window::invalidate_content(ev);
       return;
     }
     // Select row
-    if (ev.y >= 24) {
-      uint32_t row = (ev.y - 24) / 20;
+    if (ev.y >= kHeaderH) {
+      uint32_t row = (ev.y - kHeaderH) / kRowH;
+      const int32_t prev_selected = st->selected_index;
       st->selected_index = static_cast<int32_t>(row + st->scroll_offset);
       st->drag_index = st->selected_index;
       st->dragging = false;
       st->press_x = ev.x;
       st->press_y = ev.y;
+      if (st->selected_index != prev_selected) {
+        invalidate_row(st, ev, prev_selected);
+        invalidate_row(st, ev, st->selected_index);
+      }
     }
   } else if (ev.type == ui::window::MouseEvent::Type::Up) {
     // If it was a simple click (no movement), open
@@ -241,17 +225,29 @@ static void on_mouse(const ui::window::MouseEvent &ev, void *ud) {
         (ev.y > st->press_y) ? (ev.y - st->press_y) : (st->press_y - ev.y);
     bool was_dragging = st->dragging;
     st->dragging = false;
+    if (was_dragging && st->drag_index >= 0) {
+      ui::window::invalidate_content(
+          ev, ghost_rect(prev_mouse_x, prev_mouse_y, ev.content.w,
+                         ev.content.h));
+    }
     if (!was_dragging && dx < 3 && dy < 3) {
-      open_selected(st);
+      if (open_selected(st))
+        ui::window::invalidate_content(ev);
     }
   } else if (ev.type == ui::window::MouseEvent::Type::Move) {
     // Could draw a drag ghost in draw() based on st->dragging and last mouse
-    if (ev.y >= 24) {
-      uint32_t row = (ev.y - 24) / 20;
+    const int32_t prev_hover = st->hover_index;
+    const bool was_dragging = st->dragging;
+    if (ev.y >= kHeaderH) {
+      uint32_t row = (ev.y - kHeaderH) / kRowH;
       st->hover_index = static_cast<int32_t>(row + st->scroll_offset);
     } else {
       st->hover_index = -1;
     }
+    if (st->hover_index != prev_hover) {
+      invalidate_row(st, ev, prev_hover);
+      invalidate_row(st, ev, st->hover_index);
+    }
     if (st->selected_index >= 0 && ev.left && !st->dragging) {
       uint32_t dx =
           (ev.x > st->press_x) ? (ev.x - st->press_x) : (st->press_x - ev.x);
@@ -260,6 +256,15 @@ static void on_mouse(const ui::window::MouseEvent &ev, void *ud) {
       if (dx >= 3 || dy >= 3)
         st->dragging = true;
     }
+    if (st->dragging && st->drag_index >= 0) {
+      if (was_dragging) {
+        ui::window::invalidate_content(
+            ev, ghost_rect(prev_mouse_x, prev_mouse_y, ev.content.w,
+                           ev.content.h));
+      }
+      ui::window::invalidate_content(
+          ev, ghost_rect(ev.x, ev.y, ev.content.w, ev.content.h));
+    }
   } else if (ev.type == ui::window::MouseEvent::Type::Wheel) {
     // Positive wheel_y scrolls up
     int32_t so = static_cast<int32_t>(st->scroll_offset);
@@ -267,43 +272,42 @@ static void on_mouse(const ui::window::MouseEvent &ev, void *ud) {
     if (so < 0)
       so = 0;
     // compute max
-    fs::Dirent ents[256];
-    uint32_t cnt = 0;
-    const char *path = st->cwd ? st->cwd : "/";
-    if (st->fs->list_dir_by_path(path, ents, 256, cnt)) {
-      uint32_t vcnt = 0;
-      for (uint32_t i = 0; i < cnt && vcnt < 256; ++i)
-        if (!is_dot_or_dotdot(ents[i].name))
-          vcnt++;
-      uint32_t rows = st->last_view_rows ? st->last_view_rows : 10u;
+    uint32_t vcnt = 0;
+    if (list_visible(st, vcnt) != nullptr) {
+      uint32_t rows = st->view_rows ? st->view_rows : 10u;
       uint32_t max_off = (vcnt > rows) ? (vcnt - rows) : 0;
       if (static_cast<uint32_t>(so) > max_off)
         so = static_cast<int32_t>(max_off);
     }
-    st->scroll_offset = static_cast<uint32_t>(so);
+    if (static_cast<uint32_t>(so) != st->scroll_offset) {
+      st->scroll_offset = static_cast<uint32_t>(so);
+      ui::window::invalidate_content(ev);
+    }
   }
 }
 
+// Every Finder window owns one state from the pool until it is closed
+static ui::ObjectPool<FinderState> s_states;
+
+static void on_close(void *ud) {
+  s_states.destroy(s_states.handle_of(static_cast<FinderState *>(ud)));
+}
+
+FinderState *state_of(const ui::window::Window &w) {
+  return w.on_close == &on_close ? static_cast<FinderState *>(w.user_data)
+                                 : nullptr;
+}
+
 ui::window::Window create_window(uint32_t screen_w, uint32_t screen_h,
                                  fs::Ext4 &filesystem) {
-  static FinderState s_state{}; // simple static for now
-  s_state.fs = &filesystem;
-  s_state.cwd_buf[0] = '/';
-  s_state.cwd_buf[1] = '\0';
-  s_state.cwd = s_state.cwd_buf;
-  s_state.history_len = 0;
-  s_state.selected_index = -1;
-  s_state.hover_index = -1;
-  s_state.dragging = false;
-  s_state.drag_index = -1;
-  s_state.last_mouse_x = 0;
-  s_state.last_mouse_y = 0;
-  s_state.press_x = 0;
-  s_state.press_y = 0;
-  s_state.file_to_open[0] = '\0';
-  s_state.should_open_file = false;
-  s_state.scroll_offset = 0;
-  s_state.last_view_rows = 0;
+  // A new state starts zeroed; without one the window stays empty
+  FinderState *st = s_states.get(s_states.create());
+  if (st) {
+    st->fs = &filesystem; // cwd starts at the root
+    st->selected_index = -1;
+    st->hover_index = -1;
+    st->drag_index = -1;
+  }
 
   ui::window_manager::WindowOptions options;
   options.title = "Finder";
@@ -311,9 +315,11 @@ ui::window::Window create_window(uint32_t screen_w, uint32_t screen_h,
   options.height = screen_h / 2;
   options.x = 40; // Fixed position
   options.y = 40;
-  options.user_data = &s_state;
+  options.user_data = st;
   options.draw_content = &draw;
+  options.prepare_content = &prepare;
   options.on_mouse = &on_mouse;
+  options.on_close = &on_close;
 
   return ui::window_manager::create_window(screen_w, screen_h, options);
 }
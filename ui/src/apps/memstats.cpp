@@ -0,0 +1,87 @@
+#include "apps/memstats.hpp"
+#include "font.hpp"
+#include "graphics.hpp"
+#include "mem_account.hpp"
+#include "time.hpp"
+
+namespace ui::apps::memstats {
+
+static constexpr uint32_t kLineHeight = 14;
+// Column offsets in characters: tag, live KiB, peak KiB, charges per second
+static constexpr uint32_t kColumns[4] = {0, 9, 19, 29};
+static constexpr uint32_t kTags =
+    static_cast<uint32_t>(platform::MemTag::Count);
+
+// Taken by update() on the main CPU. mem_stats() locks and rolls the rates,
+// so bands drawing in parallel read this instead, and all show one moment.
+static platform::MemTagStats s_snapshot[kTags];
+
+// Decimal digits of v into buf (at least 21 bytes)
+static const char *to_decimal(uint64_t v, char *buf) {
+  char *p = buf + 20;
+  *p = '\0';
+  do {
+    *--p = static_cast<char>('0' + v % 10);
+    v /= 10;
+  } while (v != 0);
+  return p;
+}
+
+static void draw(Graphics &gfx, const ui::Rect &r, void * /*ud*/) {
+  const uint32_t cw = default_font.char_width;
+  const char *const headings[4] = {"tag", "live KiB", "peak KiB", "per sec"};
+  for (uint32_t c = 0; c < 4; ++c)
+    gfx.draw_string(headings[c], r.x + kColumns[c] * cw, r.y, 0xCCCCCC,
+                    default_font);
+  char buf[21];
+  for (uint32_t i = 0; i < kTags; ++i) {
+    const auto tag = static_cast<platform::MemTag>(i);
+    const platform::MemTagStats &s = s_snapshot[i];
+    const uint32_t y = r.y + (i + 1) * kLineHeight;
+    gfx.draw_string(platform::mem_tag_name(tag), r.x, y, 0xFFFFFF,
+                    default_font);
+    gfx.draw_string(to_decimal(s.live_bytes >> 10, buf),
+                    r.x + kColumns[1] * cw, y, 0xFFFFFF, default_font);
+    gfx.draw_string(to_decimal(s.peak_bytes >> 10, buf),
+                    r.x + kColumns[2] * cw, y, 0xFFFFFF, default_font);
+    gfx.draw_string(to_decimal(s.charges_per_sec, buf),
+                    r.x + kColumns[3] * cw, y, 0xFFFFFF, default_font);
+  }
+  gfx.draw_string("Click to dump to serial", r.x,
+                  r.y + (kTags + 2) * kLineHeight, 0x888888, default_font);
+}
+
+static void on_mouse(const ui::window::MouseEvent &ev, void * /*ud*/) {
+  if (ev.type == ui::window::MouseEvent::Type::Down && ev.left)
+    platform::mem_dump();
+}
+
+ui::window::Window create_window(uint32_t screen_w, uint32_t screen_h) {
+  ui::window_manager::WindowOptions options;
+  options.title = "Memory";
+  options.width = 320;
+  options.height = 150;
+  options.draw_content = &draw;
+  options.on_mouse = &on_mouse;
+  return ui::window_manager::create_window(screen_w, screen_h, options);
+}
+
+void update(const ui::window_manager::WindowManager &wm, uint32_t screen_w,
+            uint32_t screen_h) {
+  static uint64_t s_second = 0;
+  const uint64_t second =
+      platform::timestamp() / platform::timestamp_frequency();
+  if (second == s_second)
+    return;
+  s_second = second;
+  for (uint32_t i = 0; i < kTags; ++i)
+    platform::mem_stats(static_cast<platform::MemTag>(i), s_snapshot[i]);
+  for (ui::window_manager::WindowHandle h = wm.first();
+       h != ui::window_manager::kNoWindow; h = wm.next(h)) {
+    const ui::window::Window &w = *wm.get(h);
+    if (w.draw_content == &draw && !w.minimized)
+      ui::invalidate(ui::window::get_content_rect(w, screen_w, screen_h));
+  }
+}
+
+} // namespace ui::apps::memstats
@@ -1,6 +1,8 @@
 #include "apps/textviewer.hpp"
 #include "font.hpp"
+#include "frame_arena.hpp"
 #include "graphics.hpp"
+#include "object_pool.hpp"
 #include "window_manager.hpp"
 
 namespace ui::apps::textviewer {
@@ -13,8 +15,81 @@ static constexpr uint32_t kLineHeight = 16;
 static constexpr uint32_t kScrollbarWidth = 12;
 static constexpr uint32_t kPadding = 8;
 
-static void draw(Graphics &gfx, const ui::Rect &r, void *ud) {
+// Wrapped lines of the content at max_cols characters per line; an empty
+// line still takes one
+static uint32_t count_lines(const TextViewerState *st, uint32_t max_cols) {
+  uint32_t line_count = 0;
+  uint32_t i = 0;
+  while (i < st->content_size) {
+    uint32_t start = i;
+    while (i < st->content_size && st->content[i] != '\n') {
+      i++;
+    }
+    uint32_t raw_len = i - start;
+    line_count += (raw_len == 0) ? 1 : ((raw_len + max_cols - 1) / max_cols);
+    // Skip the newline character if present
+    if (i < st->content_size && st->content[i] == '\n') {
+      i++;
+    }
+  }
+  return line_count;
+}
+
+// Work out the wrap width, scroll limit and scrollbar geometry (in content
+// coordinates) for the content rect, on the main CPU before the frame is
+// drawn. The wrapped line count is kept until the width changes.
+static void prepare(const ui::Rect &r, void *ud) {
   auto *st = static_cast<TextViewerState *>(ud);
+  if (!st)
+    return;
+  st->scrollbar_visible = false;
+  if (!st->content_loaded || st->content_size == 0)
+    return;
+
+  // Text area: padding all round and room for the scrollbar on the right
+  const uint32_t pad = kPadding * 2;
+  uint32_t text_area_w =
+      r.w > pad + kScrollbarWidth ? r.w - pad - kScrollbarWidth : 0;
+  if (text_area_w < default_font.char_width) {
+    text_area_w = default_font.char_width;
+  }
+  st->content_w = text_area_w;
+  st->content_h = r.h > pad ? r.h - pad : 0;
+  uint32_t max_cols = text_area_w / default_font.char_width;
+  if (max_cols == 0)
+    max_cols = 1;
+  if (max_cols != st->wrap_cols) {
+    st->line_count_cache = count_lines(st, max_cols);
+    st->wrap_cols = max_cols;
+  }
+  const uint32_t line_count = st->line_count_cache;
+  const uint32_t visible_lines = st->content_h / kLineHeight;
+  st->visible_lines_cache = visible_lines;
+
+  st->max_scroll_y =
+      (line_count > visible_lines) ? (line_count - visible_lines) : 0;
+  if (st->scroll_y > st->max_scroll_y) {
+    st->scroll_y = st->max_scroll_y;
+  }
+  if (st->max_scroll_y == 0)
+    return;
+
+  st->scrollbar_visible = true;
+  st->scrollbar_x = r.w - kScrollbarWidth - kPadding;
+  st->scrollbar_y = kPadding;
+  st->scrollbar_h = st->content_h;
+  uint32_t thumb_h = (visible_lines * st->scrollbar_h) / line_count;
+  if (thumb_h < 20)
+    thumb_h = 20; // Minimum thumb size
+  if (thumb_h > st->scrollbar_h)
+    thumb_h = st->scrollbar_h;
+  st->thumb_h = thumb_h;
+  st->thumb_y = st->scrollbar_y +
+                (st->scroll_y * (st->scrollbar_h - thumb_h)) / st->max_scroll_y;
+}
+
+static void draw(Graphics &gfx, const ui::Rect &r, void *ud) {
+  const auto *st = static_cast<const TextViewerState *>(ud);
   if (!st) {
     gfx.draw_string("Error: No state", r.x, r.y, 0xFF0000, default_font);
     return;
@@ -40,49 +115,18 @@ static void draw(Graphics &gfx, const ui::Rect &r, void *ud) {
     return;
   }
 
-  // Calculate text area (reserve space for scrollbar on the right)
-  uint32_t text_area_h = r.h - kPadding * 2;
-  uint32_t text_area_w = r.w - kPadding * 2 - kScrollbarWidth;
-  if (text_area_w < default_font.char_width) {
-    text_area_w = default_font.char_width;
-  }
-  uint32_t text_x = r.x + kPadding;
-  uint32_t text_y = r.y + kPadding;
-
-  // Count wrapped lines and calculate max scroll
-  uint32_t line_count = 0;
-  uint32_t visible_lines = text_area_h / kLineHeight;
-  uint32_t max_cols = text_area_w / default_font.char_width;
+  // Layout comes from prepare(); nothing to draw until it has run
+  const uint32_t max_cols = st->wrap_cols;
   if (max_cols == 0)
-    max_cols = 1;
-
-  // Count lines accounting for word wrap (simple character wrap)
-  {
-    uint32_t i = 0;
-    while (i < st->content_size) {
-      // Determine length until newline or end
-      uint32_t start = i;
-      while (i < st->content_size && st->content[i] != '\n') {
-        i++;
-      }
-      uint32_t raw_len = i - start;
-      // Empty line still counts as one
-      uint32_t segs =
-          (raw_len == 0) ? 1 : ((raw_len + max_cols - 1) / max_cols);
-      line_count += segs;
-      // Skip the newline character if present
-      if (i < st->content_size && st->content[i] == '\n') {
-        i++;
-      }
-    }
-    // Special case: empty content shouldn't reach here due to earlier check
-  }
-
-  st->max_scroll_y =
-      (line_count > visible_lines) ? (line_count - visible_lines) : 0;
-  if (st->scroll_y > st->max_scroll_y) {
-    st->scroll_y = st->max_scroll_y;
-  }
+    return;
+  const uint32_t text_area_h = st->content_h;
+  const uint32_t visible_lines = st->visible_lines_cache;
+  const uint32_t text_x = r.x + kPadding;
+  const uint32_t text_y = r.y + kPadding;
+  // One wrapped line at a time, as a C string for draw_string()
+  char *line_buf = platform::frame_alloc_array<char>(max_cols + 1u);
+  if (line_buf == nullptr)
+    return;
 
   // Draw text content with wrapping
   uint32_t current_visual_line = 0;
@@ -107,14 +151,10 @@ static void draw(Graphics &gfx, const ui::Rect &r, void *ud) {
         uint32_t seg_len = remaining > max_cols ? max_cols : remaining;
         // For empty raw line, draw nothing but still advance one visual line
         if (seg_len > 0) {
-          char line_buf[256];
-          uint32_t copy_len = seg_len < (sizeof(line_buf) - 1)
-                                  ? seg_len
-                                  : (sizeof(line_buf) - 1);
-          for (uint32_t j = 0; j < copy_len; ++j) {
+          for (uint32_t j = 0; j < seg_len; ++j) {
             line_buf[j] = st->content[seg_start + j];
           }
-          line_buf[copy_len] = '\0';
+          line_buf[seg_len] = '\0';
           gfx.draw_string(line_buf, text_x, text_y + y_offset, kTextColor,
                           default_font);
         }
@@ -128,48 +168,17 @@ static void draw(Graphics &gfx, const ui::Rect &r, void *ud) {
     }
   }
 
-  // Draw scrollbar if needed
-  if (st->max_scroll_y > 0) {
-    uint32_t scrollbar_x = r.x + r.w - kScrollbarWidth - kPadding;
-    uint32_t scrollbar_y = r.y + kPadding;
-    uint32_t scrollbar_h = r.h - kPadding * 2;
-
-    // Scrollbar background
-    gfx.fill_rect(scrollbar_x, scrollbar_y, kScrollbarWidth, scrollbar_h,
-                  kScrollbarColor);
-
-    // Scrollbar thumb
-    uint32_t thumb_h = (visible_lines * scrollbar_h) / line_count;
-    if (thumb_h < 20)
-      thumb_h = 20; // Minimum thumb size
-
-    uint32_t thumb_y =
-        scrollbar_y + (st->scroll_y * (scrollbar_h - thumb_h)) /
-                          (st->max_scroll_y == 0 ? 1 : st->max_scroll_y);
-    gfx.fill_rect(scrollbar_x, thumb_y, kScrollbarWidth, thumb_h,
-                  kScrollbarThumbColor);
-
-    // Cache geometry/state for mouse handling (store in content-local coords)
-    st->scrollbar_visible = true;
-    st->scrollbar_x = scrollbar_x - r.x;
-    st->scrollbar_y = scrollbar_y - r.y;
-    st->scrollbar_h = scrollbar_h;
-    st->thumb_y = thumb_y - r.y;
-    st->thumb_h = thumb_h;
-    st->visible_lines_cache = visible_lines;
-    st->line_count_cache = line_count;
-    st->content_w = text_area_w;
-    st->content_h = text_area_h;
-  } else {
-    st->scrollbar_visible = false;
+  // Scrollbar track and thumb
+  if (st->scrollbar_visible) {
+    gfx.fill_rect(r.x + st->scrollbar_x, r.y + st->scrollbar_y,
+                  kScrollbarWidth, st->scrollbar_h, kScrollbarColor);
+    gfx.fill_rect(r.x + st->scrollbar_x, r.y + st->thumb_y, kScrollbarWidth,
+                  st->thumb_h, kScrollbarThumbColor);
   }
 }
 
-static void on_mouse(const ui::window::MouseEvent &ev, void *ud) {
-  auto *st = static_cast<TextViewerState *>(ud);
-  if (!st)
-    return;
-
+static void handle_mouse(const ui::window::MouseEvent &ev,
+                         TextViewerState *st) {
   if (ev.type == ui::window::MouseEvent::Type::Wheel) {
     if (st->max_scroll_y > 0) {
       int32_t s = static_cast<int32_t>(st->scroll_y);
@@ -262,20 +271,24 @@ static void on_mouse(const ui::window::MouseEvent &ev, void *ud) {
   }
 }
 
+static void on_mouse(const ui::window::MouseEvent &ev, void *ud) {
+  auto *st = static_cast<TextViewerState *>(ud);
+  if (!st)
+    return;
+  const uint32_t prev_scroll = st->scroll_y;
+  handle_mouse(ev, st);
+  // Only scrolling changes what is drawn
+  if (st->scroll_y != prev_scroll)
+    ui::window::invalidate_content(ev);
+}
+
 static bool load_file_content(TextViewerState *st) {
-  if (!st || !st->fs || !st->file_path) {
+  // The root stands for no file
+  if (!st || !st->fs || st->file_path.is_root()) {
     st->load_error = "Invalid state";
     return false;
   }
 
-  // Store the file path for debugging
-  static char debug_path[256];
-  uint32_t i = 0;
-  for (; st->file_path[i] && i < sizeof(debug_path) - 1; ++i) {
-    debug_path[i] = st->file_path[i];
-  }
-  debug_path[i] = '\0';
-
   // Try to read the file
   uint64_t bytes_read = 0;
 
@@ -292,73 +305,48 @@ static bool load_file_content(TextViewerState *st) {
     return true;
   }
 
-  // Show the path that failed
-  st->load_error = debug_path;
+  // Show the path that failed; the state owns its copy
+  st->load_error = st->file_path.c_str();
   return false;
 }
 
-ui::window::Window create_window(uint32_t screen_w, uint32_t screen_h,
-                                 fs::Ext4 &filesystem, const char *file_path) {
-  // Use a static array to store multiple states (for multiple windows)
-  static TextViewerState s_states[8];
-  static uint32_t s_next_state = 0;
-
-  TextViewerState &s_state = s_states[s_next_state];
-  s_next_state = (s_next_state + 1) % 8; // Cycle through states
-
-  s_state.fs = &filesystem;
-  s_state.file_path = file_path;
-  s_state.content_size = 0;
-  s_state.scroll_y = 0;
-  s_state.max_scroll_y = 0;
-  s_state.content_loaded = false;
-  s_state.load_error = nullptr;
-  s_state.dragging_thumb = false;
-  s_state.drag_offset_y = 0;
-  s_state.scrollbar_visible = false;
-  s_state.scrollbar_x = s_state.scrollbar_y = s_state.scrollbar_h = 0;
-  s_state.thumb_y = s_state.thumb_h = 0;
-  s_state.content_w = s_state.content_h = 0;
-  s_state.visible_lines_cache = 0;
-  s_state.line_count_cache = 0;
-
-  // Copy file path
-  if (file_path) {
-    uint32_t i = 0;
-    for (; file_path[i] && i < sizeof(s_state.file_path_buf) - 1; ++i) {
-      s_state.file_path_buf[i] = file_path[i];
-    }
-    s_state.file_path_buf[i] = '\0';
-    s_state.file_path = s_state.file_path_buf;
-  }
+// Every viewer window owns one state from the pool until it is closed; the
+// pool grows a chunk at a time, so viewers never share a content buffer
+static ui::ObjectPool<TextViewerState, 4> s_states;
 
-  // Try to load the file content
-  load_file_content(&s_state);
+static void on_close(void *ud) {
+  s_states.destroy(s_states.handle_of(static_cast<TextViewerState *>(ud)));
+}
 
-  // Create window title from file path
+ui::window::Window create_window(uint32_t screen_w, uint32_t screen_h,
+                                 fs::Ext4 &filesystem,
+                                 const fs::Path &file_path) {
+  // A new state starts zeroed; without one the window shows an error
+  TextViewerState *st = s_states.get(s_states.create());
   const char *title = "Text Viewer";
-  if (file_path) {
-    // Extract filename from path
-    const char *filename = file_path;
-    for (const char *p = file_path; *p; ++p) {
-      if (*p == '/') {
-        filename = p + 1;
-      }
-    }
-    if (*filename) {
-      title = filename;
-    }
+  if (st) {
+    st->fs = &filesystem;
+    st->file_path = file_path;
+
+    // Try to load the file content
+    load_file_content(st);
   }
 
+  // Title the window with the file name from the state's copy of the path
+  if (st && !st->file_path.is_root())
+    title = st->file_path.name();
+
   ui::window_manager::WindowOptions options;
   options.title = title;
   options.width = 600;
   options.height = 400;
   options.x = 100;
   options.y = 100;
-  options.user_data = &s_state;
+  options.user_data = st;
   options.draw_content = &draw;
+  options.prepare_content = &prepare;
   options.on_mouse = &on_mouse;
+  options.on_close = &on_close;
 
   return ui::window_manager::create_window(screen_w, screen_h, options);
 }
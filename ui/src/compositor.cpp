@@ -0,0 +1,323 @@
+#include "../include/compositor.hpp"
+#include "../include/log.hpp"
+#include "../include/smp.hpp"
+#include "graphics.hpp"
+#include "../include/time.hpp"
+
+namespace ui::compositor {
+
+FramePacer::FramePacer(uint32_t target_fps)
+    : interval_ticks_(0), next_deadline_(0), oldest_input_(0),
+      pending_packets_(0), second_start_(0), frames_this_second_(0),
+      latency_sum_us_(0), latency_frames_(0), stats_{} {
+  if (target_fps == 0)
+    target_fps = 60;
+  interval_ticks_ = platform::timestamp_frequency() / target_fps;
+}
+
+void FramePacer::note_input(uint64_t timestamp) {
+  if (pending_packets_ == 0 || timestamp < oldest_input_)
+    oldest_input_ = timestamp;
+  pending_packets_++;
+}
+
+bool FramePacer::frame_due(uint64_t now) const { return now >= next_deadline_; }
+
+void FramePacer::frame_presented(uint64_t now) {
+  // Schedule the next frame one interval out; if we fell behind by more than
+  // an interval, restart the cadence instead of bursting to catch up.
+  next_deadline_ += interval_ticks_;
+  if (next_deadline_ < now)
+    next_deadline_ = now + interval_ticks_;
+
+  stats_.frames_presented++;
+  if (pending_packets_ > 0) {
+    uint64_t lat = now > oldest_input_
+                       ? platform::ticks_to_us(now - oldest_input_)
+                       : 0;
+    if (lat > 0xFFFFFFFFu)
+      lat = 0xFFFFFFFFu;
+    stats_.last_latency_us = static_cast<uint32_t>(lat);
+    if (stats_.last_latency_us > stats_.max_latency_us)
+      stats_.max_latency_us = stats_.last_latency_us;
+    stats_.packets_applied += pending_packets_;
+    latency_sum_us_ += lat;
+    latency_frames_++;
+    stats_.avg_latency_us =
+        static_cast<uint32_t>(latency_sum_us_ / latency_frames_);
+    pending_packets_ = 0;
+  }
+
+  // Frames per second over fixed one-second windows
+  frames_this_second_++;
+  if (second_start_ == 0)
+    second_start_ = now;
+  if (now - second_start_ >= platform::timestamp_frequency()) {
+    stats_.frames_per_second = frames_this_second_;
+    frames_this_second_ = 0;
+    second_start_ = now;
+  }
+}
+
+const char *quality_name(Quality q) {
+  switch (q) {
+  case Quality::Full:
+    return "full";
+  case Quality::OutlineDrag:
+    return "outline-drag";
+  case Quality::FocusedContent:
+    return "focused-content";
+  case Quality::DeferChrome:
+    return "defer-chrome";
+  }
+  return "?";
+}
+
+FrameBudget::FrameBudget(uint32_t budget_us)
+    : budget_us_(budget_us ? budget_us : 1), quality_(Quality::Full),
+      frame_start_(0), last_frame_us_(0), over_streak_(0), under_streak_(0) {}
+
+void FrameBudget::frame_begin(uint64_t now) { frame_start_ = now; }
+
+void FrameBudget::frame_end(uint64_t now) {
+  uint64_t us = now > frame_start_ ? platform::ticks_to_us(now - frame_start_)
+                                   : 0;
+  if (us > 0xFFFFFFFFu)
+    us = 0xFFFFFFFFu;
+  last_frame_us_ = static_cast<uint32_t>(us);
+
+  const uint32_t q = static_cast<uint32_t>(quality_);
+  if (last_frame_us_ > budget_us_) {
+    under_streak_ = 0;
+    ++over_streak_;
+    const bool way_over = last_frame_us_ / 2 > budget_us_;
+    if (q < static_cast<uint32_t>(Quality::DeferChrome) &&
+        (way_over || over_streak_ >= kDegradeAfter))
+      step(static_cast<Quality>(q + 1), last_frame_us_);
+    return;
+  }
+  over_streak_ = 0;
+  if (last_frame_us_ > budget_us_ / 4 * 3) {
+    under_streak_ = 0;
+    return;
+  }
+  ++under_streak_;
+  if (q > 0 && under_streak_ >= kRestoreAfter)
+    step(static_cast<Quality>(q - 1), last_frame_us_);
+}
+
+void FrameBudget::step(Quality to, uint32_t frame_us) {
+  platform::log("compositor: frame %uus, budget %uus: quality %s -> %s\n",
+                frame_us, budget_us_, quality_name(quality_),
+                quality_name(to));
+  quality_ = to;
+  over_streak_ = 0;
+  under_streak_ = 0;
+}
+
+static inline uint64_t area(const Rect &r) {
+  return static_cast<uint64_t>(r.w) * r.h;
+}
+
+static inline Rect bounds(const Rect &a, const Rect &b) {
+  const uint32_t x0 = a.x < b.x ? a.x : b.x;
+  const uint32_t y0 = a.y < b.y ? a.y : b.y;
+  const uint32_t x1 = (a.x + a.w) > (b.x + b.w) ? (a.x + a.w) : (b.x + b.w);
+  const uint32_t y1 = (a.y + a.h) > (b.y + b.h) ? (a.y + a.h) : (b.y + b.h);
+  return Rect{x0, y0, x1 - x0, y1 - y0};
+}
+
+static inline bool touches(const Rect &a, const Rect &b) {
+  return a.x <= b.x + b.w && b.x <= a.x + a.w && a.y <= b.y + b.h &&
+         b.y <= a.y + a.h;
+}
+
+DamageRegion::DamageRegion() : rects_{}, count_(0), full_(false) {}
+
+void DamageRegion::add(const Rect &r) {
+  if (full_ || r.w == 0 || r.h == 0)
+    return;
+  // Fold into an overlapping or adjacent rect
+  for (uint32_t i = 0; i < count_; ++i) {
+    if (touches(rects_[i], r)) {
+      rects_[i] = bounds(rects_[i], r);
+      return;
+    }
+  }
+  if (count_ < kMaxRects) {
+    rects_[count_++] = r;
+    return;
+  }
+  // Out of slots: merge with the rect whose bounds grow the least
+  uint32_t best = 0;
+  uint64_t best_growth = UINT64_MAX;
+  for (uint32_t i = 0; i < count_; ++i) {
+    const uint64_t growth = area(bounds(rects_[i], r)) - area(rects_[i]);
+    if (growth < best_growth) {
+      best_growth = growth;
+      best = i;
+    }
+  }
+  rects_[best] = bounds(rects_[best], r);
+}
+
+void DamageRegion::add_all() {
+  full_ = true;
+  count_ = 0;
+}
+
+void DamageRegion::clear() {
+  full_ = false;
+  count_ = 0;
+}
+
+DamageRegion &damage() {
+  static DamageRegion s_damage;
+  return s_damage;
+}
+
+void route_damage(const DamageRegion &damage, Output *outputs,
+                  uint32_t count) {
+  for (uint32_t o = 0; o < count; ++o) {
+    Output &out = outputs[o];
+    if (damage.full()) {
+      out.damage.add_all();
+      continue;
+    }
+    const Rect &b = out.rect;
+    for (uint32_t i = 0; i < damage.count(); ++i) {
+      const Rect &r = damage.rect(i);
+      const uint32_t x0 = r.x > b.x ? r.x : b.x;
+      const uint32_t y0 = r.y > b.y ? r.y : b.y;
+      const uint32_t x1 = (r.x + r.w) < (b.x + b.w) ? (r.x + r.w) : (b.x + b.w);
+      const uint32_t y1 = (r.y + r.h) < (b.y + b.h) ? (r.y + r.h) : (b.y + b.h);
+      if (x0 < x1 && y0 < y1)
+        out.damage.add(Rect{x0, y0, x1 - x0, y1 - y0});
+    }
+  }
+}
+
+static inline bool overlaps(const Rect &a, const Rect &b) {
+  return a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h &&
+         b.y < a.y + a.h;
+}
+
+TileRenderer::TileRenderer()
+    : tiles_{}, tile_count_(0), scene_(nullptr), scene_ctx_(nullptr),
+      busy_ticks_{}, frames_(0), window_start_(0) {}
+
+// At most bands tiles, and bands is at most kMaxCpus, so the areas of a
+// frame always fit kMaxTiles
+void TileRenderer::add_bands(Output &out, const Rect &r, uint32_t bands) {
+  if (bands > platform::kMaxCpus)
+    bands = platform::kMaxCpus;
+  uint32_t rows = (r.h + bands - 1) / bands;
+  if (rows < kMinBandRows)
+    rows = kMinBandRows;
+  for (uint32_t oy = 0; oy < r.h;) {
+    const uint32_t h = (r.h - oy) < rows ? (r.h - oy) : rows;
+    tiles_[tile_count_++] = Tile{&out, Rect{r.x, r.y + oy, r.w, h}};
+    oy += h;
+  }
+}
+
+void TileRenderer::run_tile(uint32_t index, void *self) {
+  TileRenderer &tr = *static_cast<TileRenderer *>(self);
+  const Tile &t = tr.tiles_[index];
+  Graphics gfx = *t.output->gfx;
+  gfx.set_clip_rect(t.rect.x, t.rect.y, t.rect.w, t.rect.h);
+  tr.scene_(gfx, tr.scene_ctx_);
+}
+
+void TileRenderer::account(uint64_t now) {
+  platform::ParallelStats st;
+  platform::last_parallel_stats(st);
+  for (uint32_t c = 0; c < st.cpus && c < platform::kMaxCpus; ++c)
+    busy_ticks_[c] += st.busy_ticks[c];
+  ++frames_;
+  if (window_start_ == 0)
+    window_start_ = now;
+  if (now - window_start_ < platform::timestamp_frequency())
+    return;
+
+  // Report per-CPU render time over the last second; imbalance is the
+  // busiest CPU against the average, 100% being perfectly even
+  uint64_t total = 0;
+  uint64_t busiest = 0;
+  const uint32_t cpus = st.cpus < platform::kMaxCpus ? st.cpus : platform::kMaxCpus;
+  for (uint32_t c = 0; c < cpus; ++c) {
+    total += busy_ticks_[c];
+    if (busy_ticks_[c] > busiest)
+      busiest = busy_ticks_[c];
+  }
+  if (cpus > 1 && total > 0) {
+    platform::log("render: %u frames, imbalance %lu%%, busy us:", frames_,
+                  busiest * cpus * 100 / total);
+    for (uint32_t c = 0; c < cpus; ++c)
+      platform::log(" %lu", platform::ticks_to_us(busy_ticks_[c]));
+    platform::log("\n");
+  }
+  for (uint32_t c = 0; c < platform::kMaxCpus; ++c)
+    busy_ticks_[c] = 0;
+  frames_ = 0;
+  window_start_ = now;
+}
+
+void TileRenderer::render(Output *outputs, uint32_t count, SceneFn scene,
+                          const void *scene_ctx) {
+  scene_ = scene;
+  scene_ctx_ = scene_ctx;
+  tile_count_ = 0;
+
+  // Disjoint damage per output: full damage is the output itself, otherwise
+  // overlapping rects are merged until none overlap
+  Rect areas[kMaxAreas];
+  Output *owners[kMaxAreas];
+  uint32_t area_count = 0;
+  for (uint32_t o = 0; o < count; ++o) {
+    const DamageRegion &d = outputs[o].damage;
+    const uint32_t first = area_count;
+    if (d.full()) {
+      areas[area_count] = outputs[o].rect;
+      owners[area_count++] = &outputs[o];
+    } else {
+      for (uint32_t i = 0; i < d.count(); ++i) {
+        areas[area_count] = d.rect(i);
+        owners[area_count++] = &outputs[o];
+      }
+    }
+    for (bool merged = true; merged;) {
+      merged = false;
+      for (uint32_t i = first; i < area_count && !merged; ++i) {
+        for (uint32_t j = i + 1; j < area_count; ++j) {
+          if (!overlaps(areas[i], areas[j]))
+            continue;
+          areas[i] = bounds(areas[i], areas[j]);
+          areas[j] = areas[--area_count];
+          merged = true;
+          break;
+        }
+      }
+    }
+  }
+  if (area_count == 0)
+    return;
+
+  // One band per CPU per area; a single CPU draws each area whole
+  const uint32_t cpus = platform::cpu_count();
+  for (uint32_t i = 0; i < area_count; ++i)
+    add_bands(*owners[i], areas[i], cpus);
+
+  platform::parallel_for(tile_count_, &TileRenderer::run_tile, this);
+  account(platform::timestamp());
+}
+
+} // namespace ui::compositor
+
+namespace ui {
+
+void invalidate(const Rect &r) { compositor::damage().add(r); }
+
+void invalidate_all() { compositor::damage().add_all(); }
+
+} // namespace ui
@@ -0,0 +1,193 @@
+#include "../include/hit_test.hpp"
+#include <new>
+
+namespace ui::hit_test {
+
+using window_manager::kNoWindow;
+using window_manager::WindowHandle;
+using window_manager::WindowManager;
+
+static inline bool rect_contains(const Rect &r, uint32_t x, uint32_t y) {
+  return x >= r.x && x < r.x + r.w && y >= r.y && y < r.y + r.h;
+}
+
+HitMap::HitMap()
+    : entries_(nullptr), entry_count_(0), entry_capacity_(0), cols_(0),
+      rows_(0), width_(0), height_(0), screen_w_(0), screen_h_(0) {}
+
+HitMap::~HitMap() { delete[] entries_; }
+
+void HitMap::add(const WindowManager &wm, WindowHandle h) {
+  if (entry_count_ >= entry_capacity_)
+    return;
+  const window::Window &w = *wm.get(h);
+  Entry &e = entries_[entry_count_];
+  e.window = h;
+  e.layout = window::compute_layout(
+      w, window::get_frame_rect(w, screen_w_, screen_h_));
+  e.resizable = w.resizable && !w.fullscreen && !w.maximized;
+  e.draggable = w.movable && w.draggable;
+
+  // Register in every cell the frame overlaps; entries arrive topmost first
+  const Rect &f = e.layout.frame;
+  if (f.w == 0 || f.h == 0) {
+    ++entry_count_;
+    return;
+  }
+  const uint32_t c0 = f.x >> kCellShift;
+  const uint32_t r0 = f.y >> kCellShift;
+  uint32_t c1 = (f.x + f.w - 1) >> kCellShift;
+  uint32_t r1 = (f.y + f.h - 1) >> kCellShift;
+  if (c1 >= cols_)
+    c1 = cols_ - 1;
+  if (r1 >= rows_)
+    r1 = rows_ - 1;
+  const uint32_t fx1 = f.x + f.w;
+  const uint32_t fy1 = f.y + f.h;
+  for (uint32_t r = r0; r <= r1 && r < rows_; ++r) {
+    // Cell extent, clipped to the desktop
+    const uint32_t y0 = r << kCellShift;
+    uint32_t y1 = y0 + (1u << kCellShift);
+    if (y1 > height_)
+      y1 = height_;
+    const bool spans_rows = f.y <= y0 && fy1 >= y1;
+    for (uint32_t c = c0; c <= c1 && c < cols_; ++c) {
+      Cell &cell = cells_[r][c];
+      // Hidden here by a window above
+      if (cell.covered || cell.count == kOverflow)
+        continue;
+      if (cell.count == kPerCell) {
+        cell.count = kOverflow;
+        continue;
+      }
+      cell.entries[cell.count++] = static_cast<uint16_t>(entry_count_);
+      const uint32_t x0 = c << kCellShift;
+      uint32_t x1 = x0 + (1u << kCellShift);
+      if (x1 > width_)
+        x1 = width_;
+      cell.covered = spans_rows && f.x <= x0 && fx1 >= x1;
+    }
+  }
+  ++entry_count_;
+}
+
+void HitMap::rebuild(const WindowManager &wm) {
+  const Desktop &d = desktop();
+  entry_count_ = 0;
+  // Room for every window; without it the windows that do not fit are not
+  // hit-testable until a later rebuild manages to grow
+  if (wm.count() > entry_capacity_ && entry_capacity_ < kMaxEntries) {
+    uint32_t capacity = wm.count() * 2;
+    if (capacity > kMaxEntries)
+      capacity = kMaxEntries;
+    if (Entry *grown = new (std::nothrow) Entry[capacity]) {
+      delete[] entries_;
+      entries_ = grown;
+      entry_capacity_ = capacity;
+    }
+  }
+  screen_w_ = d.primary.w;
+  screen_h_ = d.primary.h;
+  width_ = d.bounds.w;
+  height_ = d.bounds.h;
+  cols_ = (d.bounds.w + (1u << kCellShift) - 1) >> kCellShift;
+  rows_ = (d.bounds.h + (1u << kCellShift) - 1) >> kCellShift;
+  if (cols_ > kMaxCols)
+    cols_ = kMaxCols;
+  if (rows_ > kMaxRows)
+    rows_ = kMaxRows;
+  for (uint32_t r = 0; r < rows_; ++r) {
+    for (uint32_t c = 0; c < cols_; ++c) {
+      cells_[r][c].count = 0;
+      cells_[r][c].covered = false;
+    }
+  }
+
+  // Mirror draw_desktop(): a fullscreen window is above everything on the
+  // primary output, and covers it entirely; other outputs stay live
+  const WindowHandle fs = fullscreen_window(wm);
+  if (fs != kNoWindow)
+    add(wm, fs);
+
+  // Then layers from top to bottom: focused always-on-top, other
+  // always-on-top, focused, then the rest
+  const WindowHandle focused = wm.focused();
+  const window::Window *fw = wm.get(focused);
+  const bool focused_visible = fw && !fw->minimized && focused != fs;
+  if (focused_visible && fw->always_on_top)
+    add(wm, focused);
+  for (WindowHandle h = wm.top(); h != kNoWindow; h = wm.below(h)) {
+    const window::Window &w = *wm.get(h);
+    if (!w.minimized && w.always_on_top && h != focused && h != fs)
+      add(wm, h);
+  }
+  if (focused_visible && !fw->always_on_top)
+    add(wm, focused);
+  for (WindowHandle h = wm.top(); h != kNoWindow; h = wm.below(h)) {
+    const window::Window &w = *wm.get(h);
+    if (!w.minimized && !w.always_on_top && h != focused && h != fs)
+      add(wm, h);
+  }
+}
+
+bool HitMap::classify(const Entry &e, uint32_t x, uint32_t y,
+                      Hit &out) const {
+  const window::Layout &l = e.layout;
+  if (!rect_contains(l.frame, x, y))
+    return false;
+  out.window = e.window;
+  out.detail = 0;
+  if (e.resizable) {
+    const uint32_t mask = window::resize_edges(l.frame, x, y);
+    if (mask != 0) {
+      out.zone = Zone::Resize;
+      out.detail = mask;
+      return true;
+    }
+  }
+  for (uint32_t i = 0; i < 4; ++i) {
+    if (rect_contains(l.buttons[i], x, y)) {
+      out.zone = Zone::Button;
+      out.detail = i;
+      return true;
+    }
+  }
+  if (e.draggable && rect_contains(l.titlebar, x, y)) {
+    out.zone = Zone::Titlebar;
+    return true;
+  }
+  out.zone = rect_contains(l.content, x, y) ? Zone::Content : Zone::Frame;
+  return true;
+}
+
+uint32_t HitMap::overflowed_cells() const {
+  uint32_t n = 0;
+  for (uint32_t r = 0; r < rows_; ++r)
+    for (uint32_t c = 0; c < cols_; ++c)
+      n += cells_[r][c].count == kOverflow;
+  return n;
+}
+
+Hit HitMap::query(uint32_t x, uint32_t y) const {
+  Hit hit{kNoWindow, Zone::None, 0};
+  const uint32_t c = x >> kCellShift;
+  const uint32_t r = y >> kCellShift;
+  if (c < cols_ && r < rows_) {
+    const Cell &cell = cells_[r][c];
+    if (cell.count != kOverflow) {
+      for (uint32_t i = 0; i < cell.count; ++i) {
+        if (classify(entries_[cell.entries[i]], x, y, hit))
+          return hit;
+      }
+      return hit;
+    }
+  }
+  // Crowded cell or off the grid: walk every window, topmost first
+  for (uint32_t i = 0; i < entry_count_; ++i) {
+    if (classify(entries_[i], x, y, hit))
+      return hit;
+  }
+  return hit;
+}
+
+} // namespace ui::hit_test
@@ -0,0 +1,160 @@
+#include "../include/layer_cache.hpp"
+#include "../include/compositor.hpp"
+#include "../include/taskbar.hpp"
+#include "graphics.hpp"
+
+namespace ui::layer_cache {
+
+struct Surface {
+  uint32_t *pixels;
+  uint32_t capacity;
+  Rect rect;         // desktop area the pixels cover
+  uint32_t revision; // layer revision the pixels show; 0 = never rendered
+};
+
+struct BackgroundEntry {
+  const Graphics *gfx;
+  Surface surface;
+};
+
+static BackgroundEntry s_backgrounds[compositor::kMaxOutputs];
+static uint32_t s_background_count = 0;
+static uint32_t s_background_revision = 1;
+static Surface s_taskbar{nullptr, 0, Rect{0, 0, 0, 0}, 0};
+
+bool attach_background(const Graphics &gfx, uint32_t *pixels,
+                       uint32_t capacity_pixels) {
+  const uint32_t w = gfx.get_width();
+  const uint32_t h = gfx.get_height();
+  if (pixels == nullptr || capacity_pixels < w * h ||
+      s_background_count >= compositor::kMaxOutputs)
+    return false;
+  BackgroundEntry &e = s_backgrounds[s_background_count++];
+  e.gfx = &gfx;
+  e.surface = Surface{pixels, capacity_pixels,
+                      Rect{gfx.get_origin_x(), gfx.get_origin_y(), w, h}, 0};
+  return true;
+}
+
+void attach_taskbar(uint32_t *pixels, uint32_t capacity_pixels) {
+  s_taskbar = Surface{pixels, capacity_pixels, Rect{0, 0, 0, 0}, 0};
+}
+
+void invalidate_background() { ++s_background_revision; }
+
+// Render one layer alone into a surface. The offscreen target is not
+// attached to any cache, so draw_desktop_layer() draws it for real.
+static void render(Surface &s, RenderLayer layer,
+                   const window_manager::WindowManager &wm,
+                   uint32_t revision) {
+  Graphics target(s.pixels, s.rect.w, s.rect.h, s.rect.w);
+  target.set_origin(s.rect.x, s.rect.y);
+  draw_desktop_layer(target, layer, wm);
+  s.revision = revision;
+}
+
+// Render the part of a layer inside r again, leaving the rest of the surface
+static void render_rect(Surface &s, RenderLayer layer,
+                        const window_manager::WindowManager &wm,
+                        const Rect &r) {
+  Graphics target(s.pixels, s.rect.w, s.rect.h, s.rect.w);
+  target.set_origin(s.rect.x, s.rect.y);
+  target.set_clip_rect(r.x, r.y, r.w, r.h);
+  draw_desktop_layer(target, layer, wm);
+}
+
+// Desktop rect of the primary screen's taskbar band
+static Rect taskbar_band() {
+  const Rect &screen = desktop().primary;
+  const uint32_t h = taskbar::height(screen.h);
+  return Rect{screen.x, screen.y + screen.h - h, screen.w, h};
+}
+
+// Revisions the taskbar surface may fall behind and still be patched
+static constexpr uint32_t kMaxTaskbarDamage = 16;
+
+static bool contains(const Rect &outer, const Rect &inner) {
+  return inner.x >= outer.x && inner.y >= outer.y &&
+         inner.x + inner.w <= outer.x + outer.w &&
+         inner.y + inner.h <= outer.y + outer.h;
+}
+
+// Bring the taskbar surface up to date; false if the band does not fit it
+static bool refresh_taskbar(const window_manager::WindowManager &wm) {
+  Surface &s = s_taskbar;
+  const Rect band = taskbar_band();
+  if (s.pixels == nullptr || band.w * band.h > s.capacity)
+    return false;
+  const uint32_t current = taskbar::revision();
+  if (s.revision == current)
+    return true;
+  const bool moved = s.rect.x != band.x || s.rect.y != band.y ||
+                     s.rect.w != band.w || s.rect.h != band.h;
+  // Repaint just what each missed revision invalidated, if all are known
+  Rect damaged[kMaxTaskbarDamage];
+  uint32_t count = 0;
+  bool partial =
+      !moved && s.revision != 0 && current - s.revision <= kMaxTaskbarDamage;
+  for (uint32_t rev = s.revision + 1; partial && rev != current + 1; ++rev) {
+    Rect r;
+    partial = taskbar::damage(rev, r);
+    bool seen = false;
+    for (uint32_t i = 0; i < count && !seen; ++i)
+      seen = contains(damaged[i], r);
+    if (partial && !seen)
+      damaged[count++] = r;
+  }
+  if (!partial) {
+    s.rect = band;
+    render(s, RenderLayer::Taskbar, wm, current);
+    return true;
+  }
+  for (uint32_t i = 0; i < count; ++i)
+    render_rect(s, RenderLayer::Taskbar, wm, damaged[i]);
+  s.revision = current;
+  return true;
+}
+
+void prepare(const window_manager::WindowManager &wm) {
+  for (uint32_t i = 0; i < s_background_count; ++i) {
+    Surface &s = s_backgrounds[i].surface;
+    if (s.revision != s_background_revision)
+      render(s, RenderLayer::Background, wm, s_background_revision);
+  }
+  refresh_taskbar(wm);
+}
+
+static void restore(Graphics &gfx, const Surface &s) {
+  gfx.blit(s.pixels, s.rect.w, s.rect.x, s.rect.y, s.rect.w, s.rect.h);
+}
+
+bool draw(Graphics &gfx, RenderLayer layer,
+          const window_manager::WindowManager &wm) {
+  if (layer == RenderLayer::Background) {
+    for (uint32_t i = 0; i < s_background_count; ++i) {
+      Surface &s = s_backgrounds[i].surface;
+      if (s_backgrounds[i].gfx != &gfx)
+        continue;
+      if (!gfx.is_visible(s.rect.x, s.rect.y, s.rect.w, s.rect.h))
+        return true;
+      if (s.revision != s_background_revision)
+        render(s, layer, wm, s_background_revision);
+      restore(gfx, s);
+      return true;
+    }
+    return false;
+  }
+
+  if (layer == RenderLayer::Taskbar) {
+    const Rect band = taskbar_band();
+    if (!gfx.is_visible(band.x, band.y, band.w, band.h))
+      return s_taskbar.pixels != nullptr;
+    if (!refresh_taskbar(wm))
+      return false;
+    restore(gfx, s_taskbar);
+    return true;
+  }
+  return false;
+}
+
+} // namespace ui::layer_cache
@@ -9,82 +9,114 @@ static constexpr uint32_t kBorder = 0x555555;
 static constexpr uint32_t kItemBg = 0x333333;
 static constexpr uint32_t kItemHover = 0x3F3F3F;
 static constexpr uint32_t kText = 0xFFFFFF;
+static constexpr uint32_t kMenuW = 220;
+static constexpr uint32_t kMenuH = 200;
+
+// Retained menu pixels (one start menu exists)
+static uint32_t s_surface[kMenuW * kMenuH];
 
 void init(State &st, uint32_t screen_w, uint32_t screen_h, const Item *items,
           uint32_t item_count) {
   st.open = false;
-  const uint32_t menu_w = 220;
-  const uint32_t menu_h = 200;
+  const uint32_t menu_w = kMenuW;
+  const uint32_t menu_h = kMenuH;
   const uint32_t tb_h =
       (screen_h / 18 < 32 ? 32 : (screen_h / 18 > 64 ? 64 : screen_h / 18));
   st.rect = ui::Rect{8u, screen_h - tb_h - menu_h - 8u, menu_w, menu_h};
   st.items = items;
   st.item_count = item_count;
   st.hover_index = -1;
+  st.surface_valid = false;
+  st.painted_hover = -1;
+}
+
+ui::Rect item_rect(const State &st, int32_t index) {
+  const ui::Rect &r = st.rect;
+  const uint32_t row_h = default_font.char_height + 8u;
+  if (index < 0 || static_cast<uint32_t>(index) >= st.item_count)
+    return ui::Rect{0, 0, 0, 0};
+  const uint32_t y = r.y + 8u + static_cast<uint32_t>(index) * (row_h + 6u);
+  if (y + row_h > r.y + r.h)
+    return ui::Rect{0, 0, 0, 0};
+  return ui::Rect{r.x + 6, y, r.w - 12, row_h};
+}
+
+static inline bool contains(const ui::Rect &r, uint32_t x, uint32_t y) {
+  return x >= r.x && x < r.x + r.w && y >= r.y && y < r.y + r.h;
 }
 
-void draw(Graphics &gfx, const State &st) {
+// Paint one item row into the surface (menu-local coordinates)
+static void paint_item(Graphics &surf, const State &st, int32_t index) {
+  const ui::Rect ir = item_rect(st, index);
+  if (ir.w == 0)
+    return;
+  const uint32_t x = ir.x - st.rect.x;
+  const uint32_t y = ir.y - st.rect.y;
+  uint32_t bg = (index == st.hover_index) ? kItemHover : kItemBg;
+  surf.fill_rect(x, y, ir.w, ir.h, bg);
+  surf.draw_string(st.items[index].label, x + 6, y + 4, kText, default_font);
+}
+
+void prepare(State &st) {
   if (!st.open)
     return;
   const ui::Rect &r = st.rect;
-  gfx.fill_rect(r.x, r.y, r.w, r.h, kBg);
-  gfx.draw_rect(r.x, r.y, r.w, r.h, kBorder);
+  const uint32_t w = r.w < kMenuW ? r.w : kMenuW;
+  const uint32_t h = r.h < kMenuH ? r.h : kMenuH;
+  Graphics surf(s_surface, w, h, kMenuW);
 
-  const uint32_t row_h = default_font.char_height + 8u;
-  uint32_t y = r.y + 8u;
-  for (uint32_t i = 0; i < st.item_count; ++i) {
-    if (y + row_h > r.y + r.h)
-      break;
-    uint32_t bg =
-        (static_cast<int32_t>(i) == st.hover_index) ? kItemHover : kItemBg;
-    gfx.fill_rect(r.x + 6, y, r.w - 12, row_h, bg);
-    gfx.draw_string(st.items[i].label, r.x + 12, y + 4, kText, default_font);
-    y += row_h + 6u;
+  if (!st.surface_valid) {
+    surf.fill_rect(0, 0, w, h, kBg);
+    surf.draw_rect(0, 0, w, h, kBorder);
+    for (uint32_t i = 0; i < st.item_count; ++i)
+      paint_item(surf, st, static_cast<int32_t>(i));
+    st.surface_valid = true;
+  } else if (st.painted_hover != st.hover_index) {
+    paint_item(surf, st, st.painted_hover);
+    paint_item(surf, st, st.hover_index);
   }
+  st.painted_hover = st.hover_index;
+}
+
+void draw_surface(Graphics &gfx, const State &st) {
+  if (!st.open)
+    return;
+  const ui::Rect &r = st.rect;
+  const uint32_t w = r.w < kMenuW ? r.w : kMenuW;
+  const uint32_t h = r.h < kMenuH ? r.h : kMenuH;
+  gfx.blit(s_surface, kMenuW, r.x, r.y, w, h);
+}
+
+void draw(Graphics &gfx, State &st) {
+  prepare(st);
+  draw_surface(gfx, st);
 }
 
 uint32_t hit_test_click(const State &st, uint32_t x, uint32_t y) {
   if (!st.open)
     return UINT32_MAX;
-  const ui::Rect &r = st.rect;
-  if (!(x >= r.x && x < r.x + r.w && y >= r.y && y < r.y + r.h)) {
+  if (!contains(st.rect, x, y)) {
     return 0xFFFFFFFEu; // outside: request close
   }
-  const uint32_t row_h = default_font.char_height + 8u;
-  uint32_t ycur = r.y + 8u;
   for (uint32_t i = 0; i < st.item_count; ++i) {
-    if (ycur + row_h > r.y + r.h)
-      break;
-    ui::Rect ir{r.x + 6, ycur, r.w - 12, row_h};
-    if (x >= ir.x && x < ir.x + ir.w && y >= ir.y && y < ir.y + ir.h) {
+    if (contains(item_rect(st, static_cast<int32_t>(i)), x, y))
       return st.items[i].id;
-    }
-    ycur += row_h + 6u;
   }
   return UINT32_MAX;
 }
 
-void update_hover(State &st, uint32_t x, uint32_t y) {
-  if (!st.open) {
-    st.hover_index = -1;
-    return;
-  }
-  const ui::Rect &r = st.rect;
+bool update_hover(State &st, uint32_t x, uint32_t y) {
+  const int32_t prev = st.hover_index;
   st.hover_index = -1;
-  if (!(x >= r.x && x < r.x + r.w && y >= r.y && y < r.y + r.h))
-    return;
-  const uint32_t row_h = default_font.char_height + 8u;
-  uint32_t ycur = r.y + 8u;
-  for (uint32_t i = 0; i < st.item_count; ++i) {
-    if (ycur + row_h > r.y + r.h)
-      break;
-    ui::Rect ir{r.x + 6, ycur, r.w - 12, row_h};
-    if (x >= ir.x && x < ir.x + ir.w && y >= ir.y && y < ir.y + ir.h) {
-      st.hover_index = static_cast<int32_t>(i);
-      return;
+  if (st.open && contains(st.rect, x, y)) {
+    for (uint32_t i = 0; i < st.item_count; ++i) {
+      if (contains(item_rect(st, static_cast<int32_t>(i)), x, y)) {
+        st.hover_index = static_cast<int32_t>(i);
+        break;
+      }
     }
-    ycur += row_h + 6u;
   }
+  return st.hover_index != prev;
 }
 
 } // namespace ui::startmenu
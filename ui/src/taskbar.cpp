@@ -2,6 +2,7 @@
 #include "../include/time.hpp"
 #include "../include/ui.hpp"
 #include "../include/window.hpp"
+#include "../include/window_manager.hpp"
 #include "font.hpp"
 #include "graphics.hpp"
 
@@ -15,71 +16,244 @@ static constexpr uint32_t kButtonText = 0xFFFFFF;
 static constexpr uint32_t kButtonBgFocused = 0x4A4A4A;
 static constexpr uint32_t kButtonBorderFocused = 0x7A7A7A;
 static constexpr uint32_t kButtonTextFocused = 0xFFFFFF;
+static constexpr uint32_t kMaxButtons = 64;
+
+static inline bool contains(const Rect &r, uint32_t x, uint32_t y) {
+  return x >= r.x && x < r.x + r.w && y >= r.y && y < r.y + r.h;
+}
 
 uint32_t height(uint32_t screen_h) {
   return (screen_h / 18 < 32 ? 32 : (screen_h / 18 > 64 ? 64 : screen_h / 18));
 }
 
-void draw(Graphics &gfx, uint32_t screen_w, uint32_t screen_h,
-          const window::Window *windows, uint32_t count) {
+// Width reserved for the date/time box
+static uint32_t clock_width() {
+  // Enough for YYYY-MM-DD plus padding
+  uint32_t clock_w = 10u * default_font.char_width + 20u;
+  if (clock_w < 100u)
+    clock_w = 100u;
+  return clock_w;
+}
+
+Rect clock_rect(uint32_t screen_w, uint32_t screen_h) {
+  const uint32_t clock_w = clock_width();
+  if (screen_w <= clock_w + 8u)
+    return Rect{0, 0, 0, 0};
+  const uint32_t h = height(screen_h);
+  return Rect{screen_w - clock_w - 8u, screen_h - h + 6u, clock_w, h - 12u};
+}
+
+static uint32_t s_revision = 1; // the initial look, nothing invalidated
+
+// Rect each of the last kDamageLog revisions invalidated, indexed by revision
+static constexpr uint32_t kDamageLog = 16;
+static Rect s_damage[kDamageLog];
+
+uint32_t revision() { return s_revision; }
+
+bool damage(uint32_t rev, Rect &out) {
+  if (rev <= 1 || rev > s_revision || s_revision - rev >= kDamageLog)
+    return false;
+  out = s_damage[rev % kDamageLog];
+  return true;
+}
+
+// Schedule a repaint of r and record it under a new revision
+static void changed(const Rect &r) {
+  ui::invalidate(r);
+  s_damage[++s_revision % kDamageLog] = r;
+}
+
+void update_clock(uint32_t screen_w, uint32_t screen_h) {
+  // Minute last scheduled for display; the first call only records it since
+  // the initial desktop draw already shows it
+  static uint64_t s_minute = UINT64_MAX;
+  const uint64_t minute = platform::clock_seconds() / 60u;
+  if (minute == s_minute)
+    return;
+  if (s_minute != UINT64_MAX) {
+    changed(clock_rect(screen_w, screen_h));
+  }
+  s_minute = minute;
+}
+
+// Look of a window button; compared against the last scheduled look to decide
+// which buttons need repainting
+enum class ButtonStyle : uint8_t { Normal, Focused, Minimized };
+
+struct Button {
+  window_manager::WindowHandle window;
+  Rect rect;
+  ButtonStyle scheduled; // look the last repaint request was made for
+};
+
+// Cached taskbar geometry. Rebuilt only when the window set changes (open,
+// close, rename) or the screen size does; focus and minimize changes only
+// repaint the affected buttons.
+struct Layout {
+  bool valid;
+  bool announced; // the band was invalidated since the last rebuild
+  const window_manager::WindowManager *wm;
+  uint32_t wm_version;
+  uint32_t screen_w;
+  uint32_t screen_h;
+  Rect band;
+  Rect start;
+  Rect clock;
+  Button buttons[kMaxButtons];
+  uint32_t button_count;
+};
+
+static Layout s_layout{};
+
+static ButtonStyle style_of(const window::Window &w) {
+  if (w.minimized)
+    return ButtonStyle::Minimized;
+  return w.focused ? ButtonStyle::Focused : ButtonStyle::Normal;
+}
+
+static bool layout_stale(const window_manager::WindowManager &wm,
+                         uint32_t screen_w, uint32_t screen_h) {
+  return !s_layout.valid || s_layout.wm != &wm ||
+         s_layout.wm_version != wm.version() ||
+         s_layout.screen_w != screen_w || s_layout.screen_h != screen_h;
+}
+
+static void rebuild(const window_manager::WindowManager &wm, uint32_t screen_w,
+                    uint32_t screen_h) {
+  using window_manager::kNoWindow;
+  Layout &l = s_layout;
   const uint32_t h = height(screen_h);
   const uint32_t y = screen_h - h;
-  gfx.fill_rect(0, y, screen_w, h, kTaskbarBg);
-  gfx.draw_rect(0, y, screen_w, h, kTaskbarBorder);
+  l.valid = true;
+  l.announced = false;
+  l.wm = &wm;
+  l.wm_version = wm.version();
+  l.screen_w = screen_w;
+  l.screen_h = screen_h;
+  l.band = Rect{0, y, screen_w, h};
 
   // Start area
   uint32_t x = 8;
   const uint32_t start_w = 80;
-  gfx.fill_rect(x, y + 6, start_w, h - 12, kButtonBg);
-  gfx.draw_rect(x, y + 6, start_w, h - 12, kButtonBorder);
-  gfx.draw_string("Start", x + 10, y + (h / 2) - (default_font.char_height / 2),
-                  kButtonText, default_font);
+  l.start = Rect{x, y + 6, start_w, h - 12};
   x += start_w + 8;
 
-  // Reserve a right-side area for date/time (placeholder content for now)
-  const uint32_t char_w = default_font.char_width;
-  const uint32_t char_h = default_font.char_height;
-  uint32_t clock_w = 10u * char_w + 20u; // enough for YYYY-MM-DD plus padding
-  if (clock_w < 100u)
-    clock_w = 100u;
+  // Right-side date/time area bounds the window buttons
+  l.clock = clock_rect(screen_w, screen_h);
+  const uint32_t clock_w = clock_width();
   uint32_t right_limit =
       (screen_w > (clock_w + 8u)) ? (screen_w - (clock_w + 8u)) : 0u;
 
-  // Window buttons
-  for (uint32_t i = 0; i < count; ++i) {
-    const char *title = windows[i].title ? windows[i].title : "Window";
+  // Window buttons in creation order
+  l.button_count = 0;
+  for (auto wh = wm.first(); wh != kNoWindow && l.button_count < kMaxButtons;
+       wh = wm.next(wh)) {
     uint32_t btn_w = 140;
     if (x + btn_w + 8 > right_limit)
       break;
+    Button &b = l.buttons[l.button_count++];
+    b.window = wh;
+    b.rect = Rect{x, y + 6, btn_w, h - 12};
+    b.scheduled = style_of(*wm.get(wh));
+    x += btn_w + 8;
+  }
+}
+
+static const Layout &layout(const window_manager::WindowManager &wm,
+                            uint32_t screen_w, uint32_t screen_h) {
+  if (layout_stale(wm, screen_w, screen_h))
+    rebuild(wm, screen_w, screen_h);
+  return s_layout;
+}
+
+void update(const window_manager::WindowManager &wm, uint32_t screen_w,
+            uint32_t screen_h) {
+  if (layout_stale(wm, screen_w, screen_h))
+    rebuild(wm, screen_w, screen_h);
+  if (!s_layout.announced) {
+    changed(s_layout.band);
+    s_layout.announced = true;
+    return;
+  }
+  for (uint32_t i = 0; i < s_layout.button_count; ++i) {
+    Button &b = s_layout.buttons[i];
+    const window::Window *w = wm.get(b.window);
+    if (w == nullptr)
+      continue;
+    const ButtonStyle style = style_of(*w);
+    if (style != b.scheduled) {
+      changed(b.rect);
+      b.scheduled = style;
+    }
+  }
+}
+
+void prepare(const window_manager::WindowManager &wm, uint32_t screen_w,
+             uint32_t screen_h) {
+  layout(wm, screen_w, screen_h);
+}
+
+void draw(Graphics &gfx, uint32_t screen_w, uint32_t screen_h,
+          const window_manager::WindowManager &wm) {
+  const Layout &l = layout(wm, screen_w, screen_h);
+  const uint32_t h = l.band.h;
+  const uint32_t y = l.band.y;
+  if (!gfx.is_visible(l.band.x, l.band.y, l.band.w, l.band.h))
+    return;
+  const uint32_t char_w = default_font.char_width;
+  const uint32_t char_h = default_font.char_height;
+  gfx.fill_rect(0, y, screen_w, h, kTaskbarBg);
+  gfx.draw_rect(0, y, screen_w, h, kTaskbarBorder);
+
+  // Start area
+  const Rect &st = l.start;
+  gfx.fill_rect(st.x, st.y, st.w, st.h, kButtonBg);
+  gfx.draw_rect(st.x, st.y, st.w, st.h, kButtonBorder);
+  gfx.draw_string("Start", st.x + 10,
+                  y + (h / 2) - (default_font.char_height / 2), kButtonText,
+                  default_font);
+
+  // Window buttons; ones outside the area being repainted are skipped
+  for (uint32_t i = 0; i < l.button_count; ++i) {
+    const Button &b = l.buttons[i];
+    if (!gfx.is_visible(b.rect.x, b.rect.y, b.rect.w, b.rect.h))
+      continue;
+    const window::Window *wp = wm.get(b.window);
+    if (wp == nullptr)
+      continue;
+    const window::Window &w = *wp;
+    const char *title = w.title ? w.title : "Window";
     // Dim if minimized; highlight if focused
-    bool is_focused = windows[i].focused;
-    uint32_t bg = windows[i].minimized
-                      ? 0x2E2E2E
-                      : (is_focused ? kButtonBgFocused : kButtonBg);
-    uint32_t border = windows[i].minimized
+    bool is_focused = w.focused;
+    uint32_t bg = w.minimized ? 0x2E2E2E
+                              : (is_focused ? kButtonBgFocused : kButtonBg);
+    uint32_t border = w.minimized
                           ? 0x4A4A4A
                           : (is_focused ? kButtonBorderFocused : kButtonBorder);
-    uint32_t text = windows[i].minimized
+    uint32_t text = w.minimized
                         ? 0xAAAAAA
                         : (is_focused ? kButtonTextFocused : kButtonText);
-    gfx.fill_rect(x, y + 6, btn_w, h - 12, bg);
-    gfx.draw_rect(x, y + 6, btn_w, h - 12, border);
-    gfx.draw_string(title, x + 10, y + (h / 2) - (default_font.char_height / 2),
-                    text, default_font);
-    x += btn_w + 8;
+    gfx.fill_rect(b.rect.x, b.rect.y, b.rect.w, b.rect.h, bg);
+    gfx.draw_rect(b.rect.x, b.rect.y, b.rect.w, b.rect.h, border);
+    gfx.draw_string(title, b.rect.x + 10,
+                    y + (h / 2) - (default_font.char_height / 2), text,
+                    default_font);
   }
 
   // Draw the right-aligned date/time box
-  if (screen_w > clock_w + 8u) {
-    const uint32_t clock_x = screen_w - clock_w - 8u;
-    const uint32_t inner_y = y + 6u;
-    const uint32_t inner_h = h - 12u;
+  const Rect &cr = l.clock;
+  if (cr.w != 0 && gfx.is_visible(cr.x, cr.y, cr.w, cr.h)) {
+    const uint32_t clock_x = cr.x;
+    const uint32_t inner_y = cr.y;
+    const uint32_t inner_h = cr.h;
+    const uint32_t clock_w = cr.w;
     gfx.fill_rect(clock_x, inner_y, clock_w, inner_h, kButtonBg);
     gfx.draw_rect(clock_x, inner_y, clock_w, inner_h, kButtonBorder);
 
-    // Query platform time
+    // Software clock; no RTC access here
     platform::DateTime dt{0, 0, 0, 0, 0, 0, false};
-    bool ok = platform::get_current_datetime(dt);
+    bool ok = platform::now(dt);
     char time_buf[6] = {0};
     char date_buf[11] = {0};
     if (ok && dt.valid) {
@@ -141,39 +315,21 @@ void draw(Graphics &gfx, uint32_t screen_w, uint32_t screen_h,
 }
 
 uint32_t hit_test(uint32_t px, uint32_t py, uint32_t screen_w,
-                  uint32_t screen_h, const window::Window * /*windows*/,
-                  uint32_t count) {
-  const uint32_t h = height(screen_h);
-  const uint32_t y = screen_h - h;
-  if (py < y)
+                  uint32_t screen_h, const window_manager::WindowManager &wm,
+                  window_manager::WindowHandle &out_window) {
+  const Layout &l = layout(wm, screen_w, screen_h);
+  if (py < l.band.y)
     return UINT32_MAX;
-  uint32_t x = 8; // start button
-  const uint32_t start_w = 80;
-  if (px >= x && px < x + start_w && py >= y + 6 && py < y + 6 + (h - 12))
+  if (contains(l.start, px, py))
     return kHitStart;
-  x += start_w + 8;
-
-  // Exclude right-side date/time area from hit testing
-  const uint32_t char_w = default_font.char_width;
-  uint32_t clock_w = 10u * char_w + 20u;
-  if (clock_w < 100u)
-    clock_w = 100u;
-  uint32_t right_limit =
-      (screen_w > (clock_w + 8u)) ? (screen_w - (clock_w + 8u)) : 0u;
-  if (screen_w > (clock_w + 8u)) {
-    const uint32_t clock_x = screen_w - clock_w - 8u;
-    if (px >= clock_x && px < clock_x + clock_w && py >= y + 6 &&
-        py < y + 6 + (h - 12))
-      return UINT32_MAX;
-  }
-
-  for (uint32_t i = 0; i < count; ++i) {
-    uint32_t btn_w = 140;
-    if (x + btn_w + 8 > right_limit)
-      break;
-    if (px >= x && px < x + btn_w && py >= y + 6 && py < y + 6 + (h - 12))
-      return i;
-    x += btn_w + 8;
+  // The date/time area is not interactive
+  if (contains(l.clock, px, py))
+    return UINT32_MAX;
+  for (uint32_t i = 0; i < l.button_count; ++i) {
+    if (contains(l.buttons[i].rect, px, py)) {
+      out_window = l.buttons[i].window;
+      return kHitWindow;
+    }
   }
   return UINT32_MAX;
 }
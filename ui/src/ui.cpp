@@ -1,6 +1,9 @@
 #include "../include/ui.hpp"
+#include "../include/layer_cache.hpp"
 #include "../include/taskbar.hpp"
+#include "../include/wallpaper.hpp"
 #include "../include/window.hpp"
+#include "../include/window_manager.hpp"
 #include "font.hpp"
 #include "graphics.hpp"
 #include <cstdint>
@@ -20,6 +23,20 @@ static constexpr uint32_t kWindowBorder = 0x4A4A4A;
 static constexpr uint32_t kTitlebarBg = 0x333333;
 static constexpr uint32_t kTitleText = 0xFFFFFF;
 
+static Desktop s_desktop{};
+
+void set_desktop(const Desktop &desktop) { s_desktop = desktop; }
+
+const Desktop &desktop() { return s_desktop; }
+
+static RenderShortcuts s_shortcuts{nullptr, false};
+
+void set_render_shortcuts(const RenderShortcuts &shortcuts) {
+  s_shortcuts = shortcuts;
+}
+
+const RenderShortcuts &render_shortcuts() { return s_shortcuts; }
+
 static void draw_taskbar(Graphics &gfx, uint32_t screen_w, uint32_t screen_h) {
   const uint32_t taskbar_h = clamp_u32(screen_h / 18, 32, 64);
   const uint32_t y = screen_h - taskbar_h;
@@ -109,37 +126,35 @@ void draw_desktop(Graphics &gfx, const Rect &window_rect) {
 }
 
 void draw_desktop_layer(Graphics &gfx, RenderLayer layer,
-                        const window::Window *windows, uint32_t count) {
-  const uint32_t screen_w = gfx.get_width();
-  const uint32_t screen_h = gfx.get_height();
+                        const window_manager::WindowManager &wm) {
+  using window_manager::kNoWindow;
+  using window_manager::WindowHandle;
+  const uint32_t screen_w = s_desktop.primary.w;
+  const uint32_t screen_h = s_desktop.primary.h;
 
+  // Static layers come from their cached surface when there is one
   if (layer == RenderLayer::Background) {
-    gfx.clear_screen(kDesktopBg);
+    if (!layer_cache::draw(gfx, layer, wm) && !wallpaper::draw(gfx))
+      gfx.clear_screen(kDesktopBg);
     return;
   }
 
   if (layer == RenderLayer::Taskbar) {
-    taskbar::draw(gfx, screen_w, screen_h, windows, count);
+    if (!layer_cache::draw(gfx, layer, wm))
+      taskbar::draw(gfx, screen_w, screen_h, wm);
     return;
   }
 
-  // Determine focused window
-  int32_t focused_idx = -1;
-  for (uint32_t i = 0; i < count; ++i) {
-    if (windows[i].focused) {
-      focused_idx = static_cast<int32_t>(i);
-      break;
-    }
-  }
+  const WindowHandle focused = wm.focused();
 
   if (layer == RenderLayer::WindowsBack) {
-    for (uint32_t i = 0; i < count; ++i) {
-      const window::Window &w = windows[i];
+    for (WindowHandle h = wm.bottom(); h != kNoWindow; h = wm.above(h)) {
+      const window::Window &w = *wm.get(h);
       if (w.minimized)
         continue;
       if (w.always_on_top)
         continue;
-      if (static_cast<int32_t>(i) == focused_idx)
+      if (h == focused)
         continue;
       window::draw(gfx, w);
     }
@@ -147,8 +162,8 @@ void draw_desktop_layer(Graphics &gfx, RenderLayer layer,
   }
 
   if (layer == RenderLayer::WindowsFocused) {
-    if (focused_idx >= 0) {
-      const window::Window &fw = windows[focused_idx];
+    if (focused != kNoWindow) {
+      const window::Window &fw = *wm.get(focused);
       if (!fw.minimized && !fw.always_on_top)
         window::draw(gfx, fw);
     }
@@ -156,13 +171,13 @@ void draw_desktop_layer(Graphics &gfx, RenderLayer layer,
   }
 
   if (layer == RenderLayer::WindowsTop) {
-    for (uint32_t i = 0; i < count; ++i) {
-      const window::Window &w = windows[i];
+    for (WindowHandle h = wm.bottom(); h != kNoWindow; h = wm.above(h)) {
+      const window::Window &w = *wm.get(h);
       if (w.minimized)
         continue;
       if (!w.always_on_top)
         continue;
-      if (static_cast<int32_t>(i) == focused_idx)
+      if (h == focused)
         continue;
       window::draw(gfx, w);
     }
@@ -170,8 +185,8 @@ void draw_desktop_layer(Graphics &gfx, RenderLayer layer,
   }
 
   if (layer == RenderLayer::WindowsTopFocused) {
-    if (focused_idx >= 0) {
-      const window::Window &fw = windows[focused_idx];
+    if (focused != kNoWindow) {
+      const window::Window &fw = *wm.get(focused);
       if (!fw.minimized && fw.always_on_top)
         window::draw(gfx, fw);
     }
@@ -186,40 +201,58 @@ void draw_desktop_layer(Graphics &gfx, RenderLayer layer,
   }
 }
 
-void draw_desktop(Graphics &gfx, const window::Window *windows,
-                  uint32_t count) {
-  const uint32_t screen_w = gfx.get_width();
-  const uint32_t screen_h = gfx.get_height();
-
-  // Background
-  draw_desktop_layer(gfx, RenderLayer::Background, windows, count);
-
-  // Determine fullscreen presence to possibly short-circuit like before
-  int32_t focused_fs_idx = -1;
-  int32_t last_fs_idx = -1;
-  for (uint32_t i = 0; i < count; ++i) {
-    const window::Window &w = windows[i];
+window_manager::WindowHandle
+fullscreen_window(const window_manager::WindowManager &wm) {
+  using window_manager::kNoWindow;
+  using window_manager::WindowHandle;
+  WindowHandle focused_fs = kNoWindow;
+  WindowHandle last_fs = kNoWindow;
+  for (WindowHandle h = wm.bottom(); h != kNoWindow; h = wm.above(h)) {
+    const window::Window &w = *wm.get(h);
     if (!w.minimized && w.fullscreen) {
-      last_fs_idx = static_cast<int32_t>(i);
+      last_fs = h;
       if (w.focused)
-        focused_fs_idx = static_cast<int32_t>(i);
+        focused_fs = h;
     }
   }
+  return (focused_fs != kNoWindow) ? focused_fs : last_fs;
+}
 
-  if (focused_fs_idx >= 0 || last_fs_idx >= 0) {
-    int32_t idx = (focused_fs_idx >= 0) ? focused_fs_idx : last_fs_idx;
-    window::draw(gfx, windows[idx]);
+void draw_desktop(Graphics &gfx, const window_manager::WindowManager &wm) {
+  using window_manager::kNoWindow;
+  using window_manager::WindowHandle;
+
+  // A fullscreen window covers the whole primary output: draw only it there.
+  // Its frame fills the screen, so the background pass is skipped as well.
+  // Other outputs draw normally; the fullscreen frame is clipped away there.
+  const WindowHandle fs = fullscreen_window(wm);
+  if (fs != kNoWindow && gfx.get_origin_x() == s_desktop.primary.x &&
+      gfx.get_origin_y() == s_desktop.primary.y) {
+    window::draw(gfx, *wm.get(fs));
     return;
   }
 
+  // Background
+  draw_desktop_layer(gfx, RenderLayer::Background, wm);
+
   // Layered draw order with no fullscreen window present
-  (void)screen_w;
-  (void)screen_h;
-  draw_desktop_layer(gfx, RenderLayer::Taskbar, windows, count);
-  draw_desktop_layer(gfx, RenderLayer::WindowsBack, windows, count);
-  draw_desktop_layer(gfx, RenderLayer::WindowsFocused, windows, count);
-  draw_desktop_layer(gfx, RenderLayer::WindowsTop, windows, count);
-  draw_desktop_layer(gfx, RenderLayer::WindowsTopFocused, windows, count);
+  draw_desktop_layer(gfx, RenderLayer::Taskbar, wm);
+  draw_desktop_layer(gfx, RenderLayer::WindowsBack, wm);
+  draw_desktop_layer(gfx, RenderLayer::WindowsFocused, wm);
+  draw_desktop_layer(gfx, RenderLayer::WindowsTop, wm);
+  draw_desktop_layer(gfx, RenderLayer::WindowsTopFocused, wm);
+}
+
+void prepare_windows(const window_manager::WindowManager &wm) {
+  using window_manager::kNoWindow;
+  using window_manager::WindowHandle;
+  const Rect &screen = s_desktop.primary;
+  for (WindowHandle h = wm.bottom(); h != kNoWindow; h = wm.above(h)) {
+    const window::Window &w = *wm.get(h);
+    if (w.prepare_content != nullptr && !w.minimized)
+      w.prepare_content(window::get_content_rect(w, screen.w, screen.h),
+                        w.user_data);
+  }
 }
 
 // Region rendering removed
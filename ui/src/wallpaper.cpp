@@ -0,0 +1,137 @@
+#include "../include/wallpaper.hpp"
+#include "../include/layer_cache.hpp"
+#include "graphics.hpp"
+
+namespace ui::wallpaper {
+
+static const uint32_t *s_pixels = nullptr;
+static uint32_t s_w = 0;
+static uint32_t s_h = 0;
+
+void set(const uint32_t *pixels, uint32_t w, uint32_t h) {
+  if (pixels == nullptr || w == 0 || h == 0 || w > 0x7FFF || h > 0x7FFF) {
+    pixels = nullptr;
+    w = 0;
+    h = 0;
+  }
+  s_pixels = pixels;
+  s_w = w;
+  s_h = h;
+  layer_cache::invalidate_background();
+}
+
+// Blend two 0x00RRGGBB colors, f/256 of the way from a to b
+static inline uint32_t lerp(uint32_t a, uint32_t b, uint32_t f) {
+  const uint32_t g = 256 - f;
+  const uint32_t rb = ((a & 0xFF00FF) * g + (b & 0xFF00FF) * f) >> 8;
+  const uint32_t gg = ((a & 0x00FF00) * g + (b & 0x00FF00) * f) >> 8;
+  return (rb & 0xFF00FF) | (gg & 0x00FF00);
+}
+
+// Source coordinate (16.16) of the center of destination pixel i, clamped to
+// the source's first and last pixel centers
+static inline uint32_t source_pos(uint32_t i, uint32_t start, uint32_t step,
+                                  uint32_t limit) {
+  const int64_t pos =
+      int64_t(start) + int64_t(i) * step + step / 2 - 0x8000;
+  if (pos < 0)
+    return 0;
+  return pos > int64_t(limit) ? limit : static_cast<uint32_t>(pos);
+}
+
+// Share (out of 256) of source pixel s that the span [a, b) (16.16) covers
+static inline uint64_t coverage(uint64_t s, uint64_t a, uint64_t b) {
+  const uint64_t lo = (s << 16) > a ? (s << 16) : a;
+  const uint64_t hi = ((s + 1) << 16) < b ? ((s + 1) << 16) : b;
+  return (hi - lo) >> 8;
+}
+
+// Area average of the source under [x0, x0 + step) x [y0, y0 + step)
+// (16.16), each pixel weighted by how much of it the footprint covers. Used
+// when shrinking, where sampling a 2x2 neighborhood would skip pixels.
+static uint32_t box(uint64_t x0, uint64_t y0, uint32_t step) {
+  const uint64_t x1 = x0 + step;
+  const uint64_t y1 = y0 + step;
+  uint64_t r = 0, g = 0, b = 0, total = 0;
+  for (uint64_t sy = y0 >> 16; sy < s_h && (sy << 16) < y1; ++sy) {
+    const uint64_t wy = coverage(sy, y0, y1);
+    const uint32_t *row = s_pixels + sy * s_w;
+    for (uint64_t sx = x0 >> 16; sx < s_w && (sx << 16) < x1; ++sx) {
+      const uint64_t w = wy * coverage(sx, x0, x1);
+      const uint32_t p = row[sx];
+      r += w * ((p >> 16) & 0xFF);
+      g += w * ((p >> 8) & 0xFF);
+      b += w * (p & 0xFF);
+      total += w;
+    }
+  }
+  if (total == 0)
+    return 0;
+  const uint64_t half = total / 2;
+  return static_cast<uint32_t>(((r + half) / total) << 16 |
+                               ((g + half) / total) << 8 | (b + half) / total);
+}
+
+bool draw(Graphics &gfx) {
+  if (s_pixels == nullptr)
+    return false;
+  const uint32_t ox = gfx.get_origin_x();
+  const uint32_t oy = gfx.get_origin_y();
+  const uint32_t dw = gfx.get_width();
+  const uint32_t dh = gfx.get_height();
+  if (dw == 0 || dh == 0)
+    return true;
+
+  // Cover: one 16.16 step for both axes, the smaller of the two ratios, with
+  // the overflowing axis cropped evenly on both sides
+  const uint64_t step_x = (uint64_t(s_w) << 16) / dw;
+  const uint64_t step_y = (uint64_t(s_h) << 16) / dh;
+  const uint32_t step =
+      static_cast<uint32_t>(step_x < step_y ? step_x : step_y);
+  const uint32_t start_x =
+      static_cast<uint32_t>(((uint64_t(s_w) << 16) - uint64_t(dw) * step) / 2);
+  const uint32_t start_y =
+      static_cast<uint32_t>(((uint64_t(s_h) << 16) - uint64_t(dh) * step) / 2);
+  const uint32_t limit_x = (s_w - 1) << 16;
+  const uint32_t limit_y = (s_h - 1) << 16;
+  const bool shrink = step > 0x10000;
+
+  // Rows are resampled in short runs and blitted, skipping runs the clip
+  // rect hides
+  constexpr uint32_t kRun = 256;
+  uint32_t run[kRun];
+  for (uint32_t y = 0; y < dh; ++y) {
+    if (!gfx.is_visible(ox, oy + y, dw, 1))
+      continue;
+    const uint32_t sy = source_pos(y, start_y, step, limit_y);
+    const uint32_t y0 = sy >> 16;
+    const uint32_t y1 = y0 + 1 < s_h ? y0 + 1 : y0;
+    const uint32_t fy = (sy >> 8) & 0xFF;
+    const uint32_t *row0 = s_pixels + uint64_t(y0) * s_w;
+    const uint32_t *row1 = s_pixels + uint64_t(y1) * s_w;
+    for (uint32_t x = 0; x < dw; x += kRun) {
+      const uint32_t n = dw - x < kRun ? dw - x : kRun;
+      if (!gfx.is_visible(ox + x, oy + y, n, 1))
+        continue;
+      if (shrink) {
+        const uint64_t fy0 = start_y + uint64_t(y) * step;
+        for (uint32_t i = 0; i < n; ++i)
+          run[i] = box(start_x + uint64_t(x + i) * step, fy0, step);
+        gfx.blit(run, n, ox + x, oy + y, n, 1);
+        continue;
+      }
+      for (uint32_t i = 0; i < n; ++i) {
+        const uint32_t sx = source_pos(x + i, start_x, step, limit_x);
+        const uint32_t x0 = sx >> 16;
+        const uint32_t x1 = x0 + 1 < s_w ? x0 + 1 : x0;
+        const uint32_t fx = (sx >> 8) & 0xFF;
+        run[i] = lerp(lerp(row0[x0], row0[x1], fx),
+                      lerp(row1[x0], row1[x1], fx), fy);
+      }
+      gfx.blit(run, n, ox + x, oy + y, n, 1);
+    }
+  }
+  return true;
+}
+
+} // namespace ui::wallpaper
@@ -25,96 +25,98 @@ static constexpr uint32_t kBtnPinBorder = 0x6F3A86;
 
 uint32_t get_titlebar_height() { return 28; }
 
-bool point_in_titlebar(const Window &w, uint32_t x, uint32_t y) {
-  if (w.minimized)
-    return false;
-  if (!w.movable || !w.draggable)
-    return false;
+Rect get_frame_rect(const Window &w, uint32_t screen_w, uint32_t screen_h) {
+  if (w.fullscreen)
+    return Rect{0, 0, screen_w, screen_h};
+  if (w.maximized) {
+    uint32_t rh = screen_h;
+    const uint32_t tb_h = ui::taskbar::height(screen_h);
+    if (rh > tb_h)
+      rh -= tb_h; // keep taskbar visible
+    return Rect{0, 0, screen_w, rh};
+  }
+  return w.rect;
+}
 
+Layout compute_layout(const Window &w, const Rect &frame) {
   const uint32_t th = get_titlebar_height();
-
-  uint32_t rx = w.rect.x;
-  uint32_t ry = w.rect.y;
-  uint32_t rw = w.rect.w;
-
-  // Exclude the left button cluster (close, minimize, maximize, pin)
   const uint32_t btn_margin = 6;
-  const uint32_t btn_size = th - 12; // square
+  const uint32_t btn_size = th - 12; // square buttons
   const uint32_t btn_spacing = 6;
+  const uint32_t rx = frame.x;
+  const uint32_t ry = frame.y;
+  const uint32_t rw = frame.w;
+  const uint32_t rh = frame.h;
+
+  Layout l{};
+  l.frame = frame;
+
+  // Left button cluster: close (optional), minimize, maximize, pin
+  uint32_t bx = rx + 1 + btn_margin;
+  const uint32_t by = ry + 1 + 6;
+  for (uint32_t i = 0; i < 4; ++i) {
+    if (i == 0 && !w.closeable)
+      continue;
+    l.buttons[i] = Rect{bx, by, btn_size, btn_size};
+    bx += btn_size + btn_spacing;
+  }
   uint32_t num_buttons = 4u - (w.closeable ? 0u : 1u);
   const uint32_t cluster_w =
       num_buttons ? (btn_size * num_buttons) + (btn_spacing * (num_buttons - 1))
                   : 0u;
-  uint32_t left_exclude_end = rx + 1 + btn_margin + cluster_w;
+  const uint32_t cluster_end = rx + 1 + btn_margin + cluster_w;
+  l.title_x = cluster_end + 8; // some gap after buttons
+
+  const uint32_t title_end = rx + rw - 1;
+  l.titlebar = Rect{cluster_end, ry + 1,
+                    title_end > cluster_end ? title_end - cluster_end : 0u, th};
+  l.content = Rect{rx + 8, ry + th + 8, (rw > 16 ? rw - 16 : 0),
+                   (rh > th + 16 ? rh - th - 16 : 0)};
+  return l;
+}
 
-  return x >= left_exclude_end && x < rx + rw - 1 && y >= ry + 1 &&
-         y < ry + 1 + th;
+static inline bool rect_contains(const Rect &r, uint32_t x, uint32_t y) {
+  return x >= r.x && x < r.x + r.w && y >= r.y && y < r.y + r.h;
+}
+
+bool point_in_titlebar(const Window &w, uint32_t x, uint32_t y) {
+  if (w.minimized)
+    return false;
+  if (!w.movable || !w.draggable)
+    return false;
+  return rect_contains(compute_layout(w, w.rect).titlebar, x, y);
 }
 
 uint32_t hit_test_button(const Window &w, uint32_t x, uint32_t y) {
   if (w.minimized)
     return UINT32_MAX;
-  const uint32_t th = get_titlebar_height();
-  uint32_t rx = w.rect.x;
-  uint32_t ry = w.rect.y;
-  uint32_t rw = w.rect.w;
-  (void)rw;
-  const uint32_t btn_margin = 6;
-  const uint32_t btn_size = th - 12;
-  const uint32_t btn_spacing = 6;
-  uint32_t bx = rx + 1 + btn_margin;
-  const uint32_t by = ry + 1 + 6;
-  uint32_t idx = 0;
-  // Close (optional)
-  if (w.closeable) {
-    if (x >= bx && x < bx + btn_size && y >= by && y < by + btn_size)
-      return idx;
-    bx += btn_size + btn_spacing;
-  } else {
-    idx = 1; // skip close index so minimize is 1
+  const Layout l = compute_layout(w, w.rect);
+  for (uint32_t i = 0; i < 4; ++i) {
+    if (rect_contains(l.buttons[i], x, y))
+      return i;
   }
-  // Minimize
-  if (x >= bx && x < bx + btn_size && y >= by && y < by + btn_size)
-    return 1;
-  bx += btn_size + btn_spacing;
-  // Maximize
-  if (x >= bx && x < bx + btn_size && y >= by && y < by + btn_size)
-    return 2;
-  bx += btn_size + btn_spacing;
-  // Pin
-  if (x >= bx && x < bx + btn_size && y >= by && y < by + btn_size)
-    return 3;
   return UINT32_MAX;
 }
 
 void draw(Graphics &gfx, const Window &w) {
   if (w.minimized)
     return;
-
-  // Effective rect based on fullscreen/maximized
-  uint32_t rx = w.rect.x;
-  uint32_t ry = w.rect.y;
-  uint32_t rw = w.rect.w;
-  uint32_t rh = w.rect.h;
-
-  const uint32_t screen_w = gfx.get_width();
-  const uint32_t screen_h = gfx.get_height();
-
-  if (w.fullscreen) {
-    rx = 0;
-    ry = 0;
-    rw = screen_w;
-    rh = screen_h;
-  } else if (w.maximized) {
-    rx = 0;
-    ry = 0;
-    rw = screen_w;
-    rh = screen_h;
-    const uint32_t tb_h = ui::taskbar::height(screen_h);
-    if (rh > tb_h)
-      rh -= tb_h; // keep taskbar visible
+  const RenderShortcuts &shortcuts = render_shortcuts();
+  if (shortcuts.outline == &w) {
+    draw_frame_only(gfx, w);
+    return;
   }
 
+  const Rect &screen = desktop().primary;
+  const Layout l = compute_layout(w, get_frame_rect(w, screen.w, screen.h));
+  const uint32_t rx = l.frame.x;
+  const uint32_t ry = l.frame.y;
+  const uint32_t rw = l.frame.w;
+  const uint32_t rh = l.frame.h;
+  // Nothing to do when the frame lies outside the area being repainted
+  if (!gfx.is_visible(rx, ry, rw, rh))
+    return;
+
   // Colors depending on focus
   const bool is_focused = w.focused;
   const uint32_t border_col = is_focused ? kWindowBorderFocused : kWindowBorder;
@@ -130,46 +132,21 @@ void draw(Graphics &gfx, const Window &w) {
   gfx.fill_rect(rx + 1, ry + 1, rw - 2, th, titlebar_col);
 
   // Left-side buttons: close, minimize, maximize, pin
-  {
-    const uint32_t btn_margin = 6;
-    const uint32_t btn_size = th - 12; // square buttons
-    const uint32_t btn_spacing = 6;
-    uint32_t bx = rx + 1 + btn_margin;
-    const uint32_t by = ry + 1 + 6;
-
-    // Close (optional)
-    if (w.closeable) {
-      gfx.fill_rect(bx, by, btn_size, btn_size, kBtnCloseBg);
-      gfx.draw_rect(bx, by, btn_size, btn_size, kBtnCloseBorder);
-      bx += btn_size + btn_spacing;
-    }
-    // Minimize
-    gfx.fill_rect(bx, by, btn_size, btn_size, kBtnMinBg);
-    gfx.draw_rect(bx, by, btn_size, btn_size, kBtnMinBorder);
-    bx += btn_size + btn_spacing;
-    // Maximize
-    gfx.fill_rect(bx, by, btn_size, btn_size, kBtnMaxBg);
-    gfx.draw_rect(bx, by, btn_size, btn_size, kBtnMaxBorder);
-    bx += btn_size + btn_spacing;
-    // Pin (always-on-top)
-    gfx.fill_rect(bx, by, btn_size, btn_size, kBtnPinBg);
-    gfx.draw_rect(bx, by, btn_size, btn_size, kBtnPinBorder);
+  static constexpr uint32_t kBtnBg[4] = {kBtnCloseBg, kBtnMinBg, kBtnMaxBg,
+                                         kBtnPinBg};
+  static constexpr uint32_t kBtnBorder[4] = {kBtnCloseBorder, kBtnMinBorder,
+                                             kBtnMaxBorder, kBtnPinBorder};
+  for (uint32_t i = 0; i < 4; ++i) {
+    const Rect &b = l.buttons[i];
+    if (b.w == 0)
+      continue;
+    gfx.fill_rect(b.x, b.y, b.w, b.h, kBtnBg[i]);
+    gfx.draw_rect(b.x, b.y, b.w, b.h, kBtnBorder[i]);
   }
 
   // Title
-  if (w.title) {
-    const uint32_t btn_margin = 6;
-    const uint32_t btn_size = th - 12;
-    const uint32_t btn_spacing = 6;
-    uint32_t num_buttons = 4u - (w.closeable ? 0u : 1u);
-    const uint32_t cluster_w =
-        num_buttons
-            ? (btn_size * num_buttons) + (btn_spacing * (num_buttons - 1))
-            : 0u;
-    uint32_t text_x =
-        rx + 1 + btn_margin + cluster_w + 8; // some gap after buttons
-    gfx.draw_string(w.title, text_x, ry + 6, titletext_col, default_font);
-  }
+  if (w.title)
+    gfx.draw_string(w.title, l.title_x, ry + 6, titletext_col, default_font);
 
   // Resizable handle (skip when fullscreen/maximized)
   if (w.resizable && !w.fullscreen && !w.maximized) {
@@ -185,8 +162,9 @@ void draw(Graphics &gfx, const Window &w) {
   }
 
   // Content area rect below titlebar
-  const Rect content_rect{rx + 8, ry + th + 8, (rw > 16 ? rw - 16 : 0),
-                          (rh > th + 16 ? rh - th - 16 : 0)};
+  const Rect &content_rect = l.content;
+  if (shortcuts.focused_content_only && !is_focused)
+    return;
   if (w.draw_content) {
     w.draw_content(gfx, content_rect, w.user_data);
   } else {
@@ -199,23 +177,12 @@ void draw_frame_only(Graphics &gfx, const Window &w) {
   if (w.minimized)
     return;
   // Effective rect based on fullscreen/maximized, same as draw()
-  uint32_t rx = w.rect.x;
-  uint32_t ry = w.rect.y;
-  uint32_t rw = w.rect.w;
-  uint32_t rh = w.rect.h;
-  const uint32_t screen_w = gfx.get_width();
-  const uint32_t screen_h = gfx.get_height();
-  if (w.fullscreen) {
-    rx = 0;
-    ry = 0;
-    rw = screen_w;
-    rh = screen_h;
-  } else if (w.maximized) {
-    rx = 0;
-    ry = 0;
-    rw = screen_w;
-    rh = screen_h - ui::taskbar::height(screen_h);
-  }
+  const Rect &screen = desktop().primary;
+  const Rect frame = get_frame_rect(w, screen.w, screen.h);
+  const uint32_t rx = frame.x;
+  const uint32_t ry = frame.y;
+  const uint32_t rw = frame.w;
+  const uint32_t rh = frame.h;
   const bool is_focused = w.focused;
   const uint32_t border_col = is_focused ? kWindowBorderFocused : kWindowBorder;
 
@@ -245,10 +212,14 @@ uint32_t hit_test_resize(const Window &w, uint32_t x, uint32_t y) {
   // anyway)
   if (w.fullscreen || w.maximized)
     return 0;
-  uint32_t rx = w.rect.x;
-  uint32_t ry = w.rect.y;
-  uint32_t rw = w.rect.w;
-  uint32_t rh = w.rect.h;
+  return resize_edges(w.rect, x, y);
+}
+
+uint32_t resize_edges(const Rect &frame, uint32_t x, uint32_t y) {
+  const uint32_t rx = frame.x;
+  const uint32_t ry = frame.y;
+  const uint32_t rw = frame.w;
+  const uint32_t rh = frame.h;
   const uint32_t margin = 4; // grip thickness
   uint32_t mask = 0;
   if (x >= rx && x < rx + margin && y >= ry && y < ry + rh)
@@ -263,32 +234,22 @@ uint32_t hit_test_resize(const Window &w, uint32_t x, uint32_t y) {
 }
 
 Rect get_content_rect(const Window &w, uint32_t screen_w, uint32_t screen_h) {
-  (void)screen_w;
-  (void)screen_h;
   if (w.minimized) {
     return Rect{0, 0, 0, 0};
   }
-  // Recompute effective window rect similar to draw()
-  uint32_t rx = w.rect.x;
-  uint32_t ry = w.rect.y;
-  uint32_t rw = w.rect.w;
-  uint32_t rh = w.rect.h;
-  if (w.fullscreen) {
-    rx = 0;
-    ry = 0;
-    rw = screen_w;
-    rh = screen_h;
-  } else if (w.maximized) {
-    rx = 0;
-    ry = 0;
-    rw = screen_w;
-    rh = screen_h - ui::taskbar::height(screen_h);
-  }
-  const uint32_t th = get_titlebar_height();
-  Rect r{rx + 8, ry + th + 8, (rw > 16 ? rw - 16 : 0),
-         (rh > th + 16 ? rh - th - 16 : 0)};
-  return r;
+  return compute_layout(w, get_frame_rect(w, screen_w, screen_h)).content;
 }
 
+void invalidate_content(const MouseEvent &ev, const Rect &local) {
+  const Rect &c = ev.content;
+  if (local.x >= c.w || local.y >= c.h)
+    return;
+  const uint32_t w = local.w < c.w - local.x ? local.w : c.w - local.x;
+  const uint32_t h = local.h < c.h - local.y ? local.h : c.h - local.y;
+  ui::invalidate(Rect{c.x + local.x, c.y + local.y, w, h});
+}
+
+void invalidate_content(const MouseEvent &ev) { ui::invalidate(ev.content); }
+
 } // namespace window
 } // namespace ui
@@ -1,4 +1,6 @@
 #include "window_manager.hpp"
+#include "mem_account.hpp"
+#include <new>
 
 namespace ui::window_manager {
 
@@ -59,7 +61,9 @@ window::Window create_window(uint32_t screen_w, uint32_t screen_h,
   window.always_on_top = options.always_on_top;
   window.user_data = options.user_data;
   window.draw_content = options.draw_content;
+  window.prepare_content = options.prepare_content;
   window.on_mouse = options.on_mouse;
+  window.on_close = options.on_close;
 
   return window;
 }
@@ -95,7 +99,9 @@ window::Window create_window_relative(uint32_t screen_w, uint32_t screen_h,
   window.always_on_top = options.always_on_top;
   window.user_data = options.user_data;
   window.draw_content = options.draw_content;
+  window.prepare_content = options.prepare_content;
   window.on_mouse = options.on_mouse;
+  window.on_close = options.on_close;
 
   return window;
 }
@@ -136,4 +142,253 @@ window::Window create_dialog_window(
   return create_window(screen_w, screen_h, options);
 }
 
+WindowManager::WindowManager()
+    : chunks_(nullptr), chunk_count_(0), chunk_capacity_(0), free_head_(kNil),
+      z_bottom_(kNil), z_top_(kNil), order_first_(kNil), order_last_(kNil),
+      focused_(kNil), count_(0), version_(0) {}
+
+WindowManager::Slot *WindowManager::slot(uint32_t index) const {
+  return &chunks_[index / kChunkSize][index % kChunkSize];
+}
+
+WindowHandle WindowManager::handle_of(uint32_t index) const {
+  if (index == kNil)
+    return kNoWindow;
+  return WindowHandle{index, slot(index)->generation};
+}
+
+uint32_t WindowManager::index_of(WindowHandle h) const {
+  if (h.slot >= chunk_count_ * kChunkSize)
+    return kNil;
+  const Slot *s = slot(h.slot);
+  if (!s->in_use || s->generation != h.generation)
+    return kNil;
+  return h.slot;
+}
+
+WindowManager::~WindowManager() {
+  for (uint32_t i = 0; i < chunk_count_; ++i) {
+    delete[] chunks_[i];
+    platform::mem_uncharge(platform::MemTag::Ui, sizeof(Slot) * kChunkSize);
+  }
+  delete[] chunks_;
+  platform::mem_uncharge(platform::MemTag::Ui,
+                         sizeof(Slot *) * chunk_capacity_);
+}
+
+bool WindowManager::grow() {
+  // Chunks come from the heap and are kept until the manager goes away;
+  // slots never move once handed out, so handles and pointers stay stable.
+  // Only the table of chunk pointers is reallocated as it fills.
+  if (chunk_count_ >= (kNil - 1) / kChunkSize)
+    return false;
+  // Nor do they belong to the window being opened
+  platform::MemOwnerScope shared(0);
+  if (chunk_count_ == chunk_capacity_) {
+    const uint32_t capacity = chunk_capacity_ == 0 ? 4 : chunk_capacity_ * 2;
+    Slot **table = new (std::nothrow) Slot *[capacity];
+    if (table == nullptr)
+      return false;
+    for (uint32_t i = 0; i < chunk_count_; ++i)
+      table[i] = chunks_[i];
+    delete[] chunks_;
+    platform::mem_charge(platform::MemTag::Ui,
+                         sizeof(Slot *) * (capacity - chunk_capacity_));
+    chunks_ = table;
+    chunk_capacity_ = capacity;
+  }
+  Slot *chunk = new (std::nothrow) Slot[kChunkSize];
+  if (chunk == nullptr)
+    return false;
+  platform::mem_charge(platform::MemTag::Ui, sizeof(Slot) * kChunkSize);
+  const uint32_t base = chunk_count_ * kChunkSize;
+  chunks_[chunk_count_++] = chunk;
+  // Thread the new slots onto the free list in ascending order
+  for (uint32_t i = kChunkSize; i > 0; --i) {
+    Slot &s = chunk[i - 1];
+    s.in_use = false;
+    s.generation = 1;
+    s.z_prev = kNil;
+    s.z_next = free_head_;
+    s.order_prev = s.order_next = kNil;
+    free_head_ = base + i - 1;
+  }
+  return true;
+}
+
+void WindowManager::unlink_z(uint32_t index) {
+  Slot *s = slot(index);
+  if (s->z_prev != kNil)
+    slot(s->z_prev)->z_next = s->z_next;
+  else
+    z_bottom_ = s->z_next;
+  if (s->z_next != kNil)
+    slot(s->z_next)->z_prev = s->z_prev;
+  else
+    z_top_ = s->z_prev;
+  s->z_prev = s->z_next = kNil;
+}
+
+void WindowManager::link_z_top(uint32_t index) {
+  Slot *s = slot(index);
+  s->z_prev = z_top_;
+  s->z_next = kNil;
+  if (z_top_ != kNil)
+    slot(z_top_)->z_next = index;
+  else
+    z_bottom_ = index;
+  z_top_ = index;
+}
+
+WindowHandle WindowManager::open(const window::Window &w) {
+  if (free_head_ == kNil && !grow()) {
+    if (w.on_close)
+      w.on_close(w.user_data);
+    return kNoWindow;
+  }
+  const uint32_t index = free_head_;
+  Slot *s = slot(index);
+  free_head_ = s->z_next;
+
+  s->window = w;
+  s->window.focused = false;
+  // Whatever its app charged while creating it belongs to the window
+  s->window.mem_owner = platform::mem_current_owner();
+  s->restore_valid = false;
+  s->in_use = true;
+
+  s->order_prev = order_last_;
+  s->order_next = kNil;
+  if (order_last_ != kNil)
+    slot(order_last_)->order_next = index;
+  else
+    order_first_ = index;
+  order_last_ = index;
+
+  link_z_top(index);
+  count_++;
+  version_++;
+
+  const WindowHandle h{index, s->generation};
+  focus(h);
+  return h;
+}
+
+void WindowManager::close(WindowHandle h) {
+  const uint32_t index = index_of(h);
+  if (index == kNil)
+    return;
+  Slot *s = slot(index);
+  unlink_z(index);
+
+  if (s->order_prev != kNil)
+    slot(s->order_prev)->order_next = s->order_next;
+  else
+    order_first_ = s->order_next;
+  if (s->order_next != kNil)
+    slot(s->order_next)->order_prev = s->order_prev;
+  else
+    order_last_ = s->order_prev;
+  s->order_prev = s->order_next = kNil;
+
+  if (focused_ == index)
+    focused_ = kNil;
+
+  s->in_use = false;
+  s->generation++; // stale out outstanding handles
+  s->z_next = free_head_;
+  free_head_ = index;
+  count_--;
+  version_++;
+
+  // The app's state goes last, once nothing can reach it through the window.
+  // Anything still charged to the window after that has leaked.
+  if (s->window.on_close)
+    s->window.on_close(s->window.user_data);
+  platform::mem_report_leaks(s->window.mem_owner);
+}
+
+void WindowManager::raise(WindowHandle h) {
+  const uint32_t index = index_of(h);
+  if (index == kNil || index == z_top_)
+    return;
+  unlink_z(index);
+  link_z_top(index);
+}
+
+void WindowManager::focus(WindowHandle h) {
+  const uint32_t index = index_of(h);
+  if (index == kNil)
+    return;
+  raise(h);
+  if (focused_ != kNil && focused_ != index)
+    slot(focused_)->window.focused = false;
+  slot(index)->window.focused = true;
+  focused_ = index;
+}
+
+void WindowManager::clear_focus() {
+  if (focused_ != kNil)
+    slot(focused_)->window.focused = false;
+  focused_ = kNil;
+}
+
+void WindowManager::set_title(WindowHandle h, const char *title) {
+  const uint32_t index = index_of(h);
+  if (index == kNil)
+    return;
+  slot(index)->window.title = title;
+  version_++;
+}
+
+bool WindowManager::valid(WindowHandle h) const { return index_of(h) != kNil; }
+
+window::Window *WindowManager::get(WindowHandle h) {
+  const uint32_t index = index_of(h);
+  return index == kNil ? nullptr : &slot(index)->window;
+}
+
+const window::Window *WindowManager::get(WindowHandle h) const {
+  const uint32_t index = index_of(h);
+  return index == kNil ? nullptr : &slot(index)->window;
+}
+
+void WindowManager::save_restore_rect(WindowHandle h, const Rect &r) {
+  const uint32_t index = index_of(h);
+  if (index == kNil)
+    return;
+  slot(index)->restore_rect = r;
+  slot(index)->restore_valid = true;
+}
+
+bool WindowManager::take_restore_rect(WindowHandle h, Rect &out) {
+  const uint32_t index = index_of(h);
+  if (index == kNil || !slot(index)->restore_valid)
+    return false;
+  out = slot(index)->restore_rect;
+  slot(index)->restore_valid = false;
+  return true;
+}
+
+WindowHandle WindowManager::bottom() const { return handle_of(z_bottom_); }
+
+WindowHandle WindowManager::top() const { return handle_of(z_top_); }
+
+WindowHandle WindowManager::above(WindowHandle h) const {
+  const uint32_t index = index_of(h);
+  return index == kNil ? kNoWindow : handle_of(slot(index)->z_next);
+}
+
+WindowHandle WindowManager::below(WindowHandle h) const {
+  const uint32_t index = index_of(h);
+  return index == kNil ? kNoWindow : handle_of(slot(index)->z_prev);
+}
+
+WindowHandle WindowManager::first() const { return handle_of(order_first_); }
+
+WindowHandle WindowManager::next(WindowHandle h) const {
+  const uint32_t index = index_of(h);
+  return index == kNil ? kNoWindow : handle_of(slot(index)->order_next);
+}
+
 } // namespace ui::window_manager